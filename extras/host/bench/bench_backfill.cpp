@@ -0,0 +1,125 @@
+/**
+ * @file bench_backfill.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Measures backfill throughput: a data file of several megabytes,
+ * read through the SD card store a window at a time, posted to the loopback
+ * server.
+ *
+ * The wall clock rate includes the publisher's 10 ms sleeps while it waits
+ * for each reply, as it would on a logger; the CPU time is what reading,
+ * parsing and serializing the rows costs.  Run with --quick (as ctest does)
+ * for a small file and one buffer size.
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterBackfill.h"
+#include "IoTPlotterPublisher.h"
+#include "LoopbackServer.h"
+#include "SocketClient.h"
+
+
+static const char dataName[]   = "bench_backfill_data.csv";
+static const char cursorName[] = "bench_backfill_cursor.dat";
+
+
+// Writes a data file as the logger does: the file header, then a row per
+// sample
+static uint32_t writeDataFile(uint8_t vars, uint32_t rows) {
+    FILE* file = fopen(dataName, "wb");
+    if (file == nullptr) return 0;
+    fprintf(file, "Sampling Feature: bench\r\nDate and Time");
+    for (uint8_t i = 0; i < vars; i++) fprintf(file, ",Variable_code_%u", i);
+    fprintf(file, "\r\n");
+    uint32_t epoch = 1650000000UL;
+    for (uint32_t r = 0; r < rows; r++, epoch += 300) {
+        uint32_t day = epoch / 86400UL - 19100;
+        fprintf(file, "2022-04-%02lu %02lu:%02lu:00",
+                static_cast<unsigned long>(1 + day % 28),
+                static_cast<unsigned long>(epoch / 3600 % 24),
+                static_cast<unsigned long>(epoch / 60 % 60));
+        for (uint8_t i = 0; i < vars; i++) {
+            fprintf(file, ",%.3f", 20.0 + i * 0.37 + (r % 100) * 0.01);
+        }
+        fprintf(file, "\r\n");
+    }
+    uint32_t size = static_cast<uint32_t>(ftell(file));
+    fclose(file);
+    return size;
+}
+
+
+static void benchBackfill(LoopbackServer& server, uint8_t vars,
+                          uint16_t bufferSize, uint32_t fileSize) {
+    Logger logger;
+    for (uint8_t i = 0; i < vars; i++) {
+        std::string code = "Variable_code_" + std::to_string(i);
+        logger.addVariable(code.c_str(), 3, 0);
+    }
+    remove(cursorName);
+    IoTPlotterSdStore  data(dataName);
+    IoTPlotterSdStore  cursor(cursorName);
+    std::vector<char>  buffer(bufferSize);
+    IoTPlotterBackfill source(&data, &cursor, buffer.data(), bufferSize);
+    source.begin();
+
+    SocketClient        client(server.port());
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    server.setKeepRequests(false);
+    uint32_t requests = server.requestCount();
+    uint64_t received = server.bytesReceived();
+
+    double start    = hostSeconds();
+    double cpuStart = hostCpuSeconds();
+    int    result   = publisher.backfill(&client, &source);
+    double seconds  = hostSeconds() - start;
+    double cpu      = hostCpuSeconds() - cpuStart;
+    requests        = server.requestCount() - requests;
+    received        = server.bytesReceived() - received;
+    if (result != 201 || !source.isDone()) {
+        printf("backfill stopped at %lu of %lu bytes: %d\n",
+               static_cast<unsigned long>(source.readCursor()),
+               static_cast<unsigned long>(fileSize), result);
+    }
+
+    double rows = static_cast<double>(requests) * IOTPLOTTER_MAX_BATCH;
+    printf("buffer %4u B  %6lu posts  file %6.3f MB/s  %8.0f rows/s  "
+           "cpu %6.2f us/row  sent %5.2f B per file byte\n",
+           bufferSize, static_cast<unsigned long>(requests),
+           fileSize / seconds / 1e6, rows / seconds, cpu / rows * 1e6,
+           static_cast<double>(received) / fileSize);
+}
+
+
+int main(int argc, char** argv) {
+    bool     quick = hostBenchQuick(argc, argv);
+    uint8_t  vars  = IOTPLOTTER_MAX_VARIABLES;
+    uint32_t rows  = quick ? 500 : 20000;
+    std::vector<uint16_t> bufferSizes = {64, 256, 1024};
+    if (quick) bufferSizes = {256};
+
+    uint32_t fileSize = writeDataFile(vars, rows);
+    if (fileSize == 0) {
+        printf("Couldn't write the data file\n");
+        return 1;
+    }
+    LoopbackServer server;
+    if (!server.start()) {
+        printf("Couldn't start the loopback server\n");
+        return 1;
+    }
+    printf("Backfilling %lu rows of %u variables, %.2f MB\n",
+           static_cast<unsigned long>(rows), vars, fileSize / 1e6);
+    for (uint16_t bufferSize : bufferSizes) {
+        benchBackfill(server, vars, bufferSize, fileSize);
+    }
+    server.stop();
+    remove(dataName);
+    remove(cursorName);
+    return 0;
+}
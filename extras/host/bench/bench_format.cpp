@@ -0,0 +1,70 @@
+/**
+ * @file bench_format.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Compares the CPU time per value of the publisher's own formatting
+ * with dtostrf and with the logger's String formatting, for several numbers
+ * of decimal places.
+ */
+
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterFormat.h"
+#include "LoggerBase.h"
+
+
+int main(int argc, char** argv) {
+    bool     quick  = hostBenchQuick(argc, argv);
+    uint32_t rounds = quick ? 20 : 500;
+
+    // Values over the range sensors give
+    std::mt19937                          random(20220915);
+    std::uniform_real_distribution<float> sensor(-1000.0f, 1000.0f);
+    std::vector<float>                    values(1000);
+    for (float& value : values) value = sensor(random);
+
+    printf("places  formatFixed ns  dtostrf ns  String ns\n");
+    for (uint8_t decimals : {0, 2, 4, 6}) {
+        Logger logger;
+        logger.addVariable("Value", decimals, 0);
+        char   text[64];
+        size_t bytes = 0;
+
+        double start = hostCpuSeconds();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (float value : values) {
+                bytes += IoTPlotterFormat::formatFixed(text, value, decimals);
+                hostKeep(text);
+            }
+        }
+        double fixed = hostCpuSeconds() - start;
+
+        start = hostCpuSeconds();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (float value : values) {
+                dtostrf(value, 1, decimals, text);
+                hostKeep(text);
+            }
+        }
+        double printed = hostCpuSeconds() - start;
+
+        start = hostCpuSeconds();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (float value : values) {
+                String formatted = logger.formatValueStringAtI(0, value);
+                bytes += formatted.length();
+            }
+        }
+        double string = hostCpuSeconds() - start;
+
+        double count = static_cast<double>(rounds) * values.size();
+        printf("%6u %15.1f %11.1f %10.1f\n", decimals, fixed / count * 1e9,
+               printed / count * 1e9, string / count * 1e9);
+        hostKeep(&bytes);
+    }
+    return 0;
+}
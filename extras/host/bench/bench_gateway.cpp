@@ -0,0 +1,118 @@
+/**
+ * @file bench_gateway.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Loads the IoTPlotterGateway against the loopback server standing in
+ * for the portal, and reports the samples per second it sustains and the
+ * p99 time from submit() to the portal's answer as the number of stations
+ * grows.
+ *
+ * Two producer threads submit a sample for every station every 5 ms, so the
+ * offered load grows with the station count, waiting only while the ingest
+ * ring is full.  Each load is run with an instant server and with one taking
+ * 2 ms over each request; once the offered load is more than the workers can
+ * post, the samples per second level off and the latency climbs.
+ *
+ * Run with --quick (as ctest does) for a short pass over fewer loads.
+ */
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterGateway.h"
+#include "LoopbackServer.h"
+
+#define BENCH_VARIABLES 5
+#define BENCH_INTERVAL_MS 5
+
+
+static const char* const varCodes[BENCH_VARIABLES] = {"Temp", "RH", "Batt",
+                                                      "Depth", "Cond"};
+
+
+static void run(LoopbackServer& server, uint16_t stations, uint32_t thinkMs,
+                double seconds) {
+    server.setThinkMillis(thinkMs);
+    server.setKeepRequests(false);
+    uint32_t requests = server.requestCount();
+
+    std::vector<std::string> feeds;
+    for (uint16_t s = 0; s < stations; s++) {
+        feeds.push_back("FEED" + std::to_string(s));
+    }
+    IoTPlotterGateway gateway;
+    for (uint16_t s = 0; s < stations; s++) {
+        gateway.addStation(feeds[s].c_str(), "KEY", varCodes, BENCH_VARIABLES,
+                           "127.0.0.1", server.port());
+    }
+    gateway.setBatching(10, 20);
+    gateway.begin();
+
+    std::atomic<bool>        running(true);
+    std::vector<std::thread> producers;
+    double                   start = hostSeconds();
+    for (int p = 0; p < 2; p++) {
+        producers.push_back(std::thread([&, p]() {
+            float    values[BENCH_VARIABLES] = {21.5f, 55.0f, 4.12f, 1.5f, 310};
+            uint32_t epoch                   = 1650000000UL;
+            for (uint32_t round = 1; running; round++) {
+                epoch++;
+                for (uint16_t s = p; s < stations && running; s += 2) {
+                    while (running &&
+                           !gateway.submit(s, epoch, values, BENCH_VARIABLES)) {
+                        std::this_thread::yield();
+                    }
+                }
+                double next = start + round * BENCH_INTERVAL_MS / 1e3;
+                double wait = next - hostSeconds();
+                if (wait > 0) {
+                    std::this_thread::sleep_for(
+                        std::chrono::duration<double>(wait));
+                }
+            }
+        }));
+    }
+    while (hostSeconds() - start < seconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    running = false;
+    for (std::thread& producer : producers) producer.join();
+    gateway.end();
+    double elapsed = hostSeconds() - start;
+
+    IoTPlotterGatewayStats stats = gateway.getStats();
+    printf("%8u %6u %10.0f %12.0f %10.2f %9.3f %9.3f %9lu %9lu\n", stations,
+           thinkMs, stations * 1e3 / BENCH_INTERVAL_MS, stats.acked / elapsed,
+           stats.posts > 0 ? static_cast<double>(stats.acked) / stats.posts
+                           : 0.0,
+           IoTPlotterGateway::latencyPercentile(stats, 50) / 1e3,
+           IoTPlotterGateway::latencyPercentile(stats, 99) / 1e3,
+           static_cast<unsigned long>(stats.dropped),
+           static_cast<unsigned long>(server.requestCount() - requests));
+}
+
+
+int main(int argc, char** argv) {
+    bool                  quick    = hostBenchQuick(argc, argv);
+    double                seconds  = quick ? 0.2 : 3.0;
+    std::vector<uint16_t> stations = {1, 10, 100, 1000};
+    if (quick) stations = {1, 50};
+
+    LoopbackServer server;
+    if (!server.start()) {
+        printf("Couldn't start the loopback server\n");
+        return 1;
+    }
+    printf("stations  think    offered    samples/s  per post   p50 ms    "
+           "p99 ms   dropped  requests\n");
+    for (uint32_t thinkMs : {0, 2}) {
+        for (uint16_t count : stations) run(server, count, thinkMs, seconds);
+    }
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file bench_gzip.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Compares gzipped posts with plain ones to the loopback server: the
+ * bytes on the wire, the CPU time per post and the end to end latency, as
+ * the variable count and batch size grow.
+ *
+ * Each is run with the whole tx buffer sent at each poll and with a small
+ * mtu, which sends the body over many more polls.
+ *
+ * Run with --quick (as ctest does) for a short pass over fewer sizes.
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterPublisher.h"
+#include "LoopbackServer.h"
+#include "SocketClient.h"
+
+
+struct Result {
+    double bytes;  ///< Request bytes on the wire, per post
+    double cpu;    ///< CPU seconds per post
+    double p50;    ///< Median end to end latency, in ms
+    double p99;
+};
+
+
+static Result run(LoopbackServer& server, Logger& logger, uint8_t batch,
+                  IoTPlotterDeflate* deflate, uint16_t mtu, bool quick) {
+    SocketClient        client(server.port());
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED", batch);
+    publisher.setKeepAlive(true);
+    publisher.setMtu(mtu);
+    publisher.setCompression(deflate, 0);
+    server.setKeepRequests(false);
+
+    std::vector<double> latencies;
+    double              cpu      = 0;
+    uint64_t            received = server.bytesReceived();
+    uint32_t            posts    = quick ? 10 : 200;
+    for (uint32_t p = 0; p < posts; p++) {
+        for (uint8_t s = 0; s < batch; s++) {
+            Logger::markedLocalEpochTime += 300;
+            double start    = hostSeconds();
+            double cpuStart = hostCpuSeconds();
+            if (!publisher.startPublish(&client)) continue;
+            // poll() flat out; publishData() sleeps while it waits
+            while (publisher.poll()) {}
+            latencies.push_back((hostSeconds() - start) * 1e3);
+            cpu += hostCpuSeconds() - cpuStart;
+            if (publisher.getPublishResult() != 201) {
+                printf("post failed: %d\n", publisher.getPublishResult());
+            }
+        }
+    }
+    publisher.closeConnection();
+    Result result;
+    result.bytes = static_cast<double>(server.bytesReceived() - received) /
+        posts;
+    result.cpu = cpu / posts;
+    result.p50 = hostPercentile(latencies, 50);
+    result.p99 = hostPercentile(latencies, 99);
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    bool quick = hostBenchQuick(argc, argv);
+    std::vector<uint8_t> varCounts = {5, 20, 50, 100, 200};
+    std::vector<uint8_t> batches   = {1, 5, 10};
+    if (quick) {
+        varCounts = {20, 200};
+        batches   = {1, 10};
+    }
+
+    LoopbackServer server;
+    if (!server.start()) {
+        printf("Couldn't start the loopback server\n");
+        return 1;
+    }
+    static IoTPlotterDeflate deflate;
+    printf("vars batch   mtu    plain B     gzip B  ratio   plain us    "
+           "gzip us  plain p50/p99 ms    gzip p50/p99 ms\n");
+    for (uint8_t vars : varCounts) {
+        Logger logger;
+        for (uint8_t i = 0; i < vars; i++) {
+            std::string code = "Variable_code_" + std::to_string(i);
+            logger.addVariable(code.c_str(), 2, 20.0f + i * 0.37f);
+        }
+        for (uint8_t batch : batches) {
+            for (uint16_t mtu : {0, 128}) {
+                Result plain = run(server, logger, batch, nullptr, mtu, quick);
+                Result gzip = run(server, logger, batch, &deflate, mtu, quick);
+                printf("%4u %5u %5u %10.0f %10.0f %6.3f %10.1f %10.1f "
+                       "%7.3f/%-7.3f %7.3f/%-7.3f\n",
+                       vars, batch, mtu, plain.bytes, gzip.bytes,
+                       gzip.bytes / plain.bytes, plain.cpu * 1e6,
+                       gzip.cpu * 1e6, plain.p50, plain.p99, gzip.p50,
+                       gzip.p99);
+            }
+        }
+    }
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file bench_header.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Measures the CPU time per post with the headers laid out on each
+ * post, from the header cache, and from a header set at compile time.
+ *
+ * Built twice: once with the default header cache, and once with
+ * IOTPLOTTER_HEADER_CACHE_SIZE set to 0, so the two runs compare the cache
+ * against laying the headers out each time.
+ */
+
+#include <stdio.h>
+#include "HostBench.h"
+#include "IoTPlotterPublisher.h"
+#include "NullClient.h"
+
+
+static double timePosts(IoTPlotterPublisher& publisher, NullClient& client,
+                        uint32_t posts) {
+    double start = hostCpuSeconds();
+    for (uint32_t p = 0; p < posts; p++) {
+        // poll() flat out; publishData() sleeps while it waits for a reply
+        publisher.startPublish(&client);
+        while (publisher.poll()) {}
+        if (publisher.getPublishResult() != 201) printf("post failed\n");
+    }
+    return (hostCpuSeconds() - start) / posts;
+}
+
+
+int main(int argc, char** argv) {
+    bool     quick = hostBenchQuick(argc, argv);
+    uint32_t posts = quick ? 2000 : 100000;
+
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable("Batt", 2, 4.12f);
+    logger.addVariable("RH", 2, 55.0f);
+
+    NullClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "0123456789ABCDEF",
+                                  "2222222222");
+    double laidOut = timePosts(publisher, client, posts);
+    uint64_t bytes = client.bytes;
+
+    publisher.setRequestHeader(IOTPLOTTER_REQUEST_HEADER(
+        "2222222222", "0123456789ABCDEF", "Close"));
+    client.bytes   = 0;
+    double fixed   = timePosts(publisher, client, posts);
+
+    printf("header cache %u B: %.3f us/post, static header: %.3f us/post, "
+           "%.1f B/post\n",
+           static_cast<unsigned>(IOTPLOTTER_HEADER_CACHE_SIZE), laidOut * 1e6,
+           fixed * 1e6, static_cast<double>(bytes) / posts);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file bench_payload.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Compares the size of the JSON and CSV bodies as the variable count
+ * and batch size grow.
+ */
+
+#include <stdio.h>
+#include <string>
+#include "HostBench.h"
+#include "IoTPlotterSerializer.h"
+
+
+int main(int argc, char** argv) {
+    bool quick = hostBenchQuick(argc, argv);
+    static IoTPlotterSnapshotBuffer<32768> snapshot;
+    const uint8_t varCounts[] = {1, 5, 20, 50, 100, 200};
+    const uint8_t batches[]   = {1, 5, 10, 20};
+
+    printf("vars batch    json B     csv B  csv/json\n");
+    for (uint8_t vars : varCounts) {
+        if (quick && vars > 20) break;
+        for (uint8_t batch : batches) {
+            snapshot.clear();
+            for (uint8_t i = 0; i < vars; i++) {
+                std::string code = "Variable_code_" + std::to_string(i);
+                snapshot.addVarCode(code.c_str(), code.size());
+            }
+            for (uint8_t s = 0; s < batch; s++) {
+                snapshot.addEpoch(1650000000UL + 300UL * s);
+                for (uint8_t i = 0; i < vars; i++) {
+                    std::string value = std::to_string(20 + i) + ".37";
+                    snapshot.addValue(value.c_str(), value.size());
+                }
+            }
+            if (snapshot.sampleCount() != batch) continue;
+
+            IoTPlotterCountingSink json;
+            IoTPlotterCountingSink csv;
+            IoTPlotterSerializer::writeJson(json, snapshot);
+            IoTPlotterSerializer::writeCsv(csv, snapshot);
+            printf("%4u %5u %9lu %9lu %9.3f\n", vars, batch,
+                   static_cast<unsigned long>(json.count()),
+                   static_cast<unsigned long>(csv.count()),
+                   static_cast<double>(csv.count()) / json.count());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file bench_publisher.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Measures serialization throughput, bytes per variable and end to
+ * end latency to the loopback server, for 1 to 200 variables and several
+ * batch sizes.
+ *
+ * Run with --quick (as ctest does) for a short pass over fewer sizes.
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterPublisher.h"
+#include "LoopbackServer.h"
+#include "SocketClient.h"
+
+
+static void fillLogger(Logger& logger, uint8_t vars) {
+    logger.clearVariables();
+    for (uint8_t i = 0; i < vars; i++) {
+        std::string code = "Variable_code_" + std::to_string(i);
+        logger.addVariable(code.c_str(), 2, 20.0f + i * 0.37f);
+    }
+}
+
+
+static void fillSnapshot(IoTPlotterSnapshot& snapshot, uint8_t vars,
+                         uint8_t samples) {
+    snapshot.clear();
+    for (uint8_t i = 0; i < vars; i++) {
+        std::string code = "Variable_code_" + std::to_string(i);
+        snapshot.addVarCode(code.c_str(), code.size());
+    }
+    for (uint8_t s = 0; s < samples; s++) {
+        snapshot.addEpoch(1650000000UL + 300UL * s);
+        for (uint8_t i = 0; i < vars; i++) {
+            char text[16];
+            dtostrf(20.0 + i * 0.37 + s, 1, 2, text);
+            snapshot.addValue(text, strlen(text));
+        }
+    }
+}
+
+
+// Bytes out of the serializer per second of CPU, and bytes per value
+static void benchSerializer(uint8_t vars, uint8_t batch, bool quick) {
+    static IoTPlotterSnapshotBuffer<32768> snapshot;
+    static char                            buffer[131072];
+    fillSnapshot(snapshot, vars, batch);
+    if (snapshot.sampleCount() != batch) {
+        printf("%4u vars x %2u: doesn't fit the snapshot\n", vars, batch);
+        return;
+    }
+    double rate[2];
+    size_t bytes[2];
+    for (int csv = 0; csv < 2; csv++) {
+        uint32_t rounds = quick ? 200 : 5000;
+        double   start  = hostCpuSeconds();
+        size_t   total  = 0;
+        for (uint32_t r = 0; r < rounds; r++) {
+            IoTPlotterBufferSink sink(buffer, sizeof(buffer));
+            if (csv) {
+                IoTPlotterSerializer::writeCsv(sink, snapshot);
+            } else {
+                IoTPlotterSerializer::writeJson(sink, snapshot);
+            }
+            total += sink.length();
+            hostKeep(buffer);
+        }
+        double seconds = hostCpuSeconds() - start;
+        bytes[csv]     = total / rounds;
+        rate[csv]      = seconds > 0 ? total / seconds / 1e6 : 0;
+    }
+    double values = static_cast<double>(vars) * batch;
+    printf("%4u vars x %2u  json %7zu B %6.1f B/value %8.1f MB/s   "
+           "csv %7zu B %6.1f B/value %8.1f MB/s\n",
+           vars, batch, bytes[0], bytes[0] / values, rate[0], bytes[1],
+           bytes[1] / values, rate[1]);
+}
+
+
+// The time from the batch's last sample to the server's reply.  The publisher
+// is polled flat out; publishData() would add up to 10 ms of sleep while it
+// waits for the reply.
+static void benchEndToEnd(LoopbackServer& server, uint8_t vars, uint8_t batch,
+                          bool quick) {
+    Logger logger;
+    fillLogger(logger, vars);
+    SocketClient        client(server.port());
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED", batch);
+    publisher.setKeepAlive(true);
+    server.setKeepRequests(false);
+
+    std::vector<double> latencies;
+    double              cpu   = 0;
+    uint32_t            posts = quick ? 10 : 200;
+    for (uint32_t p = 0; p < posts; p++) {
+        for (uint8_t s = 0; s < batch; s++) {
+            Logger::markedLocalEpochTime += 300;
+            double start    = hostSeconds();
+            double cpuStart = hostCpuSeconds();
+            if (!publisher.startPublish(&client)) continue;
+            while (publisher.poll()) {}
+            latencies.push_back((hostSeconds() - start) * 1e3);
+            cpu += hostCpuSeconds() - cpuStart;
+            if (publisher.getPublishResult() != 201) {
+                printf("post failed: %d\n", publisher.getPublishResult());
+            }
+        }
+    }
+    publisher.closeConnection();
+    double p50 = hostPercentile(latencies, 50);
+    double p99 = hostPercentile(latencies, 99);
+    printf("%4u vars x %2u  e2e p50 %7.3f ms  p99 %7.3f ms  cpu %7.3f ms/post\n",
+           vars, batch, p50, p99, cpu / posts * 1e3);
+}
+
+
+int main(int argc, char** argv) {
+    bool quick = hostBenchQuick(argc, argv);
+    std::vector<uint8_t> varCounts = {1, 5, 20, 50, 100, 200};
+    std::vector<uint8_t> batches   = {1, 5, 10};
+    if (quick) {
+        varCounts = {1, 20, 200};
+        batches   = {1, 10};
+    }
+
+    printf("Serialization\n");
+    for (uint8_t vars : varCounts) {
+        for (uint8_t batch : batches) benchSerializer(vars, batch, quick);
+    }
+
+    LoopbackServer server;
+    if (!server.start()) {
+        printf("Couldn't start the loopback server\n");
+        return 1;
+    }
+    printf("End to end over loopback, keep-alive\n");
+    for (uint8_t vars : varCounts) {
+        for (uint8_t batch : batches) benchEndToEnd(server, vars, batch, quick);
+    }
+    server.stop();
+    return 0;
+}
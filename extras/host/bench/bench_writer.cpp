@@ -0,0 +1,60 @@
+/**
+ * @file bench_writer.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Measures the CPU time of a whole publish, through a client that
+ * answers at once, as the variable count and batch size grow.
+ *
+ * With the network taken out, what's left is laying out the request and
+ * handing it to the client, which is the time a slow logger spends with the
+ * modem on for every post.
+ *
+ * The clock is manual, so the publisher's waits for the reply cost nothing.
+ * Run with --quick (as ctest does) for a short pass.
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterPublisher.h"
+#include "NullClient.h"
+
+
+int main(int argc, char** argv) {
+    bool     quick = hostBenchQuick(argc, argv);
+    uint32_t posts = quick ? 20 : 2000;
+    hostUseManualClock(true);
+    std::vector<uint8_t> varCounts = {1, 5, 20, 50, 100, 200};
+    std::vector<uint8_t> batches   = {1, 2, IOTPLOTTER_MAX_BATCH};
+
+    printf("vars batch   us/sample  ns/byte    B/sample\n");
+    for (uint8_t vars : varCounts) {
+        Logger logger;
+        for (uint8_t i = 0; i < vars; i++) {
+            std::string code = "Variable_code_" + std::to_string(i);
+            logger.addVariable(code.c_str(), 2, 20.0f + i * 0.37f);
+        }
+        for (uint8_t batch : batches) {
+            if (vars > IOTPLOTTER_MAX_VARIABLES && batch > 1) continue;
+            NullClient          client;
+            IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED",
+                                          batch);
+
+            uint32_t samples = posts * batch;
+            double   start   = hostCpuSeconds();
+            for (uint32_t s = 0; s < samples; s++) {
+                Logger::markedLocalEpochTime += 300;
+                int16_t result = publisher.publishData(&client);
+                if (result != 0 && result != 201) printf("post failed\n");
+            }
+            double seconds = (hostCpuSeconds() - start) / samples;
+            double bytes   = static_cast<double>(client.bytes) / samples;
+            printf("%4u %5u %11.1f %8.2f %11.0f\n", vars, batch,
+                   seconds * 1e6, seconds * 1e9 / bytes, bytes);
+        }
+    }
+    return 0;
+}
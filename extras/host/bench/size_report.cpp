@@ -0,0 +1,131 @@
+/**
+ * @file size_report.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Reports the RAM a publisher takes, piece by piece, and the peak
+ * stack of a publish, for the configuration it was built with.
+ *
+ * Built once per configuration; extras/host/tools/size_report.sh runs them
+ * all and adds the static RAM and code size of each build of the library.
+ * These are host (64 bit) numbers: the arrays, which are most of the RAM,
+ * are the same size on an AVR, while each pointer there is 2 bytes rather
+ * than 8.
+ */
+
+#include <pthread.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "HostBench.h"
+#include "IoTPlotterPublisher.h"
+#include "NullClient.h"
+
+
+static const uint8_t stackPaint = 0xA5;
+
+
+static std::vector<uint8_t> threadStack(256 * 1024);
+
+
+struct PublishJob {
+    IoTPlotterPublisher* publisher;
+    NullClient*          client;
+    int                  result;
+    size_t               used;
+};
+
+
+// Publishes once to warm up the stand-ins (the C library sets things up on
+// first use, on this stack), then paints the unused stack below this frame,
+// publishes again and sees how far down the paint was disturbed
+static void* publish(void* argument) {
+    PublishJob* job = static_cast<PublishJob*>(argument);
+    job->publisher->publishData(job->client);
+
+    uint8_t* frame  = static_cast<uint8_t*>(__builtin_frame_address(0));
+    uint8_t* bottom = threadStack.data();
+    std::fill(bottom, frame - 256, stackPaint);
+    job->result = job->publisher->publishData(job->client);
+    uint8_t* touched = bottom;
+    while (touched < frame && *touched == stackPaint) touched++;
+    job->used = frame - touched;
+    return nullptr;
+}
+
+
+// Runs the job on a thread whose stack can be looked at afterwards
+static void runOnThread(PublishJob& job) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, threadStack.data(), threadStack.size());
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, publish, &job) == 0) {
+        pthread_join(thread, nullptr);
+    }
+    pthread_attr_destroy(&attributes);
+}
+
+
+static void reportStack(const char* label, Logger& logger, bool csv,
+                        bool chunked) {
+    NullClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "0123456789ABCDEF",
+                                  "2222222222");
+    publisher.setCsvPayload(csv);
+    publisher.setChunked(chunked);
+    PublishJob job = {&publisher, &client, 0, 0};
+    runOnThread(job);
+    if (job.result != 201) printf("%s: post failed\n", label);
+    printf("  %-31s %6zu B\n", label, job.used);
+}
+
+
+int main(int argc, char** argv) {
+    hostBenchQuick(argc, argv);
+    printf("RAM per publisher                 %6zu B\n",
+           sizeof(IoTPlotterPublisher));
+    printf("  snapshot arena                  %6u B\n",
+           static_cast<unsigned>(IOTPLOTTER_SNAPSHOT_SIZE));
+    printf("  sample cache                    %6zu B\n",
+           (sizeof(float) * IOTPLOTTER_MAX_VARIABLES + sizeof(uint32_t)) *
+               IOTPLOTTER_MAX_BATCH);
+    printf("  header cache                    %6u B\n",
+           static_cast<unsigned>(IOTPLOTTER_HEADER_CACHE_SIZE));
+    printf("  deadband state                  %6zu B\n",
+           IOTPLOTTER_DEADBAND
+               ? (sizeof(float) * 2 + sizeof(uint32_t)) *
+                       IOTPLOTTER_MAX_VARIABLES +
+                   (IOTPLOTTER_MAX_VARIABLES + 7) / 8 + sizeof(uint32_t)
+               : 0);
+    printf("  metrics, 3 sets                 %6zu B\n",
+           3 * sizeof(IoTPlotterMetrics));
+    printf("  mirrors                         %6zu B\n",
+           sizeof(IoTPlotterDestination) * IOTPLOTTER_MAX_DESTINATIONS);
+    printf("  retry scheduler                 %6zu B\n",
+           sizeof(IoTPlotterRetry));
+    printf("  response parser                 %6zu B\n",
+           sizeof(IoTPlotterResponse));
+
+    Logger logger;
+    for (uint8_t i = 0; i < IOTPLOTTER_MAX_VARIABLES; i++) {
+        std::string code = "Variable_code_" + std::to_string(i);
+        logger.addVariable(code.c_str(), 2, 20.0f + i * 0.37f);
+    }
+    printf("Peak stack of a publish of %u variables\n",
+           static_cast<unsigned>(IOTPLOTTER_MAX_VARIABLES));
+    // The first thread of the process finds the C library doing some more
+    // setting up, so a run is thrown away first
+    {
+        NullClient          client;
+        IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+        PublishJob          job = {&publisher, &client, 0, 0};
+        runOnThread(job);
+    }
+    reportStack("JSON", logger, false, false);
+    reportStack("CSV", logger, true, false);
+    reportStack("JSON, chunked", logger, false, true);
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file CaptureStream.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A Stream that keeps everything printed to it, for comparing what
+ * the publisher prints with what it sends.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_CAPTURESTREAM_H_
+#define EXTRAS_HOST_HARNESS_CAPTURESTREAM_H_
+
+#include <Arduino.h>
+#include <string>
+
+
+/**
+ * @brief A Stream that keeps what's written and has nothing to read
+ */
+class CaptureStream : public Stream {
+ public:
+    size_t write(uint8_t c) override {
+        text += static_cast<char>(c);
+        return 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        text.append(reinterpret_cast<const char*>(buffer), size);
+        return size;
+    }
+    int available(void) override {
+        return 0;
+    }
+    int read(void) override {
+        return -1;
+    }
+    int peek(void) override {
+        return -1;
+    }
+
+    using Print::write;
+
+    std::string text;  ///< Everything written so far
+};
+
+#endif  // EXTRAS_HOST_HARNESS_CAPTURESTREAM_H_
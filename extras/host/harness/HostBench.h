@@ -0,0 +1,75 @@
+/**
+ * @file HostBench.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief The timing and reporting helpers the host benchmarks share.
+ *
+ * Every benchmark takes `--quick` to run a few iterations only, which is how
+ * ctest runs them to make sure they still work.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_HOSTBENCH_H_
+#define EXTRAS_HOST_HARNESS_HOSTBENCH_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+
+/**
+ * @brief Get whether the benchmark was asked for a quick run
+ */
+inline bool hostBenchQuick(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Wall clock time, in seconds from some fixed point
+ */
+inline double hostSeconds(void) {
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief CPU time used by the process, in seconds
+ */
+inline double hostCpuSeconds(void) {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief A percentile of some measurements (which get sorted)
+ *
+ * @param values The measurements
+ * @param percent The percentile, from 0 to 100
+ */
+inline double hostPercentile(std::vector<double>& values, double percent) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(percent / 100.0 * (values.size() - 1) +
+                                       0.5);
+    return values[index];
+}
+
+/**
+ * @brief Keeps the compiler from optimizing a result away
+ */
+template <typename T>
+inline void hostKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif  // EXTRAS_HOST_HARNESS_HOSTBENCH_H_
@@ -0,0 +1,139 @@
+/**
+ * @file HostHttp.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the HostHttpParser.
+ */
+
+#include "HostHttp.h"
+#include <ctype.h>
+#include <stdlib.h>
+#if defined(HOST_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+
+std::string HostHttpRequest::header(const std::string& name) const {
+    std::map<std::string, std::string>::const_iterator found =
+        headers.find(name);
+    return found == headers.end() ? std::string() : found->second;
+}
+
+
+std::string HostHttpRequest::content(void) const {
+    if (header("content-encoding") != "gzip") return body;
+    std::string text;
+    return hostGunzip(body, text) ? text : std::string();
+}
+
+
+// Takes the body off a chunked request, if it's all there; returns the bytes
+// it took up, or 0 if it isn't complete
+static size_t dechunk(const std::string& buffer, size_t start,
+                      std::string& body, bool& bad) {
+    size_t position = start;
+    body.clear();
+    while (true) {
+        size_t lineEnd = buffer.find("\r\n", position);
+        if (lineEnd == std::string::npos) return 0;
+        char*         end  = nullptr;
+        unsigned long size = strtoul(buffer.c_str() + position, &end, 16);
+        if (end == buffer.c_str() + position) {
+            bad = true;
+            return 0;
+        }
+        position = lineEnd + 2;
+        if (size == 0) {
+            // No trailers are sent, just the blank line
+            if (buffer.size() < position + 2) return 0;
+            return position + 2 - start;
+        }
+        if (buffer.size() < position + size + 2) return 0;
+        body.append(buffer, position, size);
+        position += size + 2;
+    }
+}
+
+
+bool HostHttpParser::feed(const char* data, size_t length,
+                          std::vector<HostHttpRequest>& requests) {
+    _buffer.append(data, length);
+    while (true) {
+        size_t headEnd = _buffer.find("\r\n\r\n");
+        if (headEnd == std::string::npos) return true;
+        HostHttpRequest request;
+        request.head = _buffer.substr(0, headEnd + 4);
+
+        // The request line, then one header per line
+        size_t lineEnd      = _buffer.find("\r\n");
+        request.requestLine = _buffer.substr(0, lineEnd);
+        size_t space        = request.requestLine.find(' ');
+        size_t lastSpace    = request.requestLine.rfind(' ');
+        if (space == std::string::npos || lastSpace <= space) return false;
+        request.target =
+            request.requestLine.substr(space + 1, lastSpace - space - 1);
+        size_t position = lineEnd + 2;
+        while (position < headEnd + 2) {
+            size_t      next  = _buffer.find("\r\n", position);
+            std::string line  = _buffer.substr(position, next - position);
+            size_t      colon = line.find(':');
+            if (colon == std::string::npos) return false;
+            std::string name = line.substr(0, colon);
+            for (size_t i = 0; i < name.size(); i++) {
+                name[i] = static_cast<char>(tolower(name[i]));
+            }
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            request.headers[name] = valueStart == std::string::npos
+                ? std::string()
+                : line.substr(valueStart);
+            position = next + 2;
+        }
+
+        size_t bodyStart = headEnd + 4;
+        size_t bodyBytes;
+        if (request.header("transfer-encoding") == "chunked") {
+            bool bad        = false;
+            request.chunked = true;
+            bodyBytes       = dechunk(_buffer, bodyStart, request.body, bad);
+            if (bad) return false;
+            if (bodyBytes == 0) return true;
+        } else {
+            bodyBytes = strtoul(request.header("content-length").c_str(),
+                                nullptr, 10);
+            if (_buffer.size() < bodyStart + bodyBytes) return true;
+            request.body = _buffer.substr(bodyStart, bodyBytes);
+        }
+        request.wireBytes = bodyStart + bodyBytes;
+        _buffer.erase(0, request.wireBytes);
+        requests.push_back(request);
+    }
+}
+
+
+bool hostGunzip(const std::string& data, std::string& text) {
+#if defined(HOST_HAVE_ZLIB)
+    z_stream stream = {};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) return false;
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    text.clear();
+    int  result;
+    char out[4096];
+    do {
+        stream.next_out  = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = sizeof(out);
+        result           = inflate(&stream, Z_NO_FLUSH);
+        text.append(out, sizeof(out) - stream.avail_out);
+    } while (result == Z_OK);
+    bool clean = result == Z_STREAM_END && stream.avail_in == 0;
+    inflateEnd(&stream);
+    return clean;
+#else
+    (void)data;
+    (void)text;
+    return false;
+#endif
+}
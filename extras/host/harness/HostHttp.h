@@ -0,0 +1,88 @@
+/**
+ * @file HostHttp.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the HostHttpParser that picks the publisher's requests back
+ * out of the bytes it sent, for the mock client and the loopback server.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_HOSTHTTP_H_
+#define EXTRAS_HOST_HARNESS_HOSTHTTP_H_
+
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief One request, as the server saw it
+ */
+struct HostHttpRequest {
+    std::string requestLine;  ///< The first line, without its CRLF
+    std::string target;       ///< The request target from the first line
+    /** @brief The headers, by lower case name */
+    std::map<std::string, std::string> headers;
+    std::string head;  ///< Everything up to and including the blank line
+    std::string body;  ///< The body, with any chunking taken off
+    size_t      wireBytes = 0;  ///< The bytes the request took on the wire
+    bool        chunked   = false;
+
+    /**
+     * @brief Get a header's value, or an empty string if it wasn't sent
+     */
+    std::string header(const std::string& name) const;
+    /**
+     * @brief Get the body as the publisher meant it, unzipped if it was
+     * gzipped; an empty string if it doesn't unzip
+     */
+    std::string content(void) const;
+};
+
+
+/**
+ * @brief Splits a stream of request bytes into requests
+ */
+class HostHttpParser {
+ public:
+    /**
+     * @brief Take some more bytes
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @param requests Each request completed by the bytes is added here
+     * @return **bool** False if the bytes can't be a request
+     */
+    bool feed(const char* data, size_t length,
+              std::vector<HostHttpRequest>& requests);
+    /**
+     * @brief Forget any partial request
+     */
+    void reset(void) {
+        _buffer.clear();
+    }
+    /**
+     * @brief Get whether part of a request has been taken
+     */
+    bool hasPartial(void) const {
+        return !_buffer.empty();
+    }
+
+ private:
+    std::string _buffer;
+};
+
+
+/**
+ * @brief Unzip a gzip member
+ *
+ * @param data The gzip member
+ * @param text Set to the unzipped bytes
+ * @return **bool** True if the member unzipped cleanly
+ */
+bool hostGunzip(const std::string& data, std::string& text);
+
+#endif  // EXTRAS_HOST_HARNESS_HOSTHTTP_H_
@@ -0,0 +1,71 @@
+/**
+ * @file HostTest.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief The checks the host tests are written with.
+ *
+ * A failed check is reported with its file and line and the test carries on;
+ * hostTestResult() gives the exit status for main() to return.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_HOSTTEST_H_
+#define EXTRAS_HOST_HARNESS_HOSTTEST_H_
+
+#include <stdio.h>
+#include <sstream>
+#include <string>
+
+
+/**
+ * @brief The number of checks that have failed so far
+ */
+inline int& hostFailures(void) {
+    static int failures = 0;
+    return failures;
+}
+
+inline void hostCheck(bool passed, const char* what, const char* file,
+                      int line) {
+    if (passed) return;
+    hostFailures()++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+}
+
+template <typename A, typename B>
+void hostCheckEqual(const A& expected, const B& actual, const char* what,
+                    const char* file, int line) {
+    if (expected == actual) return;
+    hostFailures()++;
+    std::ostringstream message;
+    message << "expected [" << expected << "] but got [" << actual << "]";
+    fprintf(stderr, "%s:%d: check failed: %s\n  %s\n", file, line, what,
+            message.str().c_str());
+}
+
+/**
+ * @brief Check that a condition holds
+ */
+#define CHECK(condition) hostCheck((condition), #condition, __FILE__, __LINE__)
+/**
+ * @brief Check that a value is what it should be
+ */
+#define CHECK_EQUAL(expected, actual)                                    \
+    hostCheckEqual((expected), (actual), #actual " == " #expected, __FILE__, \
+                   __LINE__)
+
+/**
+ * @brief Report the outcome and give the exit status
+ */
+inline int hostTestResult(void) {
+    if (hostFailures() == 0) {
+        printf("All checks passed\n");
+        return 0;
+    }
+    printf("%d checks failed\n", hostFailures());
+    return 1;
+}
+
+#endif  // EXTRAS_HOST_HARNESS_HOSTTEST_H_
@@ -0,0 +1,140 @@
+/**
+ * @file LoopbackServer.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the LoopbackServer.
+ */
+
+#include "LoopbackServer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+
+
+LoopbackServer::~LoopbackServer() {
+    stop();
+}
+
+
+bool LoopbackServer::start(uint16_t port) {
+    _listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listener < 0) return false;
+    int on = 1;
+    setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address     = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length        = sizeof(address);
+    if (bind(_listener, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+        listen(_listener, 128) != 0 ||
+        getsockname(_listener, reinterpret_cast<sockaddr*>(&address),
+                    &length) != 0) {
+        close(_listener);
+        _listener = -1;
+        return false;
+    }
+    _port     = ntohs(address.sin_port);
+    _running  = true;
+    _acceptor = std::thread(&LoopbackServer::acceptLoop, this);
+    return true;
+}
+
+
+void LoopbackServer::stop(void) {
+    if (!_running) return;
+    _running = false;
+    shutdown(_listener, SHUT_RDWR);
+    close(_listener);
+    _acceptor.join();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _sockets.size(); i++) {
+            shutdown(_sockets[i], SHUT_RDWR);
+        }
+    }
+    for (size_t i = 0; i < _workers.size(); i++) _workers[i].join();
+    _workers.clear();
+    _sockets.clear();
+    _listener = -1;
+}
+
+
+std::vector<HostHttpRequest> LoopbackServer::takeRequests(void) {
+    std::lock_guard<std::mutex>  lock(_mutex);
+    std::vector<HostHttpRequest> requests;
+    requests.swap(_kept);
+    return requests;
+}
+
+
+void LoopbackServer::acceptLoop(void) {
+    while (_running) {
+        int connection = accept(_listener, nullptr, nullptr);
+        if (connection < 0) continue;
+        int on = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        _connections++;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sockets.push_back(connection);
+        _workers.push_back(std::thread(&LoopbackServer::serve, this,
+                                       connection));
+    }
+}
+
+
+void LoopbackServer::serve(int connection) {
+    HostHttpParser               parser;
+    std::vector<HostHttpRequest> requests;
+    char                         buffer[16384];
+    bool                         open = onConnect(connection);
+    while (open) {
+        ssize_t got = recv(connection, buffer, sizeof(buffer), 0);
+        if (got <= 0) break;
+        _bytes += static_cast<uint64_t>(got);
+        requests.clear();
+        if (!parser.feed(buffer, static_cast<size_t>(got), requests)) {
+            const char* bad =
+                "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n"
+                "Connection: close\r\n\r\n";
+            send(connection, bad, strlen(bad), MSG_NOSIGNAL);
+            break;
+        }
+        for (size_t i = 0; i < requests.size() && open; i++) {
+            if (_thinkMs > 0) {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(_thinkMs.load()));
+            }
+            bool close = requests[i].header("connection") == "Close" ||
+                requests[i].header("connection") == "close";
+            std::string reply = "HTTP/1.1 " + std::to_string(_status.load()) +
+                " Status\r\nContent-Length: 0\r\nConnection: " +
+                (close ? "close" : "keep-alive") + "\r\n\r\n";
+            _requests++;
+            if (_keepRequests) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _kept.push_back(requests[i]);
+            }
+            if (send(connection, reply.data(), reply.size(), MSG_NOSIGNAL) <
+                    0 ||
+                close) {
+                open = false;
+            }
+        }
+    }
+    shutdown(connection, SHUT_RDWR);
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _sockets.size(); i++) {
+        if (_sockets[i] == connection) {
+            _sockets.erase(_sockets.begin() + i);
+            break;
+        }
+    }
+    close(connection);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file LoopbackServer.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the LoopbackServer, a stand-in for iotplotter.com that
+ * listens on the loopback interface.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_LOOPBACKSERVER_H_
+#define EXTRAS_HOST_HARNESS_LOOPBACKSERVER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HostHttp.h"
+
+
+/**
+ * @brief A small HTTP/1.1 server on 127.0.0.1 that answers every POST with a
+ * fixed status, keeping connections alive unless asked not to.
+ *
+ * Each connection is served on its own thread.  The requests can be kept for
+ * a test to look at, or just counted, for a benchmark.
+ */
+class LoopbackServer {
+ public:
+    LoopbackServer() {}
+    ~LoopbackServer();
+
+    /**
+     * @brief Start listening
+     *
+     * @param port The port to listen on; 0 for any free one
+     * @return **bool** True if the server is listening
+     */
+    bool start(uint16_t port = 0);
+    /**
+     * @brief Stop listening and drop every connection
+     */
+    void stop(void);
+    /**
+     * @brief Get the port the server is listening on
+     */
+    uint16_t port(void) const {
+        return _port;
+    }
+
+    /**
+     * @brief Set the status every request is answered with
+     */
+    void setStatus(int status) {
+        _status = status;
+    }
+    /**
+     * @brief Set how long the server thinks before answering each request
+     */
+    void setThinkMillis(uint32_t ms) {
+        _thinkMs = ms;
+    }
+    /**
+     * @brief Set whether the requests are kept for takeRequests()
+     */
+    void setKeepRequests(bool keep) {
+        _keepRequests = keep;
+    }
+    /**
+     * @brief Hand over the requests kept since the last call
+     */
+    std::vector<HostHttpRequest> takeRequests(void);
+
+    /**
+     * @brief Get the number of requests answered
+     */
+    uint32_t requestCount(void) const {
+        return _requests;
+    }
+    /**
+     * @brief Get the number of request bytes received
+     */
+    uint64_t bytesReceived(void) const {
+        return _bytes;
+    }
+    /**
+     * @brief Get the number of connections accepted
+     */
+    uint32_t connectionCount(void) const {
+        return _connections;
+    }
+
+ protected:
+    /**
+     * @brief Runs on each new connection before any HTTP; return false to
+     * drop the connection
+     *
+     * @param socket The connection's socket
+     */
+    virtual bool onConnect(int socket) {
+        (void)socket;
+        return true;
+    }
+
+ private:
+    void acceptLoop(void);
+    void serve(int socket);
+
+    int                      _listener     = -1;
+    uint16_t                 _port         = 0;
+    std::atomic<bool>        _running{false};
+    std::atomic<int>         _status{201};
+    std::atomic<uint32_t>    _thinkMs{0};
+    std::atomic<bool>        _keepRequests{true};
+    std::atomic<uint32_t>    _requests{0};
+    std::atomic<uint64_t>    _bytes{0};
+    std::atomic<uint32_t>    _connections{0};
+    std::thread              _acceptor;
+    std::mutex               _mutex;
+    std::vector<std::thread> _workers;
+    std::vector<int>         _sockets;
+    std::vector<HostHttpRequest> _kept;
+};
+
+#endif  // EXTRAS_HOST_HARNESS_LOOPBACKSERVER_H_
@@ -0,0 +1,48 @@
+/**
+ * @file MemoryStore.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the MemoryStore, an IoTPlotterStore kept in RAM.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_MEMORYSTORE_H_
+#define EXTRAS_HOST_HARNESS_MEMORYSTORE_H_
+
+#include <string>
+#include "IoTPlotterStore.h"
+
+
+/**
+ * @brief A store kept in a string, which the tests can look at and damage
+ */
+class MemoryStore : public IoTPlotterStore {
+ public:
+    uint32_t size(void) override {
+        return static_cast<uint32_t>(bytes.size());
+    }
+    size_t read(uint32_t offset, uint8_t* buffer, size_t length) override {
+        if (offset >= bytes.size()) return 0;
+        if (length > bytes.size() - offset) length = bytes.size() - offset;
+        memcpy(buffer, bytes.data() + offset, length);
+        return length;
+    }
+    size_t append(const uint8_t* buffer, size_t length) override {
+        appends++;
+        if (failAppends) return 0;
+        bytes.append(reinterpret_cast<const char*>(buffer), length);
+        return length;
+    }
+    bool clear(void) override {
+        bytes.clear();
+        return true;
+    }
+
+    std::string bytes;                ///< Everything in the store
+    uint32_t    appends     = 0;      ///< Calls to append()
+    bool        failAppends = false;  ///< Whether append() fails
+};
+
+#endif  // EXTRAS_HOST_HARNESS_MEMORYSTORE_H_
@@ -0,0 +1,216 @@
+/**
+ * @file MockClient.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the MockClient, an Arduino Client that plays the part of
+ * the server from a script.
+ *
+ * Everything written to it is kept and split back into requests.  Each
+ * complete request is answered with the next scripted reply, which can arrive
+ * in pieces, each some time after the request, so that slow and partial
+ * responses can be replayed against a manual clock.  Writes can be made slow
+ * or short the same way, as a congested modem's are.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_MOCKCLIENT_H_
+#define EXTRAS_HOST_HARNESS_MOCKCLIENT_H_
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "HostHttp.h"
+
+
+/**
+ * @brief A Client that answers from a script instead of a network
+ */
+class MockClient : public Client {
+ public:
+    /**
+     * @brief Part of a reply, and how long after the request it arrives
+     */
+    struct Piece {
+        uint32_t    afterMs;
+        std::string bytes;
+    };
+    /**
+     * @brief One scripted reply
+     */
+    struct Reply {
+        std::vector<Piece> pieces;
+        /** @brief Whether the server closes the connection after it */
+        bool close = false;
+    };
+
+    /**
+     * @brief Queue a reply that arrives all at once
+     */
+    void queueReply(const std::string& text, uint32_t afterMs = 0,
+                    bool close = false) {
+        Reply reply;
+        reply.pieces.push_back(Piece{afterMs, text});
+        reply.close = close;
+        _replies.push_back(reply);
+    }
+    /**
+     * @brief Queue a reply that arrives in pieces
+     */
+    void queueReply(const Reply& reply) {
+        _replies.push_back(reply);
+    }
+    /**
+     * @brief Queue a bare status line and empty body
+     */
+    void queueStatus(int status, bool close = false) {
+        queueReply("HTTP/1.1 " + std::to_string(status) +
+                       " Status\r\nContent-Length: 0\r\n\r\n",
+                   0, close);
+    }
+    /**
+     * @brief The server drops the connection, as an idle keep-alive
+     * connection is dropped
+     */
+    void dropConnection(void) {
+        _up = false;
+        _inbox.clear();
+    }
+
+    /** @brief The reply sent when nothing else is queued */
+    std::string defaultReply =
+        "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n";
+    /** @brief The next this many connect() calls fail */
+    int refuseConnects = 0;
+    /** @brief The time each write() takes, on the manual clock */
+    uint32_t writeMs = 0;
+    /** @brief The most bytes a write() takes; 0 for any number */
+    size_t writeLimit = 0;
+    /** @brief Every request received, in order */
+    std::vector<HostHttpRequest> requests;
+    /** @brief Every byte written, across all connections */
+    std::string sent;
+    uint32_t    connects = 0;  ///< Successful connect() calls
+    uint32_t    stops    = 0;  ///< Calls to stop()
+    uint32_t    writes   = 0;  ///< Calls to either write()
+    size_t      longest  = 0;  ///< The longest single write()
+
+    int connect(IPAddress, uint16_t) override {
+        return 0;
+    }
+    int connect(const char* host, uint16_t port) override {
+        lastHost = host;
+        lastPort = port;
+        if (refuseConnects > 0) {
+            refuseConnects--;
+            return 0;
+        }
+        connects++;
+        _up = true;
+        _inbox.clear();
+        _parser.reset();
+        _replying = false;
+        return 1;
+    }
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (!_up) return 0;
+        writes++;
+        if (size > longest) longest = size;
+        if (writeMs > 0) hostAdvanceMillis(writeMs);
+        if (writeLimit > 0 && size > writeLimit) size = writeLimit;
+        const char* data = reinterpret_cast<const char*>(buffer);
+        sent.append(data, size);
+        size_t done = requests.size();
+        _parser.feed(data, size, requests);
+        for (; done < requests.size(); done++) startReply();
+        return size;
+    }
+    int available(void) override {
+        release();
+        return static_cast<int>(_inbox.size());
+    }
+    int read(void) override {
+        release();
+        if (_inbox.empty()) return -1;
+        uint8_t c = static_cast<uint8_t>(_inbox[0]);
+        _inbox.erase(0, 1);
+        closeIfDone();
+        return c;
+    }
+    int read(uint8_t* buffer, size_t size) override {
+        size_t count = 0;
+        while (count < size && available() > 0) buffer[count++] = read();
+        return static_cast<int>(count);
+    }
+    int peek(void) override {
+        release();
+        return _inbox.empty() ? -1 : static_cast<uint8_t>(_inbox[0]);
+    }
+    void flush(void) override {}
+    void stop(void) override {
+        stops++;
+        _up = false;
+        _inbox.clear();
+        _replying = false;
+    }
+    uint8_t connected(void) override {
+        return _up || !_inbox.empty();
+    }
+    operator bool(void) override {
+        return _up;
+    }
+
+    std::string lastHost;      ///< Where the last connect() went
+    uint16_t    lastPort = 0;  ///< and on which port
+
+ private:
+    void startReply(void) {
+        if (_replies.empty()) {
+            _reply = Reply();
+            _reply.pieces.push_back(Piece{0, defaultReply});
+        } else {
+            _reply = _replies.front();
+            _replies.pop_front();
+        }
+        _replyStart = millis();
+        _released   = 0;
+        _replying   = true;
+        release();
+    }
+    // Moves the pieces whose time has come into the inbox
+    void release(void) {
+        if (!_replying) return;
+        while (_released < _reply.pieces.size() &&
+               millis() - _replyStart >= _reply.pieces[_released].afterMs) {
+            _inbox += _reply.pieces[_released++].bytes;
+        }
+        if (_released == _reply.pieces.size()) {
+            _replying = false;
+            _closing  = _reply.close;
+            closeIfDone();
+        }
+    }
+    void closeIfDone(void) {
+        if (_closing && _inbox.empty()) {
+            _up      = false;
+            _closing = false;
+        }
+    }
+
+    std::deque<Reply> _replies;
+    Reply             _reply;
+    uint32_t          _replyStart = 0;
+    size_t            _released   = 0;
+    bool              _replying   = false;
+    bool              _closing    = false;
+    bool              _up         = false;
+    std::string       _inbox;
+    HostHttpParser    _parser;
+};
+
+#endif  // EXTRAS_HOST_HARNESS_MOCKCLIENT_H_
@@ -0,0 +1,84 @@
+/**
+ * @file NullClient.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A client that swallows every request and answers each with a 201
+ * straight away, for timing the publisher without any network.
+ *
+ * A request is taken to be finished when the client is read from, which is
+ * all the publisher needs; nothing is parsed.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_NULLCLIENT_H_
+#define EXTRAS_HOST_HARNESS_NULLCLIENT_H_
+
+#include <Arduino.h>
+
+
+/**
+ * @brief A client that counts what's written and always replies 201
+ */
+class NullClient : public Client {
+ public:
+    int connect(IPAddress, uint16_t) override {
+        return 0;
+    }
+    int connect(const char*, uint16_t) override {
+        _up      = true;
+        _replied = 0;
+        return 1;
+    }
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t*, size_t size) override {
+        if (!_up) return 0;
+        bytes += size;
+        _replied = 0;
+        _writing = true;
+        return size;
+    }
+    int available(void) override {
+        if (!_writing) return 0;
+        return static_cast<int>(_replyLength - _replied);
+    }
+    int read(void) override {
+        if (available() <= 0) return -1;
+        uint8_t c = static_cast<uint8_t>(_reply[_replied++]);
+        if (_replied == _replyLength) _writing = false;
+        return c;
+    }
+    int read(uint8_t* buffer, size_t size) override {
+        size_t count = 0;
+        while (count < size && available() > 0) buffer[count++] = read();
+        return static_cast<int>(count);
+    }
+    int peek(void) override {
+        return available() > 0 ? static_cast<uint8_t>(_reply[_replied]) : -1;
+    }
+    void flush(void) override {}
+    void stop(void) override {
+        _up      = false;
+        _writing = false;
+    }
+    uint8_t connected(void) override {
+        return _up;
+    }
+    operator bool(void) override {
+        return _up;
+    }
+
+    uint64_t bytes = 0;  ///< Every byte written
+
+ private:
+    const char* _reply = "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n";
+    size_t      _replyLength = strlen(_reply);
+    size_t      _replied     = 0;
+    bool        _writing     = false;
+    bool        _up          = false;
+};
+
+#endif  // EXTRAS_HOST_HARNESS_NULLCLIENT_H_
@@ -0,0 +1,124 @@
+/**
+ * @file SocketClient.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the SocketClient.
+ */
+
+#include "SocketClient.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+SocketClient::~SocketClient() {
+    stop();
+}
+
+
+int SocketClient::connect(IPAddress, uint16_t) {
+    return 0;
+}
+
+
+int SocketClient::connect(const char* host, uint16_t) {
+    stop();
+    lastHost = host;
+    _socket  = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket < 0) return 0;
+    int on = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in address     = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(_socket, reinterpret_cast<sockaddr*>(&address),
+                  sizeof(address)) != 0) {
+        close(_socket);
+        _socket = -1;
+        return 0;
+    }
+    _closed = false;
+    _inbox.clear();
+    connects++;
+    return 1;
+}
+
+
+size_t SocketClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+
+size_t SocketClient::write(const uint8_t* buffer, size_t size) {
+    if (_socket < 0) return 0;
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t did = send(_socket, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (did <= 0) break;
+        sent += static_cast<size_t>(did);
+    }
+    return sent;
+}
+
+
+// Takes whatever has arrived off the socket, without waiting
+void SocketClient::fill(void) {
+    if (_socket < 0 || _closed) return;
+    char buffer[4096];
+    while (true) {
+        ssize_t got = recv(_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (got > 0) {
+            _inbox.append(buffer, static_cast<size_t>(got));
+            continue;
+        }
+        if (got == 0) _closed = true;
+        break;
+    }
+}
+
+
+int SocketClient::available(void) {
+    fill();
+    return static_cast<int>(_inbox.size());
+}
+
+
+int SocketClient::read(void) {
+    if (available() <= 0) return -1;
+    uint8_t c = static_cast<uint8_t>(_inbox[0]);
+    _inbox.erase(0, 1);
+    return c;
+}
+
+
+int SocketClient::read(uint8_t* buffer, size_t size) {
+    fill();
+    size_t count = size < _inbox.size() ? size : _inbox.size();
+    memcpy(buffer, _inbox.data(), count);
+    _inbox.erase(0, count);
+    return static_cast<int>(count);
+}
+
+
+int SocketClient::peek(void) {
+    if (available() <= 0) return -1;
+    return static_cast<uint8_t>(_inbox[0]);
+}
+
+
+void SocketClient::stop(void) {
+    if (_socket >= 0) close(_socket);
+    _socket = -1;
+    _inbox.clear();
+}
+
+
+uint8_t SocketClient::connected(void) {
+    fill();
+    return _socket >= 0 && (!_closed || !_inbox.empty());
+}
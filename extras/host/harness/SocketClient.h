@@ -0,0 +1,68 @@
+/**
+ * @file SocketClient.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the SocketClient, an Arduino Client over a real TCP socket.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_HARNESS_SOCKETCLIENT_H_
+#define EXTRAS_HOST_HARNESS_SOCKETCLIENT_H_
+
+#include <Arduino.h>
+#include <string>
+
+
+/**
+ * @brief A Client whose every connection goes to one address, whatever host
+ * it is asked for, so that the publisher can be pointed at a LoopbackServer
+ * without changing its host name.
+ *
+ * Reads never block: available() only counts what has already arrived.
+ */
+class SocketClient : public Client {
+ public:
+    /**
+     * @brief Construct a new socket client
+     *
+     * @param port The port on 127.0.0.1 to connect to
+     */
+    explicit SocketClient(uint16_t port) : _port(port) {}
+    ~SocketClient();
+
+    int     connect(IPAddress ip, uint16_t port) override;
+    int     connect(const char* host, uint16_t port) override;
+    size_t  write(uint8_t c) override;
+    size_t  write(const uint8_t* buffer, size_t size) override;
+    int     available(void) override;
+    int     read(void) override;
+    int     read(uint8_t* buffer, size_t size) override;
+    int     peek(void) override;
+    void    flush(void) override {}
+    void    stop(void) override;
+    uint8_t connected(void) override;
+    operator bool(void) override {
+        return _socket >= 0;
+    }
+
+    /**
+     * @brief Get the socket, for a TLS stand-in to talk over
+     */
+    int socket(void) const {
+        return _socket;
+    }
+    std::string lastHost;  ///< The host the last connect() asked for
+    uint32_t    connects = 0;  ///< Successful connect() calls
+
+ private:
+    void fill(void);
+
+    uint16_t    _port;
+    int         _socket = -1;
+    bool        _closed = false;  ///< The server has closed its side
+    std::string _inbox;
+};
+
+#endif  // EXTRAS_HOST_HARNESS_SOCKETCLIENT_H_
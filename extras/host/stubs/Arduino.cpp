@@ -0,0 +1,118 @@
+/**
+ * @file Arduino.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the host stand-in for the Arduino core.
+ */
+
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+
+static bool     manualClock = false;
+static uint32_t manualMillis = 0;
+
+static std::chrono::steady_clock::time_point clockStart =
+    std::chrono::steady_clock::now();
+
+
+uint32_t millis(void) {
+    if (manualClock) return manualMillis;
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - clockStart)
+            .count());
+}
+
+
+void delay(uint32_t ms) {
+    if (manualClock) {
+        manualMillis += ms;
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+
+void yield(void) {
+    if (!manualClock) std::this_thread::yield();
+}
+
+
+void hostUseManualClock(bool manual) {
+    if (manual && !manualClock) manualMillis = millis();
+    manualClock = manual;
+}
+
+
+void hostAdvanceMillis(uint32_t ms) {
+    manualMillis += ms;
+}
+
+
+long random(long howBig) {
+    return howBig > 0 ? rand() % howBig : 0;
+}
+
+
+long random(long howSmall, long howBig) {
+    return howSmall + random(howBig - howSmall);
+}
+
+
+char* ultoa(unsigned long value, char* buffer, int radix) {
+    const char* digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char        reversed[8 * sizeof(value) + 1];
+    int         count = 0;
+    do {
+        reversed[count++] = digits[value % radix];
+        value /= radix;
+    } while (value > 0);
+    for (int i = 0; i < count; i++) buffer[i] = reversed[count - 1 - i];
+    buffer[count] = '\0';
+    return buffer;
+}
+
+
+char* itoa(int value, char* buffer, int radix) {
+    if (value < 0 && radix == 10) {
+        buffer[0] = '-';
+        ultoa(0UL - static_cast<unsigned long>(value), buffer + 1, radix);
+        return buffer;
+    }
+    return ultoa(static_cast<unsigned int>(value), buffer, radix);
+}
+
+
+// Correctly rounded, as the 32-bit ARM cores' dtostrf is
+char* dtostrf(double value, signed char width, unsigned char decimals,
+              char* buffer) {
+    sprintf(buffer, "%*.*f", width, decimals, value);
+    return buffer;
+}
+
+
+// Somewhere for the library's serial output to go
+class HostNullStream : public Stream {
+ public:
+    size_t write(uint8_t) override {
+        return 1;
+    }
+    size_t write(const uint8_t*, size_t size) override {
+        return size;
+    }
+    int available(void) override {
+        return 0;
+    }
+    int read(void) override {
+        return -1;
+    }
+    int peek(void) override {
+        return -1;
+    }
+};
+static HostNullStream nullSerial;
+Stream&               Serial = nullSerial;
@@ -0,0 +1,236 @@
+/**
+ * @file Arduino.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A stand-in for the parts of the Arduino core the library uses, so
+ * that it can be built and exercised on a Linux host.
+ *
+ * Flash and RAM are one and the same here, so the PROGMEM helpers are plain
+ * string functions.  String keeps its text on the heap, like the real one.
+ * The clock runs in real time unless a test switches it to a manual clock,
+ * which only moves when delay() or hostAdvanceMillis() is called.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_STUBS_ARDUINO_H_
+#define EXTRAS_HOST_STUBS_ARDUINO_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+
+// Program memory
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(text) (text)
+class __FlashStringHelper;
+#define F(text) (reinterpret_cast<const __FlashStringHelper*>(text))
+
+inline size_t strlen_P(const char* text) {
+    return strlen(text);
+}
+inline int strcmp_P(const char* a, const char* b) {
+    return strcmp(a, b);
+}
+inline const char* strstr_P(const char* haystack, const char* needle) {
+    return strstr(haystack, needle);
+}
+inline void* memcpy_P(void* destination, const void* source, size_t length) {
+    return memcpy(destination, source, length);
+}
+inline uint8_t pgm_read_byte(const void* address) {
+    return *static_cast<const uint8_t*>(address);
+}
+inline const void* pgm_read_ptr(const void* address) {
+    return *static_cast<const void* const*>(address);
+}
+
+
+// Time
+uint32_t millis(void);
+void     delay(uint32_t ms);
+void     yield(void);
+/**
+ * @brief Host only: stop the clock, so that it only moves when delay() or
+ * hostAdvanceMillis() is called, or set it running in real time again
+ */
+void hostUseManualClock(bool manual);
+/**
+ * @brief Host only: move the manual clock on
+ */
+void hostAdvanceMillis(uint32_t ms);
+
+
+// Numbers
+long  random(long howBig);
+long  random(long howSmall, long howBig);
+char* ultoa(unsigned long value, char* buffer, int radix);
+char* itoa(int value, char* buffer, int radix);
+char* dtostrf(double value, signed char width, unsigned char decimals,
+              char* buffer);
+
+
+/**
+ * @brief The Arduino String, with its text on the heap
+ */
+class String {
+ public:
+    String(void) {}
+    String(const char* text) : _text(text != nullptr ? text : "") {}
+    explicit String(int value) : _text(std::to_string(value)) {}
+    explicit String(unsigned long value) : _text(std::to_string(value)) {}
+
+    unsigned int length(void) const {
+        return static_cast<unsigned int>(_text.size());
+    }
+    const char* c_str(void) const {
+        return _text.c_str();
+    }
+    void toCharArray(char* buffer, unsigned int size) const {
+        if (size == 0) return;
+        strncpy(buffer, _text.c_str(), size);
+        buffer[size - 1] = '\0';
+    }
+    float toFloat(void) const {
+        return static_cast<float>(atof(_text.c_str()));
+    }
+    int indexOf(char c) const {
+        size_t found = _text.find(c);
+        return found == std::string::npos ? -1 : static_cast<int>(found);
+    }
+    String& operator+=(const char* text) {
+        _text += text;
+        return *this;
+    }
+    bool operator==(const char* text) const {
+        return _text == text;
+    }
+
+ private:
+    std::string _text;
+};
+
+
+/**
+ * @brief The Arduino Print, reduced to what the library calls
+ */
+class Print {
+ public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (size-- > 0) written += write(*buffer++);
+        return written;
+    }
+    size_t write(const char* text) {
+        return write(reinterpret_cast<const uint8_t*>(text), strlen(text));
+    }
+    size_t write(const char* buffer, size_t size) {
+        return write(reinterpret_cast<const uint8_t*>(buffer), size);
+    }
+    virtual void flush(void) {}
+
+    size_t print(const char* text) {
+        return write(text);
+    }
+    size_t print(const __FlashStringHelper* text) {
+        return write(reinterpret_cast<const char*>(text));
+    }
+    size_t print(const String& text) {
+        return write(text.c_str());
+    }
+    size_t print(char c) {
+        return write(static_cast<uint8_t>(c));
+    }
+    size_t print(unsigned long value) {
+        return write(std::to_string(value).c_str());
+    }
+    size_t print(long value) {
+        return write(std::to_string(value).c_str());
+    }
+    size_t print(unsigned int value) {
+        return print(static_cast<unsigned long>(value));
+    }
+    size_t print(int value) {
+        return print(static_cast<long>(value));
+    }
+    size_t print(double value, int decimals = 2) {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        return write(buffer);
+    }
+    size_t println(void) {
+        return write("\r\n");
+    }
+    template <typename T>
+    size_t println(T value) {
+        size_t written = print(value);
+        return written + println();
+    }
+};
+
+
+/**
+ * @brief The Arduino Stream, reduced to what the library calls
+ */
+class Stream : public Print {
+ public:
+    virtual int available(void) = 0;
+    virtual int read(void)      = 0;
+    virtual int peek(void)      = 0;
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = read();
+            if (c < 0) break;
+            buffer[count++] = static_cast<char>(c);
+        }
+        return count;
+    }
+    void setTimeout(unsigned long) {}
+};
+
+
+/**
+ * @brief An IP address; the library only ever connects by host name
+ */
+class IPAddress {};
+
+
+/**
+ * @brief The Arduino Client
+ */
+class Client : public Stream {
+ public:
+    virtual int     connect(IPAddress ip, uint16_t port)         = 0;
+    virtual int     connect(const char* host, uint16_t port)     = 0;
+    size_t          write(uint8_t c) override                    = 0;
+    size_t          write(const uint8_t* buffer, size_t size) override = 0;
+    int             available(void) override                     = 0;
+    int             read(void) override                          = 0;
+    virtual int     read(uint8_t* buffer, size_t size)           = 0;
+    int             peek(void) override                          = 0;
+    void            flush(void) override                         = 0;
+    virtual void    stop(void)                                   = 0;
+    virtual uint8_t connected(void)                              = 0;
+    virtual operator bool(void)                                  = 0;
+
+    using Print::write;
+};
+
+
+/**
+ * @brief The serial port; on the host, nothing written to it goes anywhere
+ */
+extern Stream& Serial;
+
+#endif  // EXTRAS_HOST_STUBS_ARDUINO_H_
@@ -0,0 +1,75 @@
+/**
+ * @file LoggerBase.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the host stand-in for the Logger.
+ */
+
+#include "LoggerBase.h"
+
+
+uint32_t Logger::markedLocalEpochTime = 1650000000UL;
+uint32_t Logger::markedUTCEpochTime   = 1650000000UL;
+
+
+uint8_t Logger::getArrayVarCount(void) {
+    return static_cast<uint8_t>(_variables.size());
+}
+
+
+String Logger::getVarCodeAtI(uint8_t varNum) {
+    _stringsMade++;
+    return String(_variables[varNum].varCode.c_str());
+}
+
+
+String Logger::getValueStringAtI(uint8_t varNum) {
+    return formatValueStringAtI(varNum, _variables[varNum].value);
+}
+
+
+float Logger::getValueAtI(uint8_t varNum) {
+    return _variables[varNum].value;
+}
+
+
+String Logger::formatValueStringAtI(uint8_t varNum, float value) {
+    _stringsMade++;
+    if (isnan(value)) value = -9999;
+    char text[48];
+    dtostrf(value, 1, _variables[varNum].decimals, text);
+    return String(text);
+}
+
+
+void Logger::setSamplingFeatureUUID(const char*) {}
+
+
+String Logger::getFileName(void) {
+    return String("logger.csv");
+}
+
+
+bool Logger::turnOnSDcard(bool) {
+    return true;
+}
+
+
+void Logger::turnOffSDcard(bool) {}
+
+
+void Logger::addVariable(const char* varCode, uint8_t decimals, float value) {
+    _variables.push_back(Variable{varCode, decimals, value});
+}
+
+
+void Logger::setValue(uint8_t varNum, float value) {
+    _variables[varNum].value = value;
+}
+
+
+void Logger::clearVariables(void) {
+    _variables.clear();
+}
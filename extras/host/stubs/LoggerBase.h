@@ -0,0 +1,71 @@
+/**
+ * @file LoggerBase.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A stand-in for the ModularSensors Logger, holding a list of
+ * variables that the tests and benchmarks set up directly.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_STUBS_LOGGERBASE_H_
+#define EXTRAS_HOST_STUBS_LOGGERBASE_H_
+
+#include "Arduino.h"
+#include "SdFat.h"
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief The Logger, reduced to the variable array and the marked time
+ *
+ * Values are formatted the way a ModularSensors Variable formats them: with
+ * the variable's resolution, through dtostrf, and -9999 for a missing value.
+ */
+class Logger {
+ public:
+    static uint32_t markedLocalEpochTime;
+    static uint32_t markedUTCEpochTime;
+
+    uint8_t getArrayVarCount(void);
+    String  getVarCodeAtI(uint8_t varNum);
+    String  getValueStringAtI(uint8_t varNum);
+    float   getValueAtI(uint8_t varNum);
+    String  formatValueStringAtI(uint8_t varNum, float value);
+    void    setSamplingFeatureUUID(const char* samplingFeatureUUID);
+    String  getFileName(void);
+    bool    turnOnSDcard(bool waitToSettle = true);
+    void    turnOffSDcard(bool waitForHousekeeping = true);
+
+    /**
+     * @brief Host only: add a variable to the end of the array
+     */
+    void addVariable(const char* varCode, uint8_t decimals, float value);
+    /**
+     * @brief Host only: set the current value of a variable
+     */
+    void setValue(uint8_t varNum, float value);
+    /**
+     * @brief Host only: empty the variable array
+     */
+    void clearVariables(void);
+    /**
+     * @brief Host only: the number of Strings handed out so far
+     */
+    uint32_t stringsMade(void) const {
+        return _stringsMade;
+    }
+
+ private:
+    struct Variable {
+        std::string varCode;
+        uint8_t     decimals;
+        float       value;
+    };
+    std::vector<Variable> _variables;
+    uint32_t              _stringsMade = 0;
+};
+
+#endif  // EXTRAS_HOST_STUBS_LOGGERBASE_H_
@@ -0,0 +1,62 @@
+/**
+ * @file ModSensorDebugger.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A stand-in for the ModularSensors debugging macros.
+ *
+ * Debugging output is dropped.  Whatever the library PRINTOUTs is kept, one
+ * line per call, so that the tests can check what it reported.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_STUBS_MODSENSORDEBUGGER_H_
+#define EXTRAS_HOST_STUBS_MODSENSORDEBUGGER_H_
+
+#include "Arduino.h"
+#include <string>
+
+
+/**
+ * @brief Host only: everything PRINTOUT since the log was last cleared
+ */
+std::string& hostPrintoutLog(void);
+
+inline void hostPrintoutPart(const __FlashStringHelper* text) {
+    hostPrintoutLog() += reinterpret_cast<const char*>(text);
+}
+inline void hostPrintoutPart(const char* text) {
+    hostPrintoutLog() += text;
+}
+inline void hostPrintoutPart(const String& text) {
+    hostPrintoutLog() += text.c_str();
+}
+template <typename T>
+void hostPrintoutPart(T value) {
+    hostPrintoutLog() += std::to_string(value);
+}
+inline void hostPrintoutParts(void) {}
+template <typename T, typename... Rest>
+void hostPrintoutParts(T first, Rest... rest) {
+    hostPrintoutLog() += ' ';
+    hostPrintoutPart(first);
+    hostPrintoutParts(rest...);
+}
+template <typename T, typename... Rest>
+void hostPrintout(T first, Rest... rest) {
+    hostPrintoutPart(first);
+    hostPrintoutParts(rest...);
+    hostPrintoutLog() += '\n';
+}
+
+#define PRINTOUT(...) hostPrintout(__VA_ARGS__)
+#define MS_DBG(...) ((void)0)
+#define MS_DEEP_DBG(...) ((void)0)
+#define MS_START_DEBUG_TIMER          \
+    uint32_t start_millis = millis(); \
+    (void)start_millis
+#define MS_RESET_DEBUG_TIMER start_millis = millis()
+#define MS_PRINT_DEBUG_TIMER millis() - start_millis
+
+#endif  // EXTRAS_HOST_STUBS_MODSENSORDEBUGGER_H_
@@ -0,0 +1,72 @@
+/**
+ * @file SdFat.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the host stand-in for SdFat's File.
+ */
+
+#include "SdFat.h"
+
+
+File::~File() {
+    close();
+}
+
+
+bool File::open(const char* path, oflag_t oflag) {
+    close();
+    const char* mode = "rb";
+    if (oflag & O_TRUNC) {
+        mode = "w+b";
+    } else if (oflag & O_APPEND) {
+        mode = "ab";
+    } else if (oflag & (O_WRONLY | O_RDWR)) {
+        mode = "r+b";
+    }
+    _file = fopen(path, mode);
+    if (_file == nullptr && (oflag & O_CREAT)) _file = fopen(path, "w+b");
+    return _file != nullptr;
+}
+
+
+bool File::close(void) {
+    if (_file == nullptr) return false;
+    fclose(_file);
+    _file = nullptr;
+    return true;
+}
+
+
+uint32_t File::fileSize(void) {
+    if (_file == nullptr) return 0;
+    long position = ftell(_file);
+    fseek(_file, 0, SEEK_END);
+    long size = ftell(_file);
+    fseek(_file, position, SEEK_SET);
+    return size > 0 ? static_cast<uint32_t>(size) : 0;
+}
+
+
+bool File::seekSet(uint32_t position) {
+    return _file != nullptr &&
+        fseek(_file, static_cast<long>(position), SEEK_SET) == 0;
+}
+
+
+int File::read(void* buffer, size_t count) {
+    if (_file == nullptr) return -1;
+    return static_cast<int>(fread(buffer, 1, count, _file));
+}
+
+
+size_t File::write(const void* buffer, size_t count) {
+    if (_file == nullptr) return 0;
+    return fwrite(buffer, 1, count, _file);
+}
+
+
+bool File::sync(void) {
+    return _file != nullptr && fflush(_file) == 0;
+}
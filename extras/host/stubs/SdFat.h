@@ -0,0 +1,49 @@
+/**
+ * @file SdFat.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A stand-in for SdFat's File, kept in an ordinary file in the
+ * current directory.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_STUBS_SDFAT_H_
+#define EXTRAS_HOST_STUBS_SDFAT_H_
+
+#include "Arduino.h"
+
+#define O_RDONLY 0x00
+#define O_WRONLY 0x01
+#define O_RDWR 0x02
+#define O_CREAT 0x40
+#define O_TRUNC 0x200
+#define O_APPEND 0x400
+#define O_READ O_RDONLY
+#define O_WRITE O_WRONLY
+typedef int oflag_t;
+
+
+/**
+ * @brief An SdFat File, reduced to what the library calls
+ */
+class File {
+ public:
+    ~File();
+    bool     open(const char* path, oflag_t oflag = O_RDONLY);
+    bool     close(void);
+    bool     isOpen(void) const {
+        return _file != nullptr;
+    }
+    uint32_t fileSize(void);
+    bool     seekSet(uint32_t position);
+    int      read(void* buffer, size_t count);
+    size_t   write(const void* buffer, size_t count);
+    bool     sync(void);
+
+ private:
+    FILE* _file = nullptr;
+};
+
+#endif  // EXTRAS_HOST_STUBS_SDFAT_H_
@@ -0,0 +1,70 @@
+/**
+ * @file dataPublisherBase.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the host stand-ins for the dataPublisher and the
+ * PRINTOUT log.
+ */
+
+#include "dataPublisherBase.h"
+#include "ModSensorDebugger.h"
+
+
+char        dataPublisher::txBuffer[MS_SEND_BUFFER_SIZE];
+const char* dataPublisher::postHeader = "POST ";
+const char* dataPublisher::HTTPtag    = " HTTP/1.1";
+const char* dataPublisher::hostHeader = "\r\nHost: ";
+
+
+dataPublisher::dataPublisher() {}
+dataPublisher::dataPublisher(Logger& baseLogger, uint8_t sendEveryX,
+                             uint8_t sendOffset)
+    : _baseLogger(&baseLogger),
+      _sendEveryX(sendEveryX),
+      _sendOffset(sendOffset) {}
+dataPublisher::dataPublisher(Logger& baseLogger, Client* inClient,
+                             uint8_t sendEveryX, uint8_t sendOffset)
+    : _baseLogger(&baseLogger),
+      _inClient(inClient),
+      _sendEveryX(sendEveryX),
+      _sendOffset(sendOffset) {}
+dataPublisher::~dataPublisher() {}
+
+
+void dataPublisher::begin(Logger& baseLogger, Client* inClient) {
+    _baseLogger = &baseLogger;
+    _inClient   = inClient;
+}
+void dataPublisher::begin(Logger& baseLogger) {
+    _baseLogger = &baseLogger;
+}
+
+
+int16_t dataPublisher::publishData(void) {
+    return publishData(_inClient);
+}
+
+
+void dataPublisher::emptyTxBuffer(void) {
+    memset(txBuffer, 0, sizeof(txBuffer));
+}
+
+
+int dataPublisher::bufferFree(void) {
+    return MS_SEND_BUFFER_SIZE - static_cast<int>(strlen(txBuffer));
+}
+
+
+void dataPublisher::printTxBuffer(Stream* stream, bool addNewLine) {
+    stream->write(txBuffer, strlen(txBuffer));
+    if (addNewLine) stream->write("\r\n");
+    emptyTxBuffer();
+}
+
+
+std::string& hostPrintoutLog(void) {
+    static std::string log;
+    return log;
+}
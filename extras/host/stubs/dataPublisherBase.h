@@ -0,0 +1,56 @@
+/**
+ * @file dataPublisherBase.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief A stand-in for the ModularSensors dataPublisher base class.
+ */
+
+// Header Guards
+#ifndef EXTRAS_HOST_STUBS_DATAPUBLISHERBASE_H_
+#define EXTRAS_HOST_STUBS_DATAPUBLISHERBASE_H_
+
+#include "LoggerBase.h"
+
+#ifndef MS_SEND_BUFFER_SIZE
+#define MS_SEND_BUFFER_SIZE 750
+#endif
+
+
+/**
+ * @brief The dataPublisher, with its shared send buffer
+ */
+class dataPublisher {
+ public:
+    dataPublisher();
+    explicit dataPublisher(Logger& baseLogger, uint8_t sendEveryX = 1,
+                           uint8_t sendOffset = 0);
+    dataPublisher(Logger& baseLogger, Client* inClient, uint8_t sendEveryX = 1,
+                  uint8_t sendOffset = 0);
+    virtual ~dataPublisher();
+
+    void begin(Logger& baseLogger, Client* inClient);
+    void begin(Logger& baseLogger);
+
+    virtual String  getEndpoint(void)           = 0;
+    virtual int16_t publishData(Client* outClient) = 0;
+    virtual int16_t publishData(void);
+
+ protected:
+    static char txBuffer[MS_SEND_BUFFER_SIZE];
+    static void emptyTxBuffer(void);
+    static int  bufferFree(void);
+    static void printTxBuffer(Stream* stream, bool addNewLine = false);
+
+    Logger* _baseLogger = nullptr;
+    Client* _inClient   = nullptr;
+    uint8_t _sendEveryX = 1;
+    uint8_t _sendOffset = 0;
+
+    static const char* postHeader;
+    static const char* HTTPtag;
+    static const char* hostHeader;
+};
+
+#endif  // EXTRAS_HOST_STUBS_DATAPUBLISHERBASE_H_
@@ -0,0 +1,165 @@
+/**
+ * @file test_backfill.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests that a data file is backfilled row by row, over several
+ * requests when its var codes don't all fit in the snapshot, and that a
+ * logger with more variables than the sample cache holds only backfills those
+ * it has room for.
+ */
+
+#include <map>
+#include <regex>
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterBackfill.h"
+#include "IoTPlotterPublisher.h"
+#include "MemoryStore.h"
+#include "MockClient.h"
+
+
+// The number of values posted for each graph, over all the requests
+static std::map<std::string, int> graphValues(
+    const std::vector<HostHttpRequest>& requests) {
+    std::map<std::string, int> values;
+    std::regex                 graph("\"([^\"]+)\":\\[([^\\]]*)\\]");
+    for (const HostHttpRequest& request : requests) {
+        auto end = std::sregex_iterator();
+        for (auto it = std::sregex_iterator(request.body.begin(),
+                                            request.body.end(), graph);
+             it != end; ++it) {
+            std::string text = (*it)[2].str();
+            for (size_t at = text.find("\"epoch\""); at != std::string::npos;
+                 at = text.find("\"epoch\"", at + 1)) {
+                values[(*it)[1].str()]++;
+            }
+        }
+    }
+    return values;
+}
+
+
+// The var code of a variable, padded out to a length
+static std::string varCode(uint8_t i, size_t length = 0) {
+    std::string code = "V" + std::to_string(i);
+    if (code.size() < length) code.resize(length, 'x');
+    return code;
+}
+
+
+// A data file as the logger writes it: a header row of var codes, then a
+// row per sample
+static std::string dataFile(uint8_t vars, uint8_t rows,
+                            size_t codeLength = 0) {
+    std::string file = "Date and Time";
+    for (uint8_t i = 0; i < vars; i++) file += "," + varCode(i, codeLength);
+    file += "\r\n";
+    for (uint8_t r = 0; r < rows; r++) {
+        char date[32];
+        snprintf(date, sizeof(date), "2022-06-01 12:%02u:00", r);
+        file += date;
+        for (uint8_t i = 0; i < vars; i++) {
+            file += "," + std::to_string(i) + "." + std::to_string(r % 10);
+        }
+        file += "\r\n";
+    }
+    return file;
+}
+
+
+static void testRows(void) {
+    Logger logger;
+    for (uint8_t i = 0; i < 3; i++) {
+        logger.addVariable(("V" + std::to_string(i)).c_str(), 1, 0);
+    }
+    MemoryStore data;
+    MemoryStore cursor;
+    data.bytes = dataFile(3, 12);
+    char               buffer[128];
+    IoTPlotterBackfill source(&data, &cursor, buffer, sizeof(buffer));
+    source.begin();
+
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    CHECK_EQUAL(201, publisher.backfill(&client, &source));
+    CHECK(source.isDone());
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(3u, values.size());
+    for (uint8_t i = 0; i < 3; i++) {
+        CHECK_EQUAL(12, values["V" + std::to_string(i)]);
+    }
+    // Picked up where it left off: nothing more to send
+    client.requests.clear();
+    publisher.backfill(&client, &source);
+    CHECK_EQUAL(0u, client.requests.size());
+}
+
+
+// More var codes than the snapshot holds: every row is still posted for
+// every variable, over several requests
+static void testLongCodes(void) {
+    const uint8_t vars = IOTPLOTTER_MAX_VARIABLES;
+    Logger        logger;
+    for (uint8_t i = 0; i < vars; i++) {
+        logger.addVariable(varCode(i, 80).c_str(), 1, 0);
+    }
+    MemoryStore data;
+    MemoryStore cursor;
+    data.bytes = dataFile(vars, 8, 80);
+    char               buffer[2048];
+    IoTPlotterBackfill source(&data, &cursor, buffer, sizeof(buffer));
+    source.begin();
+
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    CHECK_EQUAL(201, publisher.backfill(&client, &source));
+    CHECK(source.isDone());
+    CHECK(client.requests.size() > 1);
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(static_cast<size_t>(vars), values.size());
+    for (uint8_t i = 0; i < vars; i++) CHECK_EQUAL(8, values[varCode(i, 80)]);
+}
+
+
+// More variables than the cache holds: the first IOTPLOTTER_MAX_VARIABLES
+// are backfilled and the rest reported
+static void testTooManyVariables(void) {
+    const uint8_t vars = IOTPLOTTER_MAX_VARIABLES + 10;
+    Logger        logger;
+    for (uint8_t i = 0; i < vars; i++) {
+        logger.addVariable(("V" + std::to_string(i)).c_str(), 1, 0);
+    }
+    MemoryStore data;
+    MemoryStore cursor;
+    data.bytes = dataFile(vars, 8);
+    char               buffer[256];
+    IoTPlotterBackfill source(&data, &cursor, buffer, sizeof(buffer));
+    source.begin();
+
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    hostPrintoutLog().clear();
+    CHECK_EQUAL(201, publisher.backfill(&client, &source));
+    CHECK(source.isDone());
+    CHECK(hostPrintoutLog().find("backfilled") != std::string::npos);
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(static_cast<size_t>(IOTPLOTTER_MAX_VARIABLES), values.size());
+    for (uint8_t i = 0; i < IOTPLOTTER_MAX_VARIABLES; i++) {
+        CHECK_EQUAL(8, values["V" + std::to_string(i)]);
+    }
+
+    // Live publishing still reports every variable
+    client.requests.clear();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(static_cast<size_t>(vars), graphValues(client.requests).size());
+}
+
+
+int main() {
+    testRows();
+    testLongCodes();
+    testTooManyVariables();
+    return hostTestResult();
+}
@@ -0,0 +1,124 @@
+/**
+ * @file test_format.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests the publisher's number formatting against dtostrf, and the
+ * decimal places it publishes each variable with.
+ */
+
+#include <math.h>
+#include <random>
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterFormat.h"
+#include "IoTPlotterPublisher.h"
+#include "MockClient.h"
+
+
+static std::string fixed(float value, uint8_t decimals) {
+    char    text[IOTPLOTTER_NUMBER_TEXT_SIZE];
+    uint8_t length = IoTPlotterFormat::formatFixed(text, value, decimals);
+    return std::string(text, length);
+}
+
+
+static std::string reference(float value, uint8_t decimals) {
+    char text[64];
+    dtostrf(value, 1, decimals, text);
+    return text;
+}
+
+
+// Checks one value at every number of places
+static bool matches(float value) {
+    for (uint8_t decimals = 0; decimals <= IOTPLOTTER_MAX_DECIMALS;
+         decimals++) {
+        if (fixed(value, decimals) != reference(value, decimals)) {
+            CHECK_EQUAL(reference(value, decimals), fixed(value, decimals));
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Ties, carries, the smallest fractions and the largest values
+static void testEdges(void) {
+    const float values[] = {0.0f,      -0.0f,       0.5f,        1.5f,
+                            2.5f,      -2.5f,       0.125f,      0.375f,
+                            0.995f,    9.9999995f,  999.9995f,   -1.005f,
+                            1e-10f,    4.6566129e-10f, 5e-10f,   1e-9f,
+                            0.1f,      123456.789f, 16777215.0f, 16777216.0f,
+                            3.9e9f,    -3.9e9f,     1.17549435e-38f};
+    for (float value : values) matches(value);
+
+    // The same text as ever for a sensor's usual values
+    CHECK_EQUAL(std::string("21.50"), fixed(21.5f, 2));
+    CHECK_EQUAL(std::string("0.12"), fixed(0.125f, 2));
+    CHECK_EQUAL(std::string("-0.00"), fixed(-0.0f, 2));
+    CHECK_EQUAL(std::string("2"), fixed(2.5f, 0));
+
+    // Left to the logger
+    CHECK_EQUAL(std::string(""), fixed(NAN, 2));
+    CHECK_EQUAL(std::string(""), fixed(INFINITY, 2));
+    CHECK_EQUAL(std::string(""), fixed(5e9f, 2));
+}
+
+
+// Every float in range, picked at random from its bits, and values spread
+// over the range sensors give
+static void testRandom(void) {
+    std::mt19937 random(20220915);
+    int          failures = 0;
+    for (int i = 0; i < 100000 && failures < 10; i++) {
+        uint32_t bits = random();
+        float    value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!(value > -4.0e9f && value < 4.0e9f)) continue;
+        if (!matches(value)) failures++;
+    }
+    std::uniform_real_distribution<float> sensor(-1000.0f, 1000.0f);
+    for (int i = 0; i < 100000 && failures < 10; i++) {
+        if (!matches(sensor(random))) failures++;
+    }
+    CHECK_EQUAL(0, failures);
+}
+
+
+// Places are learned from the logger once for each variable it can keep them
+// for, and the rest get the default without a String each time
+static void testPrecisions(void) {
+    Logger logger;
+    for (int i = 0; i < IOTPLOTTER_MAX_PRECISIONS + 4; i++) {
+        logger.addVariable(("V" + std::to_string(i)).c_str(), 3, 1.5f);
+    }
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setPrecision(1, 1);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    std::string body;
+    for (const HostHttpRequest& request : client.requests) body += request.body;
+    CHECK(body.find("\"V0\":[{\"value\":1.500,") != std::string::npos);
+    CHECK(body.find("\"V1\":[{\"value\":1.5,") != std::string::npos);
+    std::string last = "\"V" + std::to_string(IOTPLOTTER_MAX_PRECISIONS - 1) +
+        "\":[{\"value\":1.500,";
+    CHECK(body.find(last) != std::string::npos);
+    std::string past = "\"V" + std::to_string(IOTPLOTTER_MAX_PRECISIONS) +
+        "\":[{\"value\":1.50,";
+    CHECK(body.find(past) != std::string::npos);
+
+    // Nothing more to ask the logger the second time
+    uint32_t made = logger.stringsMade();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(made, logger.stringsMade());
+}
+
+
+int main() {
+    testEdges();
+    testRandom();
+    testPrecisions();
+    return hostTestResult();
+}
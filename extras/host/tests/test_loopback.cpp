@@ -0,0 +1,65 @@
+/**
+ * @file test_loopback.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests the publisher end to end over a real TCP connection to the
+ * loopback stand-in server.
+ */
+
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterPublisher.h"
+#include "LoopbackServer.h"
+#include "SocketClient.h"
+
+
+static void testPosts(LoopbackServer& server) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable("Batt", 2, 4.12f);
+    logger.addVariable("RH", 2, 55.0f);
+    SocketClient        client(server.port());
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    std::vector<HostHttpRequest> requests = server.takeRequests();
+    CHECK_EQUAL(1u, requests.size());
+    if (requests.size() == 1) {
+        CHECK_EQUAL(std::string("KEY"), requests[0].header("api-key"));
+        CHECK_EQUAL(std::to_string(requests[0].body.size()),
+                    requests[0].header("content-length"));
+        CHECK_EQUAL(std::string("{\"data\":{\"Temp\":[{\"value\":21.50, "
+                                "\"epoch\":1650000000}],\"Batt\":[{\"value\":"
+                                "4.12, \"epoch\":1650000000}],\"RH\":[{"
+                                "\"value\":55.00, \"epoch\":1650000000}]}}"),
+                    requests[0].body);
+    }
+
+    // Keep-alive holds the one connection across posts
+    uint32_t connections = server.connectionCount();
+    publisher.setKeepAlive(true);
+    for (int i = 0; i < 5; i++) CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(connections + 1, server.connectionCount());
+    CHECK_EQUAL(5u, server.takeRequests().size());
+    publisher.closeConnection();
+
+    // Errors come back as the status
+    server.setStatus(500);
+    publisher.setKeepAlive(false);
+    CHECK_EQUAL(500, publisher.publishData(&client));
+    server.setStatus(201);
+}
+
+
+int main() {
+    LoopbackServer server;
+    if (!server.start()) {
+        printf("Couldn't start the loopback server\n");
+        return 1;
+    }
+    testPosts(server);
+    server.stop();
+    return hostTestResult();
+}
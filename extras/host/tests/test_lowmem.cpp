@@ -0,0 +1,49 @@
+/**
+ * @file test_lowmem.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests that the low-memory build sends the same requests as the
+ * normal build.
+ */
+
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterPublisher.h"
+#include "MockClient.h"
+
+
+static void testSameRequests(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable("Batt", 2, 4.12f);
+    logger.addVariable("RH", 2, 55.0f);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(std::string(
+                    "POST http://iotplotter.com/api/v2/feed/FEED HTTP/1.1\r\n"
+                    "Connection: Close\r\n"
+                    "api-key: KEY\r\n"
+                    "Content-Type: application/x-www-form-urlencoded\r\n"
+                    "Host: iotplotter.com\r\n"
+                    "Content-Length: 142\r\n"
+                    "\r\n"
+                    "{\"data\":{\"Temp\":[{\"value\":21.50, \"epoch\":"
+                    "1650000000}],\"Batt\":[{\"value\":4.12, \"epoch\":"
+                    "1650000000}],\"RH\":[{\"value\":55.00, \"epoch\":"
+                    "1650000000}]}}"),
+                client.sent);
+
+    // Keep-alive still works
+    publisher.setKeepAlive(true);
+    for (int i = 0; i < 3; i++) CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(2u, client.connects);
+}
+
+
+int main() {
+    testSameRequests();
+    return hostTestResult();
+}
@@ -0,0 +1,181 @@
+/**
+ * @file test_paging.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests that variables that don't all fit in the snapshot are posted
+ * over several requests, each variable exactly once per sample.
+ */
+
+#include <map>
+#include <regex>
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterPublisher.h"
+#include "MockClient.h"
+
+
+// The number of values posted for each graph, over all the requests
+static std::map<std::string, int> graphValues(
+    const std::vector<HostHttpRequest>& requests) {
+    std::map<std::string, int> values;
+    std::regex                 graph("\"([^\"]+)\":\\[([^\\]]*)\\]");
+    for (const HostHttpRequest& request : requests) {
+        CHECK_EQUAL(std::to_string(request.body.size()),
+                    request.header("content-length"));
+        auto end = std::sregex_iterator();
+        for (auto it = std::sregex_iterator(request.body.begin(),
+                                            request.body.end(), graph);
+             it != end; ++it) {
+            std::string text = (*it)[2].str();
+            int         count = 0;
+            for (size_t at = text.find("\"epoch\""); at != std::string::npos;
+                 at = text.find("\"epoch\"", at + 1)) {
+                count++;
+            }
+            values[(*it)[1].str()] += count;
+        }
+    }
+    return values;
+}
+
+
+static std::string longCode(uint8_t i, size_t length) {
+    std::string code = "Var" + std::to_string(i) + "_";
+    code.resize(length, 'x');
+    return code;
+}
+
+
+// More var codes than the snapshot holds, one sample
+static void testUnbatched(void) {
+    Logger logger;
+    for (uint8_t i = 0; i < 100; i++) {
+        logger.addVariable(longCode(i, 40).c_str(), 2, i * 0.5f);
+    }
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    hostPrintoutLog().clear();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK(client.requests.size() > 1);
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(100u, values.size());
+    for (uint8_t i = 0; i < 100; i++) CHECK_EQUAL(1, values[longCode(i, 40)]);
+    CHECK(hostPrintoutLog().find("leaving it out") == std::string::npos);
+
+    // And again, from wherever the last publish left off
+    client.requests.clear();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    values = graphValues(client.requests);
+    CHECK_EQUAL(100u, values.size());
+    for (uint8_t i = 0; i < 100; i++) CHECK_EQUAL(1, values[longCode(i, 40)]);
+}
+
+
+// Every request for a batch carries every sample of the batch
+static void testBatched(void) {
+    Logger logger;
+    for (uint8_t i = 0; i < IOTPLOTTER_MAX_VARIABLES; i++) {
+        logger.addVariable(longCode(i, 60).c_str(), 1, i * 0.5f);
+    }
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED", 3);
+    for (int i = 0; i < 3; i++) {
+        Logger::markedLocalEpochTime += 60;
+        CHECK_EQUAL(i < 2 ? 0 : 201, publisher.publishData(&client));
+    }
+    CHECK(client.requests.size() > 1);
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(static_cast<size_t>(IOTPLOTTER_MAX_VARIABLES), values.size());
+    for (uint8_t i = 0; i < IOTPLOTTER_MAX_VARIABLES; i++) {
+        CHECK_EQUAL(3, values[longCode(i, 60)]);
+    }
+}
+
+
+// A mirror's mask picks variables by their place in the logger, whichever
+// request they fall in
+static void testMirrorMask(void) {
+    Logger logger;
+    for (uint8_t i = 0; i < 100; i++) {
+        logger.addVariable(longCode(i, 40).c_str(), 2, i * 0.5f);
+    }
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    static uint8_t      onlyLast[13] = {};
+    onlyLast[90 / 8] = 1 << (90 % 8);
+    CHECK(publisher.addDestination("FEED2", "KEY2", onlyLast));
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    std::vector<HostHttpRequest> feed;
+    std::vector<HostHttpRequest> mirror;
+    for (const HostHttpRequest& request : client.requests) {
+        (request.header("api-key") == "KEY2" ? mirror : feed)
+            .push_back(request);
+    }
+    CHECK_EQUAL(100u, graphValues(feed).size());
+    std::map<std::string, int> values = graphValues(mirror);
+    CHECK_EQUAL(1u, values.size());
+    CHECK_EQUAL(1, values[longCode(90, 40)]);
+}
+
+
+// A var code longer than the snapshot is streamed from the logger
+static void testTooLong(void) {
+    Logger      logger;
+    std::string tooLong = longCode(1, IOTPLOTTER_SNAPSHOT_SIZE + 100);
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable(tooLong.c_str(), 2, 1);
+    logger.addVariable("RH", 2, 55.0f);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    hostPrintoutLog().clear();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    std::map<std::string, int> values = graphValues(client.requests);
+    CHECK_EQUAL(3u, values.size());
+    CHECK_EQUAL(1, values["Temp"]);
+    CHECK_EQUAL(1, values[tooLong]);
+    CHECK_EQUAL(1, values["RH"]);
+    CHECK(hostPrintoutLog().find("leaving it out") == std::string::npos);
+
+    // On its own, and again as CSV
+    logger.clearVariables();
+    logger.addVariable(tooLong.c_str(), 2, 1);
+    client.requests.clear();
+    IoTPlotterPublisher alone(logger, &client, "KEY", "FEED");
+    CHECK_EQUAL(201, alone.publishData(&client));
+    CHECK_EQUAL(1, graphValues(client.requests)[tooLong]);
+    client.requests.clear();
+    alone.setCsvPayload(true);
+    CHECK_EQUAL(201, alone.publishData(&client));
+    CHECK_EQUAL(1u, client.requests.size());
+    if (client.requests.empty()) return;
+    CHECK_EQUAL("epoch," + tooLong + "\n" +
+                    std::to_string(Logger::markedLocalEpochTime) + ",1.00\n",
+                client.requests[0].body);
+}
+
+
+// Var codes that all fit are only fetched from the logger once
+static void testCodesKept(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable("Batt", 2, 4.12f);
+    logger.addVariable("RH", 2, 55.0f);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    uint32_t made = logger.stringsMade();
+    for (int i = 0; i < 3; i++) CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(made, logger.stringsMade());
+}
+
+
+int main() {
+    testUnbatched();
+    testBatched();
+    testMirrorMask();
+    testTooLong();
+    testCodesKept();
+    return hostTestResult();
+}
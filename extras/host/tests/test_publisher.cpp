@@ -0,0 +1,625 @@
+/**
+ * @file test_publisher.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests the requests the publisher sends, byte for byte, against a
+ * scripted client.
+ */
+
+#include <string>
+#include "CaptureStream.h"
+#include "HostTest.h"
+#include "IoTPlotterPublisher.h"
+#include "IoTPlotterQueue.h"
+#include "MemoryStore.h"
+#include "MockClient.h"
+
+
+static const char expectedRequest[] =
+    "POST http://iotplotter.com/api/v2/feed/FEED HTTP/1.1\r\n"
+    "Connection: Close\r\n"
+    "api-key: KEY\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Host: iotplotter.com\r\n"
+    "Content-Length: 142\r\n"
+    "\r\n"
+    "{\"data\":{\"Temp\":[{\"value\":21.50, \"epoch\":1650000000}],"
+    "\"Batt\":[{\"value\":4.12, \"epoch\":1650000000}],"
+    "\"RH\":[{\"value\":55.00, \"epoch\":1650000000}]}}";
+
+
+static void setVariables(Logger& logger, uint8_t count) {
+    logger.clearVariables();
+    if (count == 3) {
+        logger.addVariable("Temp", 2, 21.5f);
+        logger.addVariable("Batt", 2, 4.12f);
+        logger.addVariable("RH", 2, 55.0f);
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        std::string code = "Variable_code_" + std::to_string(i);
+        logger.addVariable(code.c_str(), i % 4, i * 1.5f);
+    }
+}
+
+
+// Checks that a request's Content-Length is the length of its body
+static void checkLength(const HostHttpRequest& request) {
+    CHECK(!request.chunked);
+    CHECK_EQUAL(std::to_string(request.body.size()),
+                request.header("content-length"));
+}
+
+
+static void testSinglePost(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    Logger::markedLocalEpochTime = 1650000000UL;
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(std::string(expectedRequest), client.sent);
+    CHECK_EQUAL(std::string("iotplotter.com"), client.lastHost);
+    CHECK_EQUAL(80, client.lastPort);
+    CHECK_EQUAL(1u, client.stops);
+    CHECK_EQUAL(1, publisher.getLastMetrics().posts);
+    CHECK_EQUAL(client.sent.size(), publisher.getLastMetrics().bytesWritten);
+    CHECK_EQUAL(1, publisher.getLastMetrics().responses[2]);
+    CHECK_EQUAL(1, publisher.getTotalMetrics().posts);
+
+    // What's printed is what's sent, and the size is the size of the body
+    CaptureStream printed;
+    publisher.printIoTPlotterRequest(&printed);
+    CHECK(printed.text == client.sent);
+    CaptureStream json;
+    publisher.printSensorDataJSON(&json);
+    CHECK_EQUAL(client.requests[0].body, json.text);
+    CHECK_EQUAL(json.text.size(), publisher.calculateJsonSize());
+}
+
+
+// Printing or measuring the JSON part way through a publish shows the snapshot
+// being posted and leaves it alone
+static void testPrintWhilePublishing(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    CHECK(publisher.startPublish(&client));
+    logger.setValue(0, 99.25f);
+    uint16_t      size = publisher.calculateJsonSize();
+    CaptureStream json;
+    publisher.printSensorDataJSON(&json);
+    CaptureStream printed;
+    publisher.printIoTPlotterRequest(&printed);
+    while (publisher.poll()) {}
+    CHECK_EQUAL(201, publisher.getPublishResult());
+    CHECK_EQUAL(1u, client.requests.size());
+    if (client.requests.empty()) return;
+    CHECK(client.requests[0].body.find("21.50") != std::string::npos);
+    CHECK_EQUAL(client.requests[0].body, json.text);
+    CHECK_EQUAL(json.text.size(), size);
+    CHECK(printed.text.empty());
+
+    // Afterwards, they show the logger's values again
+    CaptureStream after;
+    publisher.printSensorDataJSON(&after);
+    CHECK(after.text.find("99.25") != std::string::npos);
+}
+
+
+// A request header built at compile time gives the very same request
+static void testStaticHeader(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          first;
+    MockClient          second;
+    IoTPlotterPublisher publisher(logger, "KEY", "FEED");
+    CHECK_EQUAL(201, publisher.publishData(&first));
+    publisher.setRequestHeader(IOTPLOTTER_REQUEST_HEADER("FEED", "KEY",
+                                                         "Close"));
+    CHECK_EQUAL(201, publisher.publishData(&second));
+    CHECK(first.sent == second.sent);
+}
+
+
+static void testLengths(void) {
+    Logger logger;
+    for (uint8_t vars : {1, 2, 7, 20, 40}) {
+        setVariables(logger, vars);
+        for (int csv = 0; csv < 2; csv++) {
+            MockClient          client;
+            IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+            publisher.setCsvPayload(csv != 0);
+            CHECK_EQUAL(201, publisher.publishData(&client));
+            CHECK_EQUAL(1u, client.requests.size());
+            if (client.requests.empty()) continue;
+            checkLength(client.requests[0]);
+            CHECK_EQUAL(std::string(csv ? "http://iotplotter.com/api/v2/feed/"
+                                          "FEED.csv"
+                                        : "http://iotplotter.com/api/v2/feed/"
+                                          "FEED"),
+                        client.requests[0].target);
+        }
+    }
+}
+
+
+static void testBatch(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    Logger::markedLocalEpochTime = 1650000000UL;
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED", 3);
+    for (int i = 0; i < 3; i++) {
+        Logger::markedLocalEpochTime += 60;
+        CHECK_EQUAL(i < 2 ? 0 : 201, publisher.publishData(&client));
+    }
+    CHECK_EQUAL(1u, client.requests.size());
+    if (client.requests.empty()) return;
+    checkLength(client.requests[0]);
+    CHECK_EQUAL(std::string("{\"data\":{\"Temp\":[{\"value\":21.50, "
+                            "\"epoch\":1650000060},{\"value\":21.50, "
+                            "\"epoch\":1650000120},{\"value\":21.50, "
+                            "\"epoch\":1650000180}],\"Batt\":[{\"value\":4.12, "
+                            "\"epoch\":1650000060},{\"value\":4.12, "
+                            "\"epoch\":1650000120},{\"value\":4.12, "
+                            "\"epoch\":1650000180}],\"RH\":[{\"value\":55.00, "
+                            "\"epoch\":1650000060},{\"value\":55.00, "
+                            "\"epoch\":1650000120},{\"value\":55.00, "
+                            "\"epoch\":1650000180}]}}"),
+                client.requests[0].body);
+}
+
+
+// Each post is mirrored to every destination, with just its own variables,
+// and a mirror that fails doesn't fail the publish
+static void testMirrors(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    Logger::markedLocalEpochTime = 1650000000UL;
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    static const uint8_t battOnly[1] = {0x02};
+    CHECK(publisher.addDestination("FEED2", "KEY2", battOnly));
+    CHECK(publisher.addDestination("FEED3", "KEY3", nullptr, "example.com",
+                                   8080));
+    CHECK(!publisher.addDestination("FEED4", "KEY4"));
+
+    client.queueStatus(201);
+    client.queueStatus(201);
+    client.queueStatus(500);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(3u, client.requests.size());
+    if (client.requests.size() != 3) return;
+    CHECK(client.requests[0].body.find("Temp") != std::string::npos);
+    CHECK_EQUAL(std::string("KEY2"), client.requests[1].header("api-key"));
+    CHECK_EQUAL(std::string("http://iotplotter.com/api/v2/feed/FEED2"),
+                client.requests[1].target);
+    CHECK(client.requests[1].body.find("Temp") == std::string::npos);
+    CHECK(client.requests[1].body.find("Batt") != std::string::npos);
+    checkLength(client.requests[1]);
+    CHECK_EQUAL(std::string("example.com"), client.lastHost);
+    CHECK_EQUAL(8080, client.lastPort);
+    CHECK(client.requests[2].body == client.requests[0].body);
+
+    // A feed that fails isn't mirrored
+    client.queueStatus(500);
+    CHECK_EQUAL(500, publisher.publishData(&client));
+    CHECK_EQUAL(4u, client.requests.size());
+}
+
+
+// A variable inside its deadband is left out, and a publish where nothing
+// has changed posts nothing
+static void testDeadband(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    Logger::markedLocalEpochTime = 1650000000UL;
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setDeadband(0, 1.0f);
+    publisher.setDeadband(1, 0.1f);
+
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    logger.setValue(0, 22.0f);
+    Logger::markedLocalEpochTime += 300;
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(2u, client.requests.size());
+    if (client.requests.size() == 2) {
+        checkLength(client.requests[1]);
+        CHECK(client.requests[1].body.find("Temp") == std::string::npos);
+        CHECK(client.requests[1].body.find("Batt") == std::string::npos);
+        CHECK(client.requests[1].body.find("RH") != std::string::npos);
+    }
+
+    // Past the deadband, and past the longest silence
+    publisher.setDeadband(2, 0.0f);
+    logger.setValue(0, 23.0f);
+    Logger::markedLocalEpochTime += 300;
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(3u, client.requests.size());
+    if (client.requests.size() == 3) {
+        CHECK(client.requests[2].body.find("Temp") != std::string::npos);
+        CHECK(client.requests[2].body.find("Batt") == std::string::npos);
+    }
+    publisher.setMaxSilence(600);
+    Logger::markedLocalEpochTime += 300;
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(4u, client.requests.size());
+    if (client.requests.size() == 4) {
+        CHECK(client.requests[3].body.find("Temp") == std::string::npos);
+        CHECK(client.requests[3].body.find("Batt") != std::string::npos);
+    }
+
+    // Nothing changed
+    publisher.setMaxSilence(0);
+    Logger::markedLocalEpochTime += 300;
+    CHECK_EQUAL(0, publisher.publishData(&client));
+    CHECK_EQUAL(4u, client.requests.size());
+}
+
+
+// A chunked body, or one sent in MTU-sized writes, is the same body
+static void testChunkedAndMtu(void) {
+    Logger logger;
+    setVariables(logger, 40);
+    std::string reference;
+    for (int chunked = 0; chunked < 2; chunked++) {
+        for (uint16_t mtu : {0, 64, 100, 256, 2000}) {
+            MockClient          client;
+            IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+            publisher.setChunked(chunked != 0);
+            publisher.setMtu(mtu);
+            CHECK_EQUAL(201, publisher.publishData(&client));
+            CHECK_EQUAL(1u, client.requests.size());
+            if (client.requests.empty()) continue;
+            const HostHttpRequest& request = client.requests[0];
+            CHECK_EQUAL(chunked != 0, request.chunked);
+            if (reference.empty()) reference = request.body;
+            CHECK(request.body == reference);
+            if (mtu != 0) {
+                CHECK(client.longest <= mtu);
+                CHECK(client.writes >= client.sent.size() / mtu);
+            }
+        }
+    }
+}
+
+
+// A destination that won't take chunked bodies gets a Content-Length from then
+// on, and the others still get chunked ones
+static void testChunkedRefused(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setChunked(true);
+    CHECK(publisher.addDestination("FEED2", "KEY2"));
+
+    client.queueStatus(411);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(3u, client.requests.size());
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(5u, client.requests.size());
+    if (client.requests.size() != 5) return;
+    CHECK(client.requests[0].chunked);
+    CHECK(!client.requests[1].chunked);
+    checkLength(client.requests[1]);
+    CHECK_EQUAL(std::string("KEY2"), client.requests[2].header("api-key"));
+    CHECK(client.requests[2].chunked);
+    CHECK(!client.requests[3].chunked);
+    CHECK(client.requests[4].chunked);
+
+    // The same goes for a mirror that refuses them
+    IoTPlotterPublisher other(logger, &client, "KEY", "FEED");
+    other.setChunked(true);
+    CHECK(other.addDestination("FEED2", "KEY2"));
+    client.requests.clear();
+    client.queueStatus(201);
+    client.queueStatus(501);
+    CHECK_EQUAL(201, other.publishData(&client));
+    CHECK_EQUAL(201, other.publishData(&client));
+    CHECK_EQUAL(5u, client.requests.size());
+    if (client.requests.size() != 5) return;
+    CHECK(client.requests[0].chunked);
+    CHECK(client.requests[1].chunked);
+    CHECK(!client.requests[2].chunked);
+    CHECK(client.requests[3].chunked);
+    CHECK(!client.requests[4].chunked);
+}
+
+
+// A destination that won't take gzipped bodies gets them as they are from
+// then on, and the others are still compressed
+static void testGzipRefused(void) {
+    Logger logger;
+    setVariables(logger, 40);
+    static IoTPlotterDeflate deflate;
+    MockClient               client;
+    IoTPlotterPublisher      publisher(logger, &client, "KEY", "FEED");
+    publisher.setCompression(&deflate, 100);
+    CHECK(publisher.addDestination("FEED2", "KEY2"));
+
+    client.queueStatus(415);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(5u, client.requests.size());
+    if (client.requests.size() != 5) return;
+    const std::string gzip("gzip");
+    CHECK(client.requests[0].header("content-encoding") == gzip);
+    CHECK(client.requests[1].header("content-encoding").empty());
+    checkLength(client.requests[1]);
+    CHECK(client.requests[1].body == client.requests[0].content());
+    CHECK_EQUAL(std::string("KEY2"), client.requests[2].header("api-key"));
+    CHECK(client.requests[2].header("content-encoding") == gzip);
+    CHECK(client.requests[3].header("content-encoding").empty());
+    CHECK(client.requests[4].header("content-encoding") == gzip);
+}
+
+
+// A request laid out before connecting, in the buffer or spilled to a store,
+// is the request that would have been laid out live
+static void testPrerender(void) {
+    Logger logger;
+    setVariables(logger, 40);
+    MockClient          plain;
+    IoTPlotterPublisher reference(logger, &plain, "KEY", "FEED");
+    CHECK_EQUAL(201, reference.publishData(&plain));
+
+    static char buffer[4096];
+    for (uint16_t size : {4096, 256}) {
+        for (uint16_t mtu : {0, 100}) {
+            MockClient          client;
+            MemoryStore         spill;
+            IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+            publisher.setPrerender(buffer, size, &spill);
+            publisher.setMtu(mtu);
+            CHECK_EQUAL(201, publisher.publishData(&client));
+            CHECK(client.sent == plain.sent);
+            CHECK_EQUAL(size < plain.sent.size(), !spill.bytes.empty());
+        }
+    }
+
+    // Too big for both, so laid out live
+    MockClient          client;
+    MemoryStore         spill;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    spill.failAppends = true;
+    publisher.setPrerender(buffer, 256, &spill);
+    publisher.setChunked(true);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1u, client.requests.size());
+    if (client.requests.empty()) return;
+    CHECK(client.requests[0].chunked);
+    CHECK(client.requests[0].body == plain.requests[0].body);
+}
+
+
+// A slow client takes a buffer-full a poll, gzipped or chunked, and a chunked
+// body times out like any other
+static void testSlowSend(void) {
+    hostUseManualClock(true);
+    Logger logger;
+    setVariables(logger, 40);
+    MockClient          plain;
+    IoTPlotterPublisher reference(logger, &plain, "KEY", "FEED");
+    CHECK_EQUAL(201, reference.publishData(&plain));
+    if (plain.requests.empty()) return;
+    const std::string content = plain.requests[0].body;
+
+    static IoTPlotterDeflate deflate;
+    for (int chunked = 0; chunked < 2; chunked++) {
+        for (uint16_t mtu : {0, 64, 256}) {
+            MockClient          client;
+            IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+            publisher.setChunked(chunked != 0);
+            publisher.setMtu(mtu);
+            publisher.setCompression(&deflate, 100);
+            client.writeMs = 40;
+            // The reply comes in pieces, the last long after the request
+            MockClient::Reply reply;
+            reply.pieces.push_back(MockClient::Piece{300, "HTTP/1.1 201 Cr"});
+            reply.pieces.push_back(MockClient::Piece{2500, "eated\r\n\r\n"});
+            client.queueReply(reply);
+            CHECK_EQUAL(201, publisher.publishData(&client));
+            CHECK_EQUAL(1u, client.requests.size());
+            if (client.requests.empty()) continue;
+            const HostHttpRequest& request = client.requests[0];
+            CHECK_EQUAL(chunked != 0, request.chunked);
+            CHECK_EQUAL(std::string("gzip"),
+                        request.header("content-encoding"));
+            if (!chunked) checkLength(request);
+            CHECK(request.body.size() < content.size());
+            CHECK(request.content() == content);
+        }
+    }
+
+    // Two seconds a write, against five allowed for the whole request
+    for (int chunked = 0; chunked < 2; chunked++) {
+        MockClient          client;
+        IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+        publisher.setChunked(chunked != 0);
+        publisher.setMtu(256);
+        publisher.setPhaseTimeouts(10000, 5000, 10000);
+        client.writeMs = 2000;
+        hostPrintoutLog().clear();
+        CHECK_EQUAL(504, publisher.publishData(&client));
+        CHECK(hostPrintoutLog().find("Timed out sending") !=
+              std::string::npos);
+        CHECK(client.requests.empty());
+        CHECK(client.sent.size() < plain.sent.size());
+        CHECK(client.writes <= 6);
+    }
+
+    // A client that takes only part of a write
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    client.writeLimit = 10;
+    hostPrintoutLog().clear();
+    CHECK_EQUAL(504, publisher.publishData(&client));
+    CHECK(hostPrintoutLog().find("Unable to send") != std::string::npos);
+    hostUseManualClock(false);
+}
+
+
+static void testKeepAlive(void) {
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setKeepAlive(true);
+    for (int i = 0; i < 3; i++) CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1u, client.connects);
+    CHECK_EQUAL(1, publisher.getConnectionsOpened());
+    CHECK_EQUAL(2, publisher.getConnectionsReused());
+    CHECK(client.requests[0].header("connection") == "keep-alive");
+
+    // The modem drops the idle connection; the next post opens another
+    client.dropConnection();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(2u, client.connects);
+    CHECK_EQUAL(4u, client.requests.size());
+}
+
+
+static void testFailures(void) {
+    hostUseManualClock(true);
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+
+    // A reply that never comes times out.  With nowhere to keep the next
+    // sample, it's posted even though the publisher is backing off, rather
+    // than being dropped
+    IoTPlotterRetry& retry = publisher.getRetryScheduler();
+    client.queueReply("", 60000UL * 5);
+    CHECK_EQUAL(504, publisher.publishData(&client));
+    CHECK_EQUAL(1u, client.requests.size());
+    CHECK(!retry.canAttempt(millis()));
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(2u, client.requests.size());
+
+    // With a queue, the sample waits there until the backoff is over
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    publisher.setQueue(&queue);
+    client.queueReply("", 60000UL * 5);
+    CHECK_EQUAL(504, publisher.publishData(&client));
+    CHECK(!retry.canAttempt(millis()));
+    CHECK_EQUAL(0, publisher.publishData(&client));
+    CHECK_EQUAL(0, publisher.getPublishResult());
+    CHECK_EQUAL(3u, client.requests.size());
+    CHECK(!queue.isEmpty());
+
+    // A status split over several reads is still read
+    MockClient::Reply reply;
+    reply.pieces.push_back(MockClient::Piece{0, "HTTP/1.1 2"});
+    reply.pieces.push_back(MockClient::Piece{50, "01 Cre"});
+    reply.pieces.push_back(MockClient::Piece{120, "ated\r\nContent-Length: 0\r\n"
+                                                  "\r\n"});
+    client.queueReply(reply);
+    hostAdvanceMillis(3600000UL);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK(queue.isEmpty());
+    hostUseManualClock(false);
+}
+
+
+// However long the backoff grows, a publish never sits out more than a short
+// one; the rest is left to later publishes
+static void testRefusedConnects(void) {
+    hostUseManualClock(true);
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    IoTPlotterRetry&    retry = publisher.getRetryScheduler();
+    client.refuseConnects     = 1000;
+    uint32_t backoff          = 0;
+    for (int i = 0; i < 10; i++) {
+        uint32_t start = millis();
+        CHECK_EQUAL(504, publisher.publishData(&client));
+        CHECK(millis() - start <= IOTPLOTTER_MAX_RETRY_WAIT);
+        backoff = retry.waitRemaining(millis());
+        hostAdvanceMillis(backoff);
+    }
+    CHECK(backoff > IOTPLOTTER_MAX_RETRY_WAIT);
+    CHECK_EQUAL(0u, client.connects);
+
+    // Once the server is back, so are the posts
+    client.refuseConnects = 0;
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    hostUseManualClock(false);
+}
+
+
+// The circuit breaker is off until it's asked for
+static void testCircuitBreaker(void) {
+    hostUseManualClock(true);
+    Logger logger;
+    setVariables(logger, 3);
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    IoTPlotterRetry&    retry = publisher.getRetryScheduler();
+    retry.setPolicy(IOTPLOTTER_SERVER_ERROR, 1000, 1000, 0);
+
+    // However many failures there are, each is only followed by its backoff
+    for (int i = 0; i < 8; i++) {
+        client.queueStatus(503);
+        CHECK_EQUAL(503, publisher.publishData(&client));
+        CHECK(!retry.isOpen(millis()));
+        hostAdvanceMillis(1000);
+    }
+
+    CHECK_EQUAL(201, publisher.publishData(&client));
+
+    // Turned on, it opens at the threshold and, with a queue to keep the
+    // samples in, holds off for the cooldown
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    publisher.setQueue(&queue);
+    retry.setCircuitBreaker(3, 60000UL);
+    for (int i = 0; i < 3; i++) {
+        client.queueStatus(503);
+        CHECK_EQUAL(503, publisher.publishData(&client));
+        hostAdvanceMillis(1000);
+    }
+    CHECK(retry.isOpen(millis()));
+    size_t sent = client.requests.size();
+    CHECK_EQUAL(0, publisher.publishData(&client));
+    CHECK_EQUAL(sent, client.requests.size());
+    hostAdvanceMillis(60000UL);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK(queue.isEmpty());
+    hostUseManualClock(false);
+}
+
+
+int main() {
+    testSinglePost();
+    testPrintWhilePublishing();
+    testStaticHeader();
+    testLengths();
+    testBatch();
+    testMirrors();
+    testDeadband();
+    testChunkedAndMtu();
+    testChunkedRefused();
+    testGzipRefused();
+    testPrerender();
+    testSlowSend();
+    testKeepAlive();
+    testFailures();
+    testRefusedConnects();
+    testCircuitBreaker();
+    return hostTestResult();
+}
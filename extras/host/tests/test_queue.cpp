@@ -0,0 +1,141 @@
+/**
+ * @file test_queue.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests that queued records are written whole, and that a damaged or
+ * torn record only loses itself, not the rest of the queue.
+ */
+
+#include <string.h>
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterPublisher.h"
+#include "IoTPlotterQueue.h"
+#include "MemoryStore.h"
+#include "MockClient.h"
+
+
+static const float values[3] = {21.5f, 4.12f, 55.0f};
+
+
+// Reads every record from the cursor on, resyncing past damage
+static std::string readAll(IoTPlotterQueue& queue) {
+    std::string epochs;
+    uint32_t    offset = queue.readCursor();
+    while (offset < queue.endOffset()) {
+        uint32_t epoch;
+        float    read[3];
+        uint8_t  varCount;
+        uint32_t next = queue.read(offset, epoch, read, 3, varCount);
+        if (next == 0) {
+            offset = queue.resync(offset);
+            continue;
+        }
+        epochs += std::to_string(epoch) + " ";
+        offset = next;
+    }
+    return epochs;
+}
+
+
+static void testSingleAppend(void) {
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    CHECK(queue.push(100, values, 3));
+    CHECK(queue.push(200, values, 3));
+    CHECK_EQUAL(2u, data.appends);
+    CHECK_EQUAL(2u * (6 + 3 * 4 + 2), data.bytes.size());
+    CHECK_EQUAL(std::string("100 200 "), readAll(queue));
+
+    // A failed append leaves nothing behind
+    data.failAppends = true;
+    CHECK(!queue.push(300, values, 3));
+    CHECK_EQUAL(2u * (6 + 3 * 4 + 2), data.bytes.size());
+}
+
+
+static void testDamage(void) {
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    for (uint32_t epoch = 100; epoch <= 500; epoch += 100) {
+        queue.push(epoch, values, 3);
+    }
+    // A flipped bit in the middle of the second record
+    data.bytes[20 + 8] ^= 0x10;
+    CHECK_EQUAL(std::string("100 300 400 500 "), readAll(queue));
+
+    // A record torn part way through, with more pushed after it
+    data.bytes.resize(data.bytes.size() - 7);
+    queue.push(600, values, 3);
+    CHECK_EQUAL(std::string("100 300 400 600 "), readAll(queue));
+}
+
+
+// Damage that leaves a 0xA5 among a record's values mustn't turn the bytes
+// after it into a record
+static void testFalseMarker(void) {
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    // Values that hold a record of no values from epoch 1, with the XOR of
+    // its bytes after it
+    const uint8_t lookalike[12] = {0xA5, 0, 1, 0, 0, 0, 0xA4, 0, 0, 0, 0, 0};
+    float         inside[3];
+    memcpy(inside, lookalike, sizeof(inside));
+    queue.push(100, inside, 3);
+    queue.push(200, values, 3);
+    CHECK_EQUAL(std::string("100 200 "), readAll(queue));
+
+    // With the real marker gone, the search for the next record passes over
+    // the lookalike
+    data.bytes[0] ^= 0xFF;
+    CHECK_EQUAL(std::string("200 "), readAll(queue));
+}
+
+
+// The publisher drains past a damaged record instead of wiping the queue
+static void testDrainPastDamage(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    logger.addVariable("Batt", 2, 4.12f);
+    logger.addVariable("RH", 2, 55.0f);
+    MemoryStore     data;
+    MemoryStore     cursor;
+    IoTPlotterQueue queue(&data, &cursor);
+    queue.begin();
+    for (uint32_t epoch = 100; epoch <= 300; epoch += 100) {
+        queue.push(epoch, values, 3);
+    }
+    data.bytes[20 + 8] ^= 0x10;
+
+    MockClient          client;
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setQueue(&queue);
+    hostPrintoutLog().clear();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    std::string bodies;
+    for (const HostHttpRequest& request : client.requests) {
+        bodies += request.body;
+    }
+    CHECK(bodies.find("\"epoch\":100}") != std::string::npos);
+    CHECK(bodies.find("\"epoch\":200}") == std::string::npos);
+    CHECK(bodies.find("\"epoch\":300}") != std::string::npos);
+    CHECK(hostPrintoutLog().find("damaged") != std::string::npos);
+    CHECK(queue.isEmpty());
+}
+
+
+int main() {
+    testSingleAppend();
+    testDamage();
+    testFalseMarker();
+    testDrainPastDamage();
+    return hostTestResult();
+}
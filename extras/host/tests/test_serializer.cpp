@@ -0,0 +1,181 @@
+/**
+ * @file test_serializer.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests the snapshot and the JSON and CSV layouts, and that every
+ * body is measured to the exact byte.
+ */
+
+#include <string>
+#include <vector>
+#include "HostTest.h"
+#include "IoTPlotterSerializer.h"
+
+
+// A sink that keeps everything, to compare with the other sinks
+class StringSink {
+ public:
+    size_t write(const char* data, size_t length) {
+        text.append(data, length);
+        return length;
+    }
+    std::string text;
+};
+
+
+static void fill(IoTPlotterSnapshot& snapshot, uint8_t vars, uint8_t samples) {
+    snapshot.clear();
+    for (uint8_t i = 0; i < vars; i++) {
+        std::string code = "Var" + std::to_string(i);
+        CHECK(snapshot.addVarCode(code.c_str(), code.size()));
+    }
+    for (uint8_t s = 0; s < samples; s++) {
+        CHECK(snapshot.addEpoch(1650000000UL + 60UL * s));
+        for (uint8_t i = 0; i < vars; i++) {
+            std::string value = std::to_string(i * 10 + s) + ".5";
+            CHECK(snapshot.addValue(value.c_str(), value.size()));
+        }
+    }
+}
+
+
+static void testLayouts(void) {
+    IoTPlotterSnapshotBuffer<256> snapshot;
+    fill(snapshot, 2, 2);
+    CHECK_EQUAL(2, snapshot.varCount());
+    CHECK_EQUAL(2, snapshot.sampleCount());
+
+    StringSink json;
+    IoTPlotterSerializer::writeJson(json, snapshot);
+    CHECK_EQUAL(std::string("{\"data\":{\"Var0\":[{\"value\":0.5, "
+                            "\"epoch\":1650000000},{\"value\":1.5, "
+                            "\"epoch\":1650000060}],\"Var1\":[{\"value\":10.5, "
+                            "\"epoch\":1650000000},{\"value\":11.5, "
+                            "\"epoch\":1650000060}]}}"),
+                json.text);
+
+    StringSink csv;
+    IoTPlotterSerializer::writeCsv(csv, snapshot);
+    CHECK_EQUAL(std::string("epoch,Var0,Var1\n1650000000,0.5,10.5\n"
+                            "1650000060,1.5,11.5\n"),
+                csv.text);
+
+    // A variable left out of the snapshot, and one left out by a mask
+    snapshot.omitVar(0);
+    StringSink masked;
+    uint8_t    mask[1] = {0x01};
+    IoTPlotterSerializer::writeJson(masked, snapshot, mask);
+    CHECK_EQUAL(std::string("{\"data\":{}}"), masked.text);
+    StringSink rest;
+    IoTPlotterSerializer::writeJson(rest, snapshot);
+    CHECK_EQUAL(std::string("{\"data\":{\"Var1\":[{\"value\":10.5, "
+                            "\"epoch\":1650000000},{\"value\":11.5, "
+                            "\"epoch\":1650000060}]}}"),
+                rest.text);
+
+    fill(snapshot, 0, 1);
+    StringSink empty;
+    IoTPlotterSerializer::writeJson(empty, snapshot);
+    CHECK_EQUAL(std::string("{\"data\":{}}"), empty.text);
+}
+
+
+// The counting sink, the buffer sink and the windows must all agree, since
+// the Content-Length comes from one and the body from the others
+static void testExactSizes(void) {
+    static IoTPlotterSnapshotBuffer<60000> snapshot;
+    const uint8_t varCounts[] = {0, 1, 2, 7, 20, 64, 200};
+    const uint8_t batches[]   = {1, 2, 5, 10};
+    for (uint8_t vars : varCounts) {
+        for (uint8_t samples : batches) {
+            fill(snapshot, vars, samples);
+            if (vars > 3) snapshot.omitVar(3);
+            uint8_t mask[32];
+            memset(mask, 0x5A, sizeof(mask));
+            for (int layout = 0; layout < 4; layout++) {
+                const uint8_t* varMask = layout >= 2 ? mask : nullptr;
+                bool           csv     = layout % 2 != 0;
+                IoTPlotterCountingSink counter;
+                StringSink             whole;
+                if (csv) {
+                    IoTPlotterSerializer::writeCsv(counter, snapshot, varMask);
+                    IoTPlotterSerializer::writeCsv(whole, snapshot, varMask);
+                } else {
+                    IoTPlotterSerializer::writeJson(counter, snapshot, varMask);
+                    IoTPlotterSerializer::writeJson(whole, snapshot, varMask);
+                }
+                CHECK_EQUAL(whole.text.size(), counter.count());
+
+                // The same bytes, handed out a window at a time
+                std::string pieces;
+                for (uint32_t start = 0; start < whole.text.size();
+                     start += 97) {
+                    StringSink                       piece;
+                    IoTPlotterWindowSink<StringSink> window(piece, start, 97);
+                    if (csv) {
+                        IoTPlotterSerializer::writeCsv(window, snapshot,
+                                                       varMask);
+                    } else {
+                        IoTPlotterSerializer::writeJson(window, snapshot,
+                                                        varMask);
+                    }
+                    CHECK_EQUAL(piece.text.size(), window.passed());
+                    pieces += piece.text;
+                }
+                CHECK(pieces == whole.text);
+
+                std::vector<char>    buffer(whole.text.size() + 1);
+                IoTPlotterBufferSink copy(buffer.data(), buffer.size());
+                if (csv) {
+                    IoTPlotterSerializer::writeCsv(copy, snapshot, varMask);
+                } else {
+                    IoTPlotterSerializer::writeJson(copy, snapshot, varMask);
+                }
+                CHECK(!copy.overflowed());
+                CHECK(std::string(buffer.data(), copy.length()) == whole.text);
+            }
+        }
+    }
+}
+
+
+static void testArenaLimits(void) {
+    static IoTPlotterSnapshotBuffer<IOTPLOTTER_SNAPSHOT_SIZE> snapshot;
+    snapshot.clear();
+    // Text plus two bytes of index per item
+    std::string code(IOTPLOTTER_SNAPSHOT_SIZE / 2 - 12, 'x');
+    CHECK(snapshot.addVarCode(code.c_str(), code.size()));
+    CHECK(snapshot.addVarCode(code.c_str(), code.size()));
+    CHECK(!snapshot.addVarCode(code.c_str(), code.size()));
+    CHECK_EQUAL(2, snapshot.varCount());
+    CHECK(snapshot.addEpoch(7));
+    CHECK(!snapshot.addValue("1234567890123456", 16));
+    snapshot.discardPartialSample();
+    CHECK_EQUAL(0, snapshot.sampleCount());
+
+    // Keeping the first code drops the second and the partial sample
+    snapshot.keepVarCodes(1);
+    CHECK_EQUAL(1, snapshot.varCount());
+    CHECK(snapshot.addEpoch(7));
+    CHECK(snapshot.addValue("1234", 4));
+    CHECK_EQUAL(1, snapshot.sampleCount());
+    uint16_t length;
+    CHECK(memcmp(snapshot.varCode(0, length), code.c_str(), code.size()) == 0);
+    CHECK_EQUAL(code.size(), length);
+
+    // The codes stay through clearSamples()
+    snapshot.clearSamples();
+    CHECK_EQUAL(1, snapshot.codeCount());
+    CHECK_EQUAL(0, snapshot.sampleCount());
+    CHECK(memcmp(snapshot.varCode(0, length), code.c_str(), code.size()) == 0);
+}
+
+
+int main() {
+    testLayouts();
+    testExactSizes();
+    testArenaLimits();
+    return hostTestResult();
+}
@@ -0,0 +1,196 @@
+/**
+ * @file test_tls.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Tests posting over TLS with the BearSSL adapter, against a client
+ * that plays the part of a server resuming sessions by ID.
+ */
+
+#include <set>
+#include <string>
+#include "HostTest.h"
+#include "IoTPlotterBearSsl.h"
+#include "IoTPlotterPublisher.h"
+#include "MockClient.h"
+
+
+// The parts of BearSSL's br_ssl_session_parameters the adapter reads
+struct FakeSessionParameters {
+    unsigned char session_id[32];
+    unsigned char session_id_len;
+};
+
+
+// The same shape as the ESP8266's BearSSL::Session
+class FakeSession {
+ public:
+    FakeSession() {
+        memset(&_parameters, 0, sizeof(_parameters));
+    }
+    FakeSessionParameters* getSession(void) {
+        return &_parameters;
+    }
+
+ private:
+    FakeSessionParameters _parameters;
+};
+
+
+// A client whose server resumes any session it has handed out and not yet
+// forgotten, and otherwise makes a full handshake with a new session ID
+class FakeBearSslClient : public MockClient {
+ public:
+    void setSession(FakeSession* session) {
+        _session = session;
+    }
+    int connect(const char* host, uint16_t port) override {
+        if (!MockClient::connect(host, port)) return 0;
+        if (_session == nullptr) return 1;
+        FakeSessionParameters* parameters = _session->getSession();
+        std::string offered(reinterpret_cast<char*>(parameters->session_id),
+                            parameters->session_id_len);
+        if (parameters->session_id_len > 0 && _known.count(offered) > 0) {
+            resumed++;
+            return 1;
+        }
+        full++;
+        std::string id = "session-" + std::to_string(full);
+        _known.insert(id);
+        memcpy(parameters->session_id, id.data(), id.size());
+        parameters->session_id_len = static_cast<unsigned char>(id.size());
+        return 1;
+    }
+    /** @brief The server forgets every session it handed out */
+    void forget(void) {
+        _known.clear();
+    }
+
+    uint32_t full    = 0;  ///< Full handshakes the server made
+    uint32_t resumed = 0;  ///< Handshakes the server resumed
+
+ private:
+    FakeSession*          _session = nullptr;
+    std::set<std::string> _known;
+};
+
+
+static void testResumption(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    FakeBearSslClient client;
+    IoTPlotterBearSslAdapter<FakeBearSslClient, FakeSession> tls(client);
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setTls(&tls);
+
+    // The first connection makes a full handshake
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(443, client.lastPort);
+    CHECK_EQUAL(std::string("https://iotplotter.com/api/v2/feed/FEED"),
+                client.requests[0].target);
+    CHECK_EQUAL(1, publisher.getLastMetrics().handshakes);
+    CHECK_EQUAL(0, publisher.getLastMetrics().resumptions);
+
+    // The next ones resume its session, and are counted as resumed
+    for (int i = 0; i < 3; i++) {
+        CHECK_EQUAL(201, publisher.publishData(&client));
+        CHECK_EQUAL(0, publisher.getLastMetrics().handshakes);
+        CHECK_EQUAL(1, publisher.getLastMetrics().resumptions);
+    }
+    CHECK_EQUAL(1u, client.full);
+    CHECK_EQUAL(3u, client.resumed);
+    CHECK_EQUAL(1, publisher.getTotalMetrics().handshakes);
+    CHECK_EQUAL(3, publisher.getTotalMetrics().resumptions);
+
+    // A server that has forgotten the session makes a full handshake, whose
+    // new session is resumed after that
+    client.forget();
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1, publisher.getLastMetrics().handshakes);
+    CHECK_EQUAL(0, publisher.getLastMetrics().resumptions);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1, publisher.getLastMetrics().resumptions);
+
+    // A failed connection drops the session it offered, so the post's retry
+    // makes a full handshake
+    client.refuseConnects = 1;
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1, publisher.getLastMetrics().handshakes);
+    CHECK_EQUAL(0, publisher.getLastMetrics().resumptions);
+    CHECK_EQUAL(3u, client.full);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(1, publisher.getLastMetrics().resumptions);
+}
+
+
+// Each server keeps its own session
+static void testTwoServers(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    FakeBearSslClient client;
+    IoTPlotterBearSslAdapter<FakeBearSslClient, FakeSession> tls(client);
+    tls.beginConnect("one.example", 443);
+    client.connect("one.example", 443);
+    CHECK(!tls.endConnect(true));
+    tls.beginConnect("two.example", 443);
+    client.connect("two.example", 443);
+    CHECK(!tls.endConnect(true));
+    tls.beginConnect("one.example", 443);
+    client.connect("one.example", 443);
+    CHECK(tls.endConnect(true));
+    tls.beginConnect("two.example", 443);
+    client.connect("two.example", 443);
+    CHECK(tls.endConnect(true));
+    CHECK_EQUAL(2u, client.full);
+    CHECK_EQUAL(2u, client.resumed);
+}
+
+
+// An adapter for a client that can count the bytes of a handshake
+class CountingAdapter
+    : public IoTPlotterBearSslAdapter<FakeBearSslClient, FakeSession> {
+ public:
+    explicit CountingAdapter(FakeBearSslClient& client)
+        : IoTPlotterBearSslAdapter(client) {}
+    uint32_t handshakeBytes(void) override {
+        return 4321;
+    }
+};
+
+
+// Handshake bytes only go out with the metrics when the client counted them
+static void testHandshakeBytes(void) {
+    Logger logger;
+    logger.addVariable("Temp", 2, 21.5f);
+    FakeBearSslClient client;
+    IoTPlotterBearSslAdapter<FakeBearSslClient, FakeSession> tls(client);
+    IoTPlotterPublisher publisher(logger, &client, "KEY", "FEED");
+    publisher.setTls(&tls);
+    CHECK_EQUAL(201, publisher.publishData(&client));
+    CHECK_EQUAL(201, publisher.publishMetrics(&client, "METRICS"));
+    std::string body = client.requests.back().body;
+    CHECK(body.find("\"tls_full\"") != std::string::npos);
+    CHECK(body.find("tls_full_bytes") == std::string::npos);
+    CHECK(body.find("tls_resumed_bytes") == std::string::npos);
+
+    FakeBearSslClient   counted;
+    CountingAdapter     counting(counted);
+    IoTPlotterPublisher other(logger, &counted, "KEY", "FEED");
+    other.setTls(&counting);
+    CHECK_EQUAL(201, other.publishData(&counted));
+    CHECK_EQUAL(4321u, other.getTotalMetrics().handshakeBytes);
+    CHECK_EQUAL(201, other.publishMetrics(&counted, "METRICS"));
+    body = counted.requests.back().body;
+    CHECK(body.find("\"tls_full_bytes\"") != std::string::npos);
+    CHECK(body.find("\"tls_resumed_bytes\"") != std::string::npos);
+    CHECK(body.find("4321") != std::string::npos);
+}
+
+
+int main() {
+    testResumption();
+    testTwoServers();
+    testHandshakeBytes();
+    return hostTestResult();
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Reports the RAM, stack and code size of each configuration of the library
+# built by the host build: the per-publisher RAM and peak stack from the
+# size_report programs, and the static RAM (data + bss) and code (text) of
+# each build of the library from size(1).
+#
+# Usage: extras/host/tools/size_report.sh [build directory]
+# The build directory defaults to "build", configured and built as in the
+# README.
+
+build=${1:-build}
+host="$build/extras/host"
+if [ ! -d "$host" ]; then
+    echo "No host build in $build; build it first" >&2
+    exit 1
+fi
+
+for config in iotplotter iotplotter_avr iotplotter_lowmem iotplotter_large; do
+    case $config in
+        iotplotter) program=size_report ;;
+        *) program=size_report_${config#iotplotter_} ;;
+    esac
+    echo "== $config"
+    if [ -x "$host/$program" ]; then
+        "$host/$program"
+    fi
+    if [ -f "$host/lib$config.a" ]; then
+        size -t "$host/lib$config.a" | tail -n 1 |
+            awk '{ printf "Library code %d B, static RAM %d B\n", $1, $2 + $3 }'
+    fi
+    echo
+done
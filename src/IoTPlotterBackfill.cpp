@@ -0,0 +1,228 @@
+/**
+ * @file IoTPlotterBackfill.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterBackfill class.
+ */
+
+#include "IoTPlotterBackfill.h"
+#include <stdlib.h>
+
+// Marks a column that holds no variable
+#define IOTPLOTTER_NO_VARIABLE 0xFF
+
+
+// Reads a run of decimal digits; -1 if any of them isn't one
+static int32_t readDigits(const char* text, uint8_t count) {
+    int32_t number = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (text[i] < '0' || text[i] > '9') return -1;
+        number = number * 10 + (text[i] - '0');
+    }
+    return number;
+}
+
+
+IoTPlotterBackfill::IoTPlotterBackfill(IoTPlotterStore* dataFile,
+                                       IoTPlotterStore* cursorStore,
+                                       char* buffer, uint16_t bufferSize)
+    : _dataFile(dataFile),
+      _cursorStore(cursorStore),
+      _buffer(buffer),
+      _bufferSize(bufferSize) {
+    for (uint8_t c = 0; c < IOTPLOTTER_BACKFILL_MAX_COLUMNS; c++) {
+        _columnVar[c] = c > 0 ? c - 1 : IOTPLOTTER_NO_VARIABLE;
+    }
+}
+
+
+void IoTPlotterBackfill::begin(void) {
+    // The same checkpoint as the IoTPlotterQueue's: the cursor followed by
+    // its bitwise inverse
+    uint8_t  saved[8];
+    uint32_t cursor   = 0;
+    uint32_t inverted = 0;
+    if (_cursorStore->read(0, saved, sizeof(saved)) == sizeof(saved)) {
+        for (uint8_t i = 0; i < 4; i++) {
+            cursor |= static_cast<uint32_t>(saved[i]) << (8 * i);
+            inverted |= static_cast<uint32_t>(saved[i + 4]) << (8 * i);
+        }
+    }
+    // A cursor past the end means the file has been replaced; start over
+    if (cursor != ~inverted || cursor > _dataFile->size()) cursor = 0;
+    _cursor       = cursor;
+    _windowLength = 0;
+}
+
+
+void IoTPlotterBackfill::mapColumns(const uint32_t* codeHashes,
+                                    uint8_t         varCount) {
+    // By default the columns follow the date in the logger's variable order
+    for (uint8_t c = 0; c < IOTPLOTTER_BACKFILL_MAX_COLUMNS; c++) {
+        _columnVar[c] = c > 0 && c - 1 < varCount ? c - 1
+                                                  : IOTPLOTTER_NO_VARIABLE;
+    }
+
+    uint8_t  rowVar[IOTPLOTTER_BACKFILL_MAX_COLUMNS];
+    uint8_t  bestMatches = 0;
+    uint8_t  matches     = 0;
+    uint8_t  column      = 0;
+    uint8_t  fieldLength = 0;
+    uint32_t offset      = 0;
+    while (offset < IOTPLOTTER_BACKFILL_HEADER_SCAN) {
+        int c = nextByte(offset++);
+        if (c < 0) break;
+        if (c == '\r' || c == '"' || (c == ' ' && fieldLength == 0)) continue;
+        if (c != ',' && c != '\n') {
+            if (fieldLength < sizeof(_field) - 1) _field[fieldLength++] = c;
+            continue;
+        }
+
+        _field[fieldLength] = '\0';
+        uint32_t epoch;
+        // The header ends at the first row of data
+        if (column == 0 && parseDateTime(_field, epoch)) break;
+        if (column < IOTPLOTTER_BACKFILL_MAX_COLUMNS) {
+            uint32_t hash  = hashText(_field, fieldLength);
+            rowVar[column] = IOTPLOTTER_NO_VARIABLE;
+            for (uint8_t i = 0; column > 0 && i < varCount; i++) {
+                if (codeHashes[i] == hash) {
+                    rowVar[column] = i;
+                    matches++;
+                    break;
+                }
+            }
+        }
+        column++;
+        fieldLength = 0;
+        if (c == '\n') {
+            if (matches > bestMatches) {
+                bestMatches = matches;
+                for (uint8_t i = 0; i < IOTPLOTTER_BACKFILL_MAX_COLUMNS; i++) {
+                    _columnVar[i] = i < column ? rowVar[i]
+                                               : IOTPLOTTER_NO_VARIABLE;
+                }
+            }
+            matches = 0;
+            column  = 0;
+        }
+    }
+}
+
+
+uint32_t IoTPlotterBackfill::read(uint32_t offset, uint32_t& epoch,
+                                  float* values, uint8_t maxVars) {
+    uint8_t column      = 0;
+    uint8_t fieldLength = 0;
+    bool    dated       = false;
+    // Anything not in the row is missing, as the logger itself marks it
+    for (uint8_t i = 0; i < maxVars; i++) values[i] = -9999;
+
+    while (true) {
+        int c = nextByte(offset++);
+        // A row without its line ending may still be being written
+        if (c < 0) return 0;
+        if (c == '\r' || c == '"' || (c == ' ' && fieldLength == 0)) continue;
+        if (c != ',' && c != '\n') {
+            // Nothing in a header row is needed, so skip through it quickly
+            if (column > 0 && !dated) continue;
+            if (fieldLength < sizeof(_field) - 1) _field[fieldLength++] = c;
+            continue;
+        }
+
+        _field[fieldLength] = '\0';
+        if (column == 0) {
+            dated = parseDateTime(_field, epoch);
+        } else if (dated && fieldLength > 0 &&
+                   column < IOTPLOTTER_BACKFILL_MAX_COLUMNS) {
+            uint8_t var = _columnVar[column];
+            if (var < maxVars) {
+                char* end;
+                float value = strtod(_field, &end);
+                if (end != _field) values[var] = value;
+            }
+        }
+        column++;
+        fieldLength = 0;
+        if (c == '\n') {
+            if (dated) return offset;
+            column = 0;
+        }
+    }
+}
+
+
+bool IoTPlotterBackfill::commit(uint32_t offset) {
+    // Unlike the queue, the file is the logger's own record and is never
+    // emptied
+    uint8_t  saved[8];
+    uint32_t inverted = ~offset;
+    for (uint8_t i = 0; i < 4; i++) {
+        saved[i]     = offset >> (8 * i);
+        saved[i + 4] = inverted >> (8 * i);
+    }
+    _cursor = offset;
+    return _cursorStore->clear() &&
+        _cursorStore->append(saved, sizeof(saved)) == sizeof(saved);
+}
+
+
+// FNV-1a
+uint32_t IoTPlotterBackfill::hashText(const char* text, size_t length) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(text[i]);
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+
+bool IoTPlotterBackfill::parseDateTime(const char* text, uint32_t& epoch) {
+    for (uint8_t i = 0; i < 19; i++) {
+        if (text[i] == '\0') return false;
+    }
+    int32_t year   = readDigits(text, 4);
+    int32_t month  = readDigits(text + 5, 2);
+    int32_t day    = readDigits(text + 8, 2);
+    int32_t hour   = readDigits(text + 11, 2);
+    int32_t minute = readDigits(text + 14, 2);
+    int32_t second = readDigits(text + 17, 2);
+    if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 ||
+        second > 60 || text[4] != '-' || text[7] != '-' ||
+        (text[10] != 'T' && text[10] != ' ') || text[13] != ':' ||
+        text[16] != ':') {
+        return false;
+    }
+
+    // Days since 1970-01-01 of the proleptic Gregorian date, counting years
+    // from March so the leap day falls at the end
+    if (month <= 2) year--;
+    int32_t era       = year / 400;
+    int32_t yearOfEra = year - era * 400;
+    int32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+        day - 1;
+    int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+        dayOfYear;
+    int32_t days = era * 146097L + dayOfEra - 719468L;
+
+    epoch = static_cast<uint32_t>(days) * 86400UL +
+        static_cast<uint32_t>(hour) * 3600UL +
+        static_cast<uint32_t>(minute) * 60UL + static_cast<uint32_t>(second);
+    return true;
+}
+
+
+// Gets a byte of the file through the read window; -1 past the end
+int IoTPlotterBackfill::nextByte(uint32_t offset) {
+    if (offset < _windowStart || offset - _windowStart >= _windowLength) {
+        _windowStart  = offset;
+        _windowLength = _dataFile->read(
+            offset, reinterpret_cast<uint8_t*>(_buffer), _bufferSize);
+        if (_windowLength == 0) return -1;
+    }
+    return static_cast<uint8_t>(_buffer[offset - _windowStart]);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file IoTPlotterBackfill.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterBackfill class, a streaming reader of the
+ * logger's CSV data file for uploading the samples it holds.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERBACKFILL_H_
+#define SRC_PUBLISHERS_IOTPLOTTERBACKFILL_H_
+
+// Included Dependencies
+#include "IoTPlotterStore.h"
+
+/**
+ * @brief The most columns of the data file that can be mapped to variables.
+ *
+ * The first column is always the date and time.  Columns past this are
+ * ignored.
+ */
+#ifndef IOTPLOTTER_BACKFILL_MAX_COLUMNS
+#define IOTPLOTTER_BACKFILL_MAX_COLUMNS 32
+#endif
+/**
+ * @brief The most bytes at the top of the data file searched for the header
+ * row of var codes.
+ */
+#ifndef IOTPLOTTER_BACKFILL_HEADER_SCAN
+#define IOTPLOTTER_BACKFILL_HEADER_SCAN 4096L
+#endif
+
+
+/**
+ * @brief A reader that walks the logger's CSV data file one row at a time,
+ * with a separately checkpointed read cursor.
+ *
+ * Only a fixed window of the file is ever held in RAM, in a buffer provided
+ * by the caller, however large the file is.  The file itself is never
+ * changed.
+ *
+ * A data row starts with the sample's date and time in ISO 8601 form
+ * (`2022-06-01T12:00:00-05:00`, or with a space in place of the `T`), which
+ * is read as local time to give the same local epoch the logger publishes
+ * with; any UTC offset is ignored.  Every other row - the logger's file
+ * header - is skipped.  Each of the following columns is mapped to a
+ * variable: by matching the header row that holds the var codes when there
+ * is one (see mapColumns()), otherwise by position.  Empty cells read as
+ * -9999, the logger's own mark for a missing value.
+ *
+ * Like the IoTPlotterQueue, the offset of the first row not yet accepted by
+ * the portal is checkpointed to its own store, so an upload picks up where
+ * it left off after a reset.  A last row without its line ending (one that
+ * was being written when the card was read) is left for next time.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterBackfill {
+ public:
+    /**
+     * @brief Construct a new backfill reader
+     *
+     * @param dataFile The store holding the logger's data file
+     * @param cursorStore The store holding the read cursor checkpoint
+     * @param buffer The buffer the file is read through; a few hundred bytes
+     * is plenty
+     * @param bufferSize The size of the buffer
+     */
+    IoTPlotterBackfill(IoTPlotterStore* dataFile, IoTPlotterStore* cursorStore,
+                       char* buffer, uint16_t bufferSize);
+
+    /**
+     * @brief Load the checkpointed read cursor
+     *
+     * This must be called before reading, after the storage medium is
+     * available.
+     */
+    void begin(void);
+
+    /**
+     * @brief Work out which column holds which variable.
+     *
+     * The header rows at the top of the file are searched for the one that
+     * names the most var codes, and each column is mapped to the variable
+     * whose var code it holds.  If no header row names any, the columns
+     * after the date are taken to be the variables in order, as the logger
+     * writes them.
+     *
+     * @param codeHashes The hashText() of each variable's var code
+     * @param varCount The number of variables
+     */
+    void mapColumns(const uint32_t* codeHashes, uint8_t varCount);
+
+    /**
+     * @brief Read the next data row at or after an offset
+     *
+     * @param offset The offset to start looking from
+     * @param epoch Set to the row's local epoch time
+     * @param values Filled with the row's values; -9999 for variables with
+     * no column or an empty cell
+     * @param maxVars The number of values there is room for
+     * @return **uint32_t** The offset just past the row, or 0 if there is no
+     * complete data row after the offset
+     */
+    uint32_t read(uint32_t offset, uint32_t& epoch, float* values,
+                  uint8_t maxVars);
+
+    /**
+     * @brief Get the offset of the first row not yet sent
+     *
+     * @return **uint32_t** The read cursor
+     */
+    uint32_t readCursor(void) {
+        return _cursor;
+    }
+    /**
+     * @brief Check whether every row of the file has been sent
+     *
+     * @return **bool** True if the cursor is at the end of the file
+     */
+    bool isDone(void) {
+        return _cursor >= _dataFile->size();
+    }
+    /**
+     * @brief Checkpoint the read cursor after rows have been sent
+     *
+     * @param offset The offset of the first row that has not been sent
+     * @return **bool** True if the checkpoint was saved
+     */
+    bool commit(uint32_t offset);
+
+    /**
+     * @brief Hash a var code or cell, for mapColumns()
+     *
+     * @param text The text
+     * @param length The length of the text
+     * @return **uint32_t** The 32 bit FNV-1a hash of the text
+     */
+    static uint32_t hashText(const char* text, size_t length);
+    /**
+     * @brief Read an ISO 8601 date and time as a local epoch time
+     *
+     * @param text The text, starting `YYYY-MM-DD?hh:mm:ss`
+     * @param epoch Set to the seconds since 1970 the date and time are,
+     * taken as if they were UTC
+     * @return **bool** True if the text is a date and time
+     */
+    static bool parseDateTime(const char* text, uint32_t& epoch);
+
+ private:
+    int nextByte(uint32_t offset);
+
+    IoTPlotterStore* _dataFile;
+    IoTPlotterStore* _cursorStore;
+    char*            _buffer;
+    uint16_t         _bufferSize;
+    uint32_t         _windowStart  = 0;  ///< File offset of _buffer[0]
+    uint16_t         _windowLength = 0;  ///< Bytes of the file in _buffer
+    uint32_t         _cursor       = 0;
+    char             _field[32];  ///< The cell being read
+    /** @brief The variable in each column, 0xFF for none */
+    uint8_t _columnVar[IOTPLOTTER_BACKFILL_MAX_COLUMNS];
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERBACKFILL_H_
@@ -0,0 +1,92 @@
+/**
+ * @file IoTPlotterBearSsl.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterBearSslAdapter, the IoTPlotterTlsAdapter for
+ * BearSSL clients that take a session object, like the ESP8266 core's
+ * BearSSL::WiFiClientSecure.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERBEARSSL_H_
+#define SRC_PUBLISHERS_IOTPLOTTERBEARSSL_H_
+
+// Included Dependencies
+#include "IoTPlotterTls.h"
+#include <string.h>
+
+
+/**
+ * @brief Resumes TLS sessions for a BearSSL client.
+ *
+ * The client must have a `setSession(Session*)`.  The session it is given is
+ * offered to the server on the next connect(), and filled in with the new
+ * session once the handshake is done.  The session's `getSession()` must
+ * return BearSSL's `br_ssl_session_parameters`, or anything with the same
+ * `session_id` and `session_id_len`.  The ESP8266 core's
+ * `BearSSL::WiFiClientSecure` and `BearSSL::Session` are just that:
+ *
+ * @code{.cpp}
+ * BearSSL::WiFiClientSecure client;
+ * IoTPlotterBearSslAdapter<BearSSL::WiFiClientSecure, BearSSL::Session> tls(
+ *     client);
+ * IoTPlotterPublisher publisher(dataLogger, &client, apiKey, feedID);
+ * publisher.setTls(&tls);
+ * @endcode
+ *
+ * A session is kept for each of #IOTPLOTTER_TLS_SESSIONS servers.  BearSSL
+ * resumes by session ID, and a server that resumes a session keeps its ID
+ * while a full handshake is given a new one, so the handshake resumed if the
+ * ID after it is the one offered.  The client can't say how many bytes a
+ * handshake took, so those aren't counted.
+ *
+ * @tparam SecureClient The type of the TLS client
+ * @tparam Session The type of the client's session object
+ *
+ * @ingroup the_publishers
+ */
+template <typename SecureClient, typename Session>
+class IoTPlotterBearSslAdapter : public IoTPlotterTlsAdapter {
+ public:
+    /**
+     * @brief Construct a new adapter for a client
+     *
+     * @param client The TLS client, which is also the client given to the
+     * publisher
+     */
+    explicit IoTPlotterBearSslAdapter(SecureClient& client)
+        : _client(client) {}
+
+ protected:
+    void offerSession(uint8_t slot) override {
+        auto* saved   = _sessions[slot].getSession();
+        _offeredLength = saved->session_id_len;
+        if (_offeredLength > sizeof(_offeredId)) {
+            _offeredLength = sizeof(_offeredId);
+        }
+        memcpy(_offeredId, saved->session_id, _offeredLength);
+        _client.setSession(&_sessions[slot]);
+    }
+    void offerNoSession(void) override {
+        // A blank session gets a full handshake, and is filled in by it
+        _sessions[connectingSlot()] = Session();
+        _offeredLength              = 0;
+        _client.setSession(&_sessions[connectingSlot()]);
+    }
+    bool keepSession(uint8_t slot) override {
+        // The client has already saved the new session where it was told to
+        auto* kept = _sessions[slot].getSession();
+        return _offeredLength > 0 && kept->session_id_len == _offeredLength &&
+            memcmp(kept->session_id, _offeredId, _offeredLength) == 0;
+    }
+
+ private:
+    SecureClient& _client;
+    Session       _sessions[IOTPLOTTER_TLS_SESSIONS];
+    uint8_t       _offeredId[32];  ///< The ID of the session offered
+    uint8_t       _offeredLength = 0;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERBEARSSL_H_
@@ -0,0 +1,194 @@
+/**
+ * @file IoTPlotterDeflate.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterDeflate class.
+ *
+ * The format is RFC 1951 (deflate) inside RFC 1952 (gzip).
+ */
+
+#include "IoTPlotterDeflate.h"
+
+// The furthest back a repeat may be, leaving room for the lookahead
+#define IOTPLOTTER_DEFLATE_MAX_DISTANCE \
+    (IOTPLOTTER_DEFLATE_WINDOW - IOTPLOTTER_DEFLATE_MAX_MATCH)
+// The shortest repeat deflate can code
+#define IOTPLOTTER_DEFLATE_MIN_MATCH 3
+
+
+// The position of the highest bit set, for a number that isn't 0
+static uint8_t highestBit(uint16_t number) {
+    uint8_t bit = 0;
+    while (number >>= 1) bit++;
+    return bit;
+}
+
+
+void IoTPlotterDeflate::begin(Output output, void* context) {
+    _output    = output;
+    _context   = context;
+    _received  = 0;
+    _encoded   = 0;
+    _crc       = 0xFFFFFFFFUL;
+    _bits      = 0;
+    _bitCount  = 0;
+    _outLength = 0;
+    memset(_head, 0, sizeof(_head));
+
+    // No name, time or flags; "unknown" operating system
+    static const uint8_t header[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+    for (uint8_t i = 0; i < sizeof(header); i++) writeByte(header[i]);
+    // The whole body is one final block with the fixed codes
+    writeBits(1, 1);
+    writeBits(1, 2);
+}
+
+
+void IoTPlotterDeflate::write(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) put(static_cast<uint8_t>(data[i]));
+}
+
+
+void IoTPlotterDeflate::finish(void) {
+    while (_encoded < _received) step();
+    // End of block, then pad out to a whole byte
+    writeCode(0, 7);
+    if (_bitCount > 0) writeBits(0, 8 - _bitCount);
+
+    uint32_t crc = ~_crc;
+    for (uint8_t i = 0; i < 4; i++) writeByte(crc >> (8 * i));
+    for (uint8_t i = 0; i < 4; i++) writeByte(_received >> (8 * i));
+    flushOutput();
+}
+
+
+void IoTPlotterDeflate::put(uint8_t byte) {
+    // Compress until there's room for the byte without losing the history a
+    // repeat may reach back to
+    while (_received - _encoded >= IOTPLOTTER_DEFLATE_MAX_MATCH) step();
+    _window[_received & (IOTPLOTTER_DEFLATE_WINDOW - 1)] = byte;
+    _received++;
+
+    _crc ^= byte;
+    for (uint8_t i = 0; i < 8; i++) {
+        _crc = (_crc >> 1) ^ (0xEDB88320UL & (0 - (_crc & 1)));
+    }
+}
+
+
+// Codes the next literal or repeat, greedily taking the last place the next
+// three bytes were seen
+void IoTPlotterDeflate::step(void) {
+    uint32_t ahead  = _received - _encoded;
+    uint16_t length = 0;
+    uint16_t distance = 0;
+    if (ahead >= IOTPLOTTER_DEFLATE_MIN_MATCH) {
+        uint16_t hash = hashAt(_encoded);
+        // Only the low bits of the position are kept, which is plenty to
+        // find anything still in the window
+        distance = static_cast<uint16_t>(_encoded) - _head[hash];
+        _head[hash] = static_cast<uint16_t>(_encoded);
+        if (distance > 0 && distance <= IOTPLOTTER_DEFLATE_MAX_DISTANCE &&
+            distance <= _encoded) {
+            uint16_t most = ahead < IOTPLOTTER_DEFLATE_MAX_MATCH
+                ? ahead
+                : IOTPLOTTER_DEFLATE_MAX_MATCH;
+            // A stale entry or a collision just won't match
+            while (length < most &&
+                   at(_encoded - distance + length) == at(_encoded + length)) {
+                length++;
+            }
+        }
+    }
+
+    if (length < IOTPLOTTER_DEFLATE_MIN_MATCH) {
+        literal(at(_encoded));
+        _encoded++;
+        return;
+    }
+    match(length, distance);
+    // Note where the bytes inside the repeat were seen, too
+    for (uint16_t i = 1; i < length; i++) {
+        uint32_t position = _encoded + i;
+        if (position + 2 >= _received) break;
+        _head[hashAt(position)] = static_cast<uint16_t>(position);
+    }
+    _encoded += length;
+}
+
+
+void IoTPlotterDeflate::literal(uint8_t byte) {
+    if (byte < 144) {
+        writeCode(0x30 + byte, 8);
+    } else {
+        writeCode(0x190 + (byte - 144), 9);
+    }
+}
+
+
+void IoTPlotterDeflate::match(uint16_t length, uint16_t distance) {
+    // Lengths 3 to 10 have a code each; after that, each group of four codes
+    // covers twice the range of the group before with one more extra bit
+    uint16_t n = length - IOTPLOTTER_DEFLATE_MIN_MATCH;
+    uint8_t  extra = n < 8 ? 0 : highestBit(n) - 2;
+    uint16_t code  = n < 8 ? 257 + n : 257 + 4 * (extra + 1) + (n >> extra) - 4;
+    if (code < 280) {
+        writeCode(code - 256, 7);
+    } else {
+        writeCode(0xC0 + (code - 280), 8);
+    }
+    writeBits(n & ((1 << extra) - 1), extra);
+
+    // Likewise distances 1 to 4, then pairs of codes
+    n     = distance - 1;
+    extra = n < 4 ? 0 : highestBit(n) - 1;
+    code  = n < 4 ? n : 2 * (extra + 1) + (n >> extra) - 2;
+    writeCode(code, 5);
+    writeBits(n & ((1 << extra) - 1), extra);
+}
+
+
+// Huffman codes go most significant bit first, unlike everything else
+void IoTPlotterDeflate::writeCode(uint16_t code, uint8_t bits) {
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    writeBits(reversed, bits);
+}
+
+
+void IoTPlotterDeflate::writeBits(uint32_t value, uint8_t bits) {
+    _bits |= value << _bitCount;
+    _bitCount += bits;
+    while (_bitCount >= 8) {
+        writeByte(_bits);
+        _bits >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+
+void IoTPlotterDeflate::writeByte(uint8_t byte) {
+    _out[_outLength++] = byte;
+    if (_outLength == sizeof(_out)) flushOutput();
+}
+
+
+void IoTPlotterDeflate::flushOutput(void) {
+    if (_outLength > 0) _output(_context, _out, _outLength);
+    _outLength = 0;
+}
+
+
+uint16_t IoTPlotterDeflate::hashAt(uint32_t position) const {
+    uint32_t bytes = at(position) |
+        static_cast<uint32_t>(at(position + 1)) << 8 |
+        static_cast<uint32_t>(at(position + 2)) << 16;
+    // Multiplicative hashing, keeping the well mixed top bits
+    uint32_t mixed = bytes * 2654435761UL;
+    return mixed >> (32 - IOTPLOTTER_DEFLATE_HASH_BITS);
+}
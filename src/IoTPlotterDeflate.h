@@ -0,0 +1,202 @@
+/**
+ * @file IoTPlotterDeflate.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterDeflate streaming gzip compressor and the
+ * IoTPlotterGzipSink that puts it between the serializer and another sink.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERDEFLATE_H_
+#define SRC_PUBLISHERS_IOTPLOTTERDEFLATE_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+/**
+ * @brief The bytes of history the compressor keeps for finding repeats; a
+ * power of two, larger than #IOTPLOTTER_DEFLATE_MAX_MATCH.
+ */
+#ifndef IOTPLOTTER_DEFLATE_WINDOW
+#if defined(__AVR__)
+#define IOTPLOTTER_DEFLATE_WINDOW 256
+#else
+#define IOTPLOTTER_DEFLATE_WINDOW 1024
+#endif
+#endif
+/**
+ * @brief The number of bits of the hash the compressor finds repeats with;
+ * the table takes two bytes per entry.
+ */
+#ifndef IOTPLOTTER_DEFLATE_HASH_BITS
+#if defined(__AVR__)
+#define IOTPLOTTER_DEFLATE_HASH_BITS 7
+#else
+#define IOTPLOTTER_DEFLATE_HASH_BITS 9
+#endif
+#endif
+/**
+ * @brief The longest repeat the compressor looks for.
+ *
+ * The window holds this much of what is still to be compressed, so repeats
+ * can reach back #IOTPLOTTER_DEFLATE_WINDOW less this many bytes.
+ */
+#define IOTPLOTTER_DEFLATE_MAX_MATCH 64
+
+
+/**
+ * @brief A streaming gzip compressor with a small, fixed memory footprint.
+ *
+ * The data is compressed as it is written, with LZ77 over a sliding window
+ * and deflate's fixed Huffman codes, and comes out as a complete gzip member
+ * (header, one deflate block and the CRC-32 and length trailer).  Only the
+ * window, a hash table of where each three bytes were last seen and a few
+ * bytes of output are held; nothing grows with the size of the input.
+ *
+ * The fixed codes cost nothing to set up or send, and suit the publisher's
+ * bodies well: the JSON is mostly the same tags, var codes and epoch digits
+ * over and over, which become short back references.
+ *
+ * The output depends only on the bytes written, not on how they were split
+ * up between calls.  The publisher relies on that to measure the compressed
+ * body, and then to compress it again as it goes out, a piece at each poll,
+ * handing each piece's output to that poll's writer with resume().
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterDeflate {
+ public:
+    /**
+     * @brief Where the compressed bytes go
+     *
+     * @param context The context given to begin()
+     * @param data The compressed bytes
+     * @param length The number of bytes
+     */
+    typedef void (*Output)(void* context, const char* data, size_t length);
+
+    /**
+     * @brief Start a new gzip member
+     *
+     * @param output The function to hand the compressed bytes to
+     * @param context Passed on to the output function
+     */
+    void begin(Output output, void* context);
+    /**
+     * @brief Carry on with the gzip member already begun, handing the
+     * compressed bytes from here on somewhere else
+     *
+     * @param output The function to hand the compressed bytes to
+     * @param context Passed on to the output function
+     */
+    void resume(Output output, void* context) {
+        _output  = output;
+        _context = context;
+    }
+    /**
+     * @brief Compress a run of bytes
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     */
+    void write(const char* data, size_t length);
+    /**
+     * @brief Compress whatever is left and write the gzip trailer
+     */
+    void finish(void);
+
+ private:
+    void     put(uint8_t byte);
+    void     step(void);
+    void     literal(uint8_t byte);
+    void     match(uint16_t length, uint16_t distance);
+    void     writeCode(uint16_t code, uint8_t bits);
+    void     writeBits(uint32_t value, uint8_t bits);
+    void     writeByte(uint8_t byte);
+    void     flushOutput(void);
+    uint8_t  at(uint32_t position) const {
+        return _window[position & (IOTPLOTTER_DEFLATE_WINDOW - 1)];
+    }
+    uint16_t hashAt(uint32_t position) const;
+
+    Output   _output  = nullptr;
+    void*    _context = nullptr;
+    uint8_t  _window[IOTPLOTTER_DEFLATE_WINDOW];
+    /** @brief The low bits of the last position each hash was seen at */
+    uint16_t _head[1 << IOTPLOTTER_DEFLATE_HASH_BITS];
+    uint32_t _received = 0;  ///< Bytes written in
+    uint32_t _encoded  = 0;  ///< Bytes compressed so far
+    uint32_t _crc      = 0;
+    uint32_t _bits     = 0;  ///< Bits waiting to make up a byte
+    uint8_t  _bitCount = 0;
+    char     _out[16];  ///< Compressed bytes waiting to be handed over
+    uint8_t  _outLength = 0;
+};
+
+
+/**
+ * @brief A sink that gzips everything written to it on its way to another
+ * sink.
+ *
+ * @tparam Sink The type of the sink the compressed bytes go to
+ *
+ * @ingroup the_publishers
+ */
+template <typename Sink>
+class IoTPlotterGzipSink {
+ public:
+    /**
+     * @brief Construct a new gzip sink, starting a new gzip member
+     *
+     * @param inner The sink to write the compressed bytes to
+     * @param deflate The compressor to use; it must not be in use elsewhere
+     * until finish() is called
+     * @param resume True to carry on with the member the compressor is
+     * already part way through, rather than start a new one
+     */
+    IoTPlotterGzipSink(Sink& inner, IoTPlotterDeflate& deflate,
+                       bool resume = false)
+        : _inner(inner),
+          _deflate(deflate) {
+        if (resume) {
+            _deflate.resume(&IoTPlotterGzipSink::pass, this);
+        } else {
+            _deflate.begin(&IoTPlotterGzipSink::pass, this);
+        }
+    }
+    /**
+     * @brief Compress a run of bytes
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes taken
+     */
+    size_t write(const char* data, size_t length) {
+        _deflate.write(data, length);
+        return length;
+    }
+    /**
+     * @brief Finish the gzip member, writing out everything still held
+     */
+    void finish(void) {
+        _deflate.finish();
+    }
+
+ private:
+    static void pass(void* context, const char* data, size_t length) {
+        static_cast<IoTPlotterGzipSink*>(context)->_inner.write(data, length);
+    }
+
+    Sink&              _inner;
+    IoTPlotterDeflate& _deflate;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERDEFLATE_H_
@@ -0,0 +1,85 @@
+/**
+ * @file IoTPlotterFormat.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterFormat class.
+ */
+
+#include "IoTPlotterFormat.h"
+
+
+uint8_t IoTPlotterFormat::formatUnsigned(char* out, uint32_t value) {
+    // A uint32_t has at most 10 decimal digits; fill them in from the right
+    char    digits[10];
+    uint8_t length = 0;
+    do {
+        digits[sizeof(digits) - ++length] =
+            static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while (value > 0);
+    memcpy(out, digits + sizeof(digits) - length, length);
+    return length;
+}
+
+
+uint8_t IoTPlotterFormat::formatFixed(char* out, float value,
+                                      uint8_t decimals) {
+    // NaN fails every comparison, so it is caught here along with anything
+    // whose integer part won't fit in a uint32_t
+    if (!(value > -4.0e9f && value < 4.0e9f)) return 0;
+    if (decimals > IOTPLOTTER_MAX_DECIMALS) decimals = IOTPLOTTER_MAX_DECIMALS;
+
+    // A negative zero keeps its sign, as it does through dtostrf
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t length = 0;
+    if (bits & 0x80000000UL) {
+        out[length++] = '-';
+        value         = -value;
+    }
+
+    // Split off the integer part first.  What's left is exact in a float, and
+    // exact again as an integer once scaled up by 2^55, so each decimal place
+    // comes off it without any rounding error.  Nothing is done in double,
+    // which on AVR is no wider than a float.
+    uint32_t whole    = static_cast<uint32_t>(value);
+    float    part     = value - static_cast<float>(whole);
+    uint32_t fraction = 0;
+    // Anything under 2^-31 is under half of the ninth place, and must round
+    // down to nothing
+    if (part >= 4.656612873077392578125e-10f) {
+        const uint64_t one  = 1ULL << 55;
+        uint64_t       rest = static_cast<uint64_t>(part * 36028797018963968.0f);
+        for (uint8_t d = 0; d < decimals; d++) {
+            rest     = (rest << 3) + (rest << 1);
+            fraction = fraction * 10 + static_cast<uint32_t>(rest >> 55);
+            rest &= one - 1;
+        }
+        // An exact tie goes to the even digit, as printf and dtostrf do
+        uint32_t last = decimals > 0 ? fraction : whole;
+        if (rest > one / 2 || (rest == one / 2 && (last & 1) != 0)) {
+            fraction++;
+        }
+    }
+    uint32_t scale = 1;
+    for (uint8_t d = 0; d < decimals; d++) scale *= 10;
+    if (fraction >= scale) {
+        // Rounding carried into the integer part
+        whole++;
+        fraction -= scale;
+    }
+
+    length += formatUnsigned(out + length, whole);
+    if (decimals > 0) {
+        out[length++] = '.';
+        // Zero padded from the right, to exactly the requested places
+        for (uint8_t d = decimals; d > 0; d--) {
+            out[length + d - 1] = static_cast<char>('0' + (fraction % 10));
+            fraction /= 10;
+        }
+        length += decimals;
+    }
+    return length;
+}
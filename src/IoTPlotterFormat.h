@@ -0,0 +1,76 @@
+/**
+ * @file IoTPlotterFormat.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterFormat class, which writes numbers as text
+ * straight into a caller's buffer without going through an Arduino String.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERFORMAT_H_
+#define SRC_PUBLISHERS_IOTPLOTTERFORMAT_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+/**
+ * @brief The most decimal places IoTPlotterFormat::formatFixed() will write.
+ *
+ * Nine places keeps the scaled fraction inside a uint32_t.
+ */
+#define IOTPLOTTER_MAX_DECIMALS 9
+
+/**
+ * @brief The largest number of characters either formatter can write: a sign,
+ * ten integer digits, a decimal point and #IOTPLOTTER_MAX_DECIMALS places.
+ */
+#define IOTPLOTTER_NUMBER_TEXT_SIZE (12 + IOTPLOTTER_MAX_DECIMALS)
+
+
+/**
+ * @brief Heap free number formatting for the IoTPlotter publisher.
+ *
+ * The logger's own formatting returns a new String for every value, which on
+ * a long running AVR or SAMD logger fragments the heap a little more with
+ * each post.  These formatters write into a buffer the caller provides and
+ * produce the same text as `dtostrf(value, 1, decimals, buffer)`, which is
+ * what the variables themselves use.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterFormat {
+ public:
+    /**
+     * @brief Write the base 10 text of an unsigned integer
+     *
+     * @param out The buffer to write to; it needs room for 10 characters.  No
+     * null terminator is written.
+     * @param value The number
+     * @return **uint8_t** The number of characters written
+     */
+    static uint8_t formatUnsigned(char* out, uint32_t value);
+
+    /**
+     * @brief Write a float with a fixed number of decimal places, rounding
+     * to the nearest (an exact tie goes to the even digit)
+     *
+     * @param out The buffer to write to; it needs room for
+     * #IOTPLOTTER_NUMBER_TEXT_SIZE characters.  No null terminator is written.
+     * @param value The number
+     * @param decimals The number of decimal places, at most
+     * #IOTPLOTTER_MAX_DECIMALS.  With none, there is no decimal point.
+     * @return **uint8_t** The number of characters written, or 0 if the value
+     * is not a number or too large to write this way
+     */
+    static uint8_t formatFixed(char* out, float value, uint8_t decimals);
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERFORMAT_H_
@@ -0,0 +1,574 @@
+/**
+ * @file IoTPlotterGateway.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterGateway class.
+ */
+
+#if !defined(ARDUINO)
+
+#include "IoTPlotterGateway.h"
+#include "IoTPlotterResponse.h"
+#include <chrono>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// The value posted for a variable with no reading, as the logger writes it
+#define IOTPLOTTER_GATEWAY_MISSING "-9999"
+// Samples the dispatcher takes off the ring before handing them out
+#define IOTPLOTTER_GATEWAY_DISPATCH_BATCH 256
+
+
+/**
+ * @brief A sink that stages bytes and sends them to a socket a packet's
+ * worth at a time.
+ */
+class IoTPlotterSocketSink {
+ public:
+    explicit IoTPlotterSocketSink(int fd) : _fd(fd) {}
+
+    size_t write(const char* data, size_t length) {
+        size_t remaining = length;
+        while (remaining > 0) {
+            if (_used == sizeof(_buffer)) flush();
+            size_t take = sizeof(_buffer) - _used;
+            if (take > remaining) take = remaining;
+            memcpy(_buffer + _used, data, take);
+            _used += take;
+            data += take;
+            remaining -= take;
+        }
+        return length;
+    }
+    bool flush(void) {
+        const char* data = _buffer;
+        while (_used > 0 && !_failed) {
+            ssize_t sent = send(_fd, data, _used, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) {
+                _failed = true;
+                break;
+            }
+            data += sent;
+            _used -= sent;
+        }
+        _used = 0;
+        return !_failed;
+    }
+    bool failed(void) const {
+        return _failed;
+    }
+
+ private:
+    int    _fd;
+    char   _buffer[1400];
+    size_t _used   = 0;
+    bool   _failed = false;
+};
+
+
+// Writes the request line and headers, the same as the publisher's
+template <typename Sink>
+static void writeHeaders(Sink& sink, const char* host, uint16_t port,
+                         const char* feedID, const char* apiKey,
+                         uint32_t length) {
+    IoTPlotterSerializer::writeHeaderBlock(sink, host, port, false, feedID,
+                                           false, true, apiKey);
+    IoTPlotterSerializer::writeText(sink,
+                                    IoTPlotterSerializer::contentLengthTag);
+    IoTPlotterSerializer::writeUnsigned(sink, length);
+    IoTPlotterSerializer::writeText(sink, IoTPlotterSerializer::endHeadersTag);
+}
+
+
+IoTPlotterGateway::IoTPlotterGateway(uint8_t workers)
+    : _ring(new Cell[IOTPLOTTER_GATEWAY_QUEUE_SIZE]),
+      _workers(workers > 0 ? workers : 1) {
+    for (size_t i = 0; i < IOTPLOTTER_GATEWAY_QUEUE_SIZE; i++) {
+        _ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+IoTPlotterGateway::~IoTPlotterGateway() {
+    end();
+    delete[] _ring;
+}
+
+
+int16_t IoTPlotterGateway::addStation(const char* feedID, const char* apiKey,
+                                      const char* const* varCodes,
+                                      uint8_t varCount, const char* host,
+                                      uint16_t port) {
+    if (_running || varCount > IOTPLOTTER_GATEWAY_MAX_VARIABLES) return -1;
+    _stations.emplace_back();
+    Station& station = _stations.back();
+    station.feedID   = feedID;
+    station.apiKey   = apiKey;
+    station.varCodes = varCodes;
+    station.varCount = varCount;
+    station.host     = host != nullptr ? host : IOTPLOTTER_HOST;
+    station.port     = port;
+    memset(station.decimals, 2, sizeof(station.decimals));
+    // Each station backs off on its own schedule
+    uint32_t hash = 2166136261UL;  // FNV-1a
+    for (const char* c = feedID; c != nullptr && *c != '\0'; c++) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619UL;
+    }
+    station.retry.seed(hash);
+    return static_cast<int16_t>(_stations.size() - 1);
+}
+
+
+void IoTPlotterGateway::setPrecision(int16_t station, uint8_t varNum,
+                                     uint8_t decimals) {
+    if (station < 0 || station >= static_cast<int16_t>(_stations.size()) ||
+        varNum >= IOTPLOTTER_GATEWAY_MAX_VARIABLES) {
+        return;
+    }
+    if (decimals > IOTPLOTTER_MAX_DECIMALS) decimals = IOTPLOTTER_MAX_DECIMALS;
+    _stations[station].decimals[varNum] = decimals;
+}
+
+
+void IoTPlotterGateway::setBatching(uint8_t maxSamples, uint32_t lingerMs) {
+    _maxBatch = maxSamples > 0 ? maxSamples : 1;
+    _lingerMs = lingerMs;
+}
+
+
+void IoTPlotterGateway::begin(void) {
+    if (_running) return;
+    _stopping    = false;
+    _workersDone = false;
+    _running     = true;
+    _dispatcher  = std::thread(&IoTPlotterGateway::dispatcherLoop, this);
+    for (uint8_t i = 0; i < _workers; i++) {
+        _pool.emplace_back(&IoTPlotterGateway::workerLoop, this);
+    }
+}
+
+
+void IoTPlotterGateway::end(void) {
+    if (!_running) return;
+    // The dispatcher lets the workers go once everything has been posted
+    _stopping = true;
+    _dispatcher.join();
+    for (std::thread& worker : _pool) worker.join();
+    _pool.clear();
+    _running = false;
+}
+
+
+// Claims a cell of the ring with a compare-and-swap on the enqueue position;
+// each cell's sequence number says whether it is free, so producers never
+// wait on each other or on the dispatcher
+bool IoTPlotterGateway::submit(int16_t station, uint32_t epoch,
+                               const float* values, uint8_t count) {
+    if (station < 0 || station >= static_cast<int16_t>(_stations.size())) {
+        _dropped++;
+        return false;
+    }
+    Cell*  cell;
+    size_t position = _enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &_ring[position & (IOTPLOTTER_GATEWAY_QUEUE_SIZE - 1)];
+        size_t   sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t lag      = static_cast<intptr_t>(sequence) -
+            static_cast<intptr_t>(position);
+        if (lag == 0) {
+            if (_enqueuePos.compare_exchange_weak(
+                    position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // The dispatcher hasn't freed this cell yet; the ring is full
+            _dropped++;
+            return false;
+        } else {
+            position = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    if (count > IOTPLOTTER_GATEWAY_MAX_VARIABLES) {
+        count = IOTPLOTTER_GATEWAY_MAX_VARIABLES;
+    }
+    Sample& sample   = cell->sample;
+    sample.submitted = nowMicros();
+    sample.epoch     = epoch;
+    sample.station   = station;
+    sample.count     = count;
+    memcpy(sample.values, values, count * sizeof(float));
+    cell->sequence.store(position + 1, std::memory_order_release);
+    _submitted++;
+    return true;
+}
+
+
+// Takes the oldest sample off the ring; only ever called by the dispatcher
+bool IoTPlotterGateway::pop(Sample& sample) {
+    Cell*    cell = &_ring[_dequeuePos & (IOTPLOTTER_GATEWAY_QUEUE_SIZE - 1)];
+    size_t   sequence = cell->sequence.load(std::memory_order_acquire);
+    intptr_t lag      = static_cast<intptr_t>(sequence) -
+        static_cast<intptr_t>(_dequeuePos + 1);
+    if (lag < 0) return false;  // Nothing written there yet
+    sample = cell->sample;
+    cell->sequence.store(_dequeuePos + IOTPLOTTER_GATEWAY_QUEUE_SIZE,
+                         std::memory_order_release);
+    _dequeuePos++;
+    return true;
+}
+
+
+// Moves samples from the ring to the stations' backlogs and hands out the
+// stations that are ready to post
+void IoTPlotterGateway::dispatcherLoop(void) {
+    std::vector<Sample> taken;
+    taken.reserve(IOTPLOTTER_GATEWAY_DISPATCH_BATCH);
+    Sample sample;
+    while (true) {
+        bool stopping = _stopping;
+        taken.clear();
+        while (taken.size() < IOTPLOTTER_GATEWAY_DISPATCH_BATCH &&
+               pop(sample)) {
+            taken.push_back(sample);
+        }
+        uint32_t now = nowMillis();
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (Sample& next : taken) {
+                next.arrived     = now;
+                Station& station = _stations[next.station];
+                if (station.pending.size() >= IOTPLOTTER_GATEWAY_MAX_PENDING) {
+                    station.pending.pop_front();
+                    _stats.dropped++;
+                }
+                station.pending.push_back(next);
+            }
+            bool waiting = false;
+            for (size_t i = 0; i < _stations.size(); i++) {
+                markReady(static_cast<int16_t>(i), now);
+                waiting |= !_stations[i].pending.empty();
+            }
+            if (stopping && taken.empty() && !waiting && _inFlight == 0 &&
+                _ready.empty()) {
+                // Everything submitted before end() has been dealt with
+                _workersDone = true;
+                _workReady.notify_all();
+                return;
+            }
+        }
+        if (taken.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+
+// Puts a station on the ready list if it has a batch worth posting; the lock
+// must be held
+void IoTPlotterGateway::markReady(int16_t index, uint32_t now) {
+    Station& station = _stations[index];
+    if (station.queued || station.inFlight || station.pending.empty()) return;
+    if (!_stopping) {
+        if (!station.retry.canAttempt(now)) return;
+        if (station.pending.size() < _maxBatch &&
+            now - station.pending.front().arrived < _lingerMs) {
+            return;
+        }
+    }
+    station.queued = true;
+    _ready.push_back(index);
+    _workReady.notify_one();
+}
+
+
+// Takes ready stations one at a time and posts a batch from each
+void IoTPlotterGateway::workerLoop(void) {
+    Connection          connection;
+    std::vector<Sample> batch;
+    IoTPlotterSnapshotBuffer<IOTPLOTTER_GATEWAY_SNAPSHOT_SIZE> snapshot;
+    batch.reserve(_maxBatch);
+
+    std::unique_lock<std::mutex> lock(_lock);
+    while (true) {
+        _workReady.wait(lock,
+                        [this] { return !_ready.empty() || _workersDone; });
+        if (_ready.empty()) break;
+        int16_t index = _ready.front();
+        _ready.pop_front();
+        Station& station = _stations[index];
+        station.queued   = false;
+        station.inFlight = true;
+        _inFlight++;
+        size_t take = station.pending.size() < _maxBatch
+            ? station.pending.size()
+            : _maxBatch;
+        batch.assign(station.pending.begin(), station.pending.begin() + take);
+        station.pending.erase(station.pending.begin(),
+                              station.pending.begin() + take);
+        lock.unlock();
+
+        // The station's settings don't change once running, so the post
+        // itself needs no lock
+        uint8_t  posted     = 0;
+        uint8_t  failure    = IOTPLOTTER_NO_FAILURE;
+        uint32_t retryAfter = 0;
+        int16_t  code = post(connection, station, batch, snapshot, posted,
+                             failure, retryAfter);
+
+        lock.lock();
+        finishBatch(index, batch, posted, code, failure, retryAfter);
+    }
+    lock.unlock();
+    disconnect(connection);
+}
+
+
+// Deals with the outcome of a post; the lock must be held
+void IoTPlotterGateway::finishBatch(int16_t index, std::vector<Sample>& batch,
+                                    uint8_t posted, int16_t code,
+                                    uint8_t failure, uint32_t retryAfter) {
+    Station& station = _stations[index];
+    uint32_t now     = nowMillis();
+    if (failure == IOTPLOTTER_NO_FAILURE) failure = IoTPlotterRetry::classify(code);
+    _stats.posts++;
+
+    size_t done = posted;
+    if (failure == IOTPLOTTER_NO_FAILURE) {
+        station.retry.recordSuccess();
+        _stats.acked += posted;
+        uint64_t acked = nowMicros();
+        for (size_t i = 0; i < posted; i++) {
+            uint64_t latency = acked - batch[i].submitted;
+            uint8_t  bucket  = 0;
+            while (latency > 1 &&
+                   bucket < IOTPLOTTER_GATEWAY_LATENCY_BUCKETS - 1) {
+                latency >>= 1;
+                bucket++;
+            }
+            _stats.latency[bucket]++;
+        }
+    } else if (failure == IOTPLOTTER_CLIENT_ERROR) {
+        // The portal will never take these
+        station.retry.recordFailure(failure, now, 0);
+        _stats.rejected += posted;
+    } else {
+        station.retry.recordFailure(failure, now, retryAfter * 1000);
+        _stats.failures++;
+        if (_stopping) {
+            // No more chances once stopping
+            _stats.dropped += posted > 0 ? posted : 1;
+            if (posted == 0) done = 1;
+        } else {
+            done = 0;
+        }
+    }
+    // Whatever wasn't posted goes back to the front, in order
+    station.pending.insert(station.pending.begin(), batch.begin() + done,
+                           batch.end());
+    while (station.pending.size() > IOTPLOTTER_GATEWAY_MAX_PENDING) {
+        station.pending.pop_front();
+        _stats.dropped++;
+    }
+    station.inFlight = false;
+    _inFlight--;
+    markReady(index, now);
+}
+
+
+// Lays out as much of the batch as fits in the snapshot and posts it,
+// returning the status code (or 504 if there was no answer)
+int16_t IoTPlotterGateway::post(Connection& connection, const Station& station,
+                                const std::vector<Sample>& batch,
+                                IoTPlotterSnapshot& snapshot, uint8_t& posted,
+                                uint8_t& failure, uint32_t& retryAfter) {
+    snapshot.clear();
+    for (uint8_t i = 0; i < station.varCount; i++) {
+        snapshot.addVarCode(station.varCodes[i], strlen(station.varCodes[i]));
+    }
+    size_t s = 0;
+    while (s < batch.size()) {
+        const Sample& sample = batch[s];
+        bool          fits   = snapshot.addEpoch(sample.epoch);
+        uint8_t       added  = 0;
+        for (uint8_t i = 0; fits && i < snapshot.varCount(); i++) {
+            char    text[IOTPLOTTER_NUMBER_TEXT_SIZE];
+            uint8_t length = i < sample.count
+                ? IoTPlotterFormat::formatFixed(text, sample.values[i],
+                                                station.decimals[i])
+                : 0;
+            if (length == 0) {
+                length = sizeof(IOTPLOTTER_GATEWAY_MISSING) - 1;
+                memcpy(text, IOTPLOTTER_GATEWAY_MISSING, length);
+            }
+            fits = snapshot.addValue(text, length);
+            if (fits) added++;
+        }
+        if (fits) {
+            s++;
+        } else if (s == 0 && added > 0) {
+            // Not even one sample fits; the variables it reached are posted,
+            // with the room the other var codes took, and that's sure to fit
+            snapshot.keepVarCodes(added);
+        } else {
+            snapshot.discardPartialSample();
+            break;
+        }
+    }
+    posted = snapshot.sampleCount();
+    IoTPlotterCountingSink counter;
+    IoTPlotterSerializer::writeJson(counter, snapshot);
+
+    // A kept-alive connection may have been closed by the server since its
+    // last use; then the post is made once more on a new one
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        bool reused = connection.fd >= 0 && connection.port == station.port &&
+            strcmp(connection.host, station.host) == 0;
+        if (!reused) {
+            disconnect(connection);
+            if (!connect(connection, station)) {
+                failure = IOTPLOTTER_CONNECT_FAILURE;
+                return 504;
+            }
+        }
+
+        IoTPlotterSocketSink sink(connection.fd);
+        writeHeaders(sink, station.host, station.port, station.feedID,
+                     station.apiKey, counter.count());
+        IoTPlotterSerializer::writeJson(sink, snapshot);
+        if (!sink.flush()) {
+            disconnect(connection);
+            if (reused) continue;
+            failure = IOTPLOTTER_TIMEOUT_FAILURE;
+            return 504;
+        }
+
+        IoTPlotterResponse response;
+        response.begin();
+        char buffer[512];
+        bool heard = false;
+        while (!response.isComplete()) {
+            ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) break;
+            heard = true;
+            for (ssize_t i = 0; i < received; i++) {
+                if (response.feed(buffer[i])) break;
+            }
+        }
+        if (response.hasStatus()) {
+            if (!response.isComplete() || !response.keepAlive()) {
+                disconnect(connection);
+            }
+            retryAfter = response.retryAfter();
+            return response.statusCode();
+        }
+        disconnect(connection);
+        if (reused && !heard) continue;
+        failure = IOTPLOTTER_TIMEOUT_FAILURE;
+        return 504;
+    }
+    failure = IOTPLOTTER_TIMEOUT_FAILURE;
+    return 504;
+}
+
+
+// Opens a connection to the station's server
+bool IoTPlotterGateway::connect(Connection& connection,
+                                const Station& station) {
+    char port[6];
+    snprintf(port, sizeof(port), "%u", station.port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* found = nullptr;
+    if (getaddrinfo(station.host, port, &hints, &found) != 0) return false;
+
+    struct timeval timeout;
+    timeout.tv_sec  = IOTPLOTTER_GATEWAY_TIMEOUT / 1000;
+    timeout.tv_usec = (IOTPLOTTER_GATEWAY_TIMEOUT % 1000) * 1000;
+    int fd          = -1;
+    for (struct addrinfo* address = found; address != nullptr;
+         address                  = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype,
+                    address->ai_protocol);
+        if (fd < 0) continue;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // The request is sent in whole packets already
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) return false;
+    connection.fd   = fd;
+    connection.host = station.host;
+    connection.port = station.port;
+    _connects++;
+    return true;
+}
+
+
+void IoTPlotterGateway::disconnect(Connection& connection) {
+    if (connection.fd >= 0) close(connection.fd);
+    connection.fd   = -1;
+    connection.host = nullptr;
+    connection.port = 0;
+}
+
+
+IoTPlotterGatewayStats IoTPlotterGateway::getStats(void) {
+    std::lock_guard<std::mutex> guard(_lock);
+    IoTPlotterGatewayStats      stats = _stats;
+    stats.submitted = _submitted;
+    stats.dropped += _dropped;
+    stats.connects = _connects;
+    return stats;
+}
+
+
+uint64_t IoTPlotterGateway::latencyPercentile(
+    const IoTPlotterGatewayStats& stats, float percentile) {
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < IOTPLOTTER_GATEWAY_LATENCY_BUCKETS; i++) {
+        total += stats.latency[i];
+    }
+    if (total == 0) return 0;
+    uint64_t wanted = static_cast<uint64_t>(total * percentile / 100.0f);
+    if (wanted < 1) wanted = 1;
+    uint64_t seen = 0;
+    for (uint8_t i = 0; i < IOTPLOTTER_GATEWAY_LATENCY_BUCKETS; i++) {
+        seen += stats.latency[i];
+        if (seen >= wanted) return 2ULL << i;
+    }
+    return 2ULL << (IOTPLOTTER_GATEWAY_LATENCY_BUCKETS - 1);
+}
+
+
+uint32_t IoTPlotterGateway::nowMillis(void) {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+uint64_t IoTPlotterGateway::nowMicros(void) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+#endif  // !defined(ARDUINO)
@@ -0,0 +1,305 @@
+/**
+ * @file IoTPlotterGateway.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterGateway class, which forwards samples from
+ * many stations to IoTPlotter from a Linux (or other POSIX) host.
+ *
+ * This is not part of the Arduino build; it is compiled only when ARDUINO is
+ * not defined.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERGATEWAY_H_
+#define SRC_PUBLISHERS_IOTPLOTTERGATEWAY_H_
+
+#if !defined(ARDUINO)
+
+// Included Dependencies
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "IoTPlotterSerializer.h"
+#include "IoTPlotterRetry.h"
+
+/**
+ * @brief The largest number of variables a gateway station can report.
+ */
+#ifndef IOTPLOTTER_GATEWAY_MAX_VARIABLES
+#define IOTPLOTTER_GATEWAY_MAX_VARIABLES 32
+#endif
+/**
+ * @brief The number of samples the gateway's ingest queue holds; a power of
+ * two.
+ */
+#ifndef IOTPLOTTER_GATEWAY_QUEUE_SIZE
+#define IOTPLOTTER_GATEWAY_QUEUE_SIZE 4096
+#endif
+/**
+ * @brief The most samples a station may have waiting to be posted before
+ * the oldest are dropped.
+ */
+#ifndef IOTPLOTTER_GATEWAY_MAX_PENDING
+#define IOTPLOTTER_GATEWAY_MAX_PENDING 1024
+#endif
+/**
+ * @brief The default number of worker threads posting to the portal.
+ */
+#ifndef IOTPLOTTER_GATEWAY_WORKERS
+#define IOTPLOTTER_GATEWAY_WORKERS 4
+#endif
+/**
+ * @brief The time allowed for each socket send or receive, in ms.
+ */
+#ifndef IOTPLOTTER_GATEWAY_TIMEOUT
+#define IOTPLOTTER_GATEWAY_TIMEOUT 10000L
+#endif
+/**
+ * @brief The size of each worker's snapshot, which sets how many samples fit
+ * in one post.
+ */
+#ifndef IOTPLOTTER_GATEWAY_SNAPSHOT_SIZE
+#define IOTPLOTTER_GATEWAY_SNAPSHOT_SIZE 8192
+#endif
+/**
+ * @brief The number of log2 buckets in the latency histogram.
+ */
+#define IOTPLOTTER_GATEWAY_LATENCY_BUCKETS 32
+
+
+/**
+ * @brief The running totals of a gateway.
+ */
+typedef struct IoTPlotterGatewayStats {
+    uint64_t submitted;  ///< Samples taken by submit()
+    uint64_t dropped;    ///< Samples lost to a full queue or backlog
+    uint64_t acked;      ///< Samples accepted by the portal
+    uint64_t rejected;   ///< Samples refused by the portal with a 4xx
+    uint64_t posts;      ///< Posts made
+    uint64_t failures;   ///< Posts that failed and were put back to retry
+    uint64_t connects;   ///< Connections opened
+    /**
+     * @brief The number of accepted samples whose time from submit() to the
+     * portal's answer was under 2^(i+1) µs, and at least 2^i µs
+     */
+    uint64_t latency[IOTPLOTTER_GATEWAY_LATENCY_BUCKETS];
+} IoTPlotterGatewayStats;
+
+
+/**
+ * @brief A multi-station gateway that batches samples per feed and posts them
+ * from a pool of worker threads over persistent connections.
+ *
+ * Any number of threads - one per radio or serial port, say - hand samples to
+ * submit().  It never blocks or takes a lock: the samples go into a bounded,
+ * lock-free multi-producer single-consumer ring.  A dispatcher thread drains
+ * the ring into a backlog per station and marks a station ready once it has
+ * a full batch, or its oldest sample has waited for the linger time.  The
+ * worker threads take ready stations one at a time, so each station's
+ * samples are posted in order, and lay each batch out with the same
+ * IoTPlotterSnapshot and IoTPlotterSerializer the Arduino publisher uses.
+ *
+ * Each worker keeps its connection open between posts (keep-alive), only
+ * reconnecting when the server closes it or the next station is on another
+ * server.  Responses are read with IoTPlotterResponse.  A failed post puts
+ * its samples back at the front of the station's backlog, and the station's
+ * own IoTPlotterRetry sets when it is tried again; samples refused with a
+ * 4xx are dropped.
+ *
+ * Stations must all be added before begin().
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterGateway {
+ public:
+    /**
+     * @brief Construct a new gateway
+     *
+     * @param workers The number of worker threads, and so of connections
+     */
+    explicit IoTPlotterGateway(uint8_t workers = IOTPLOTTER_GATEWAY_WORKERS);
+    /**
+     * @brief Destroy the gateway, stopping it first if need be
+     */
+    ~IoTPlotterGateway();
+
+    /**
+     * @brief Add a station and the feed its samples go to
+     *
+     * The strings are not copied, and must outlive the gateway.
+     *
+     * @param feedID The IoTPlotter.com feed ID
+     * @param apiKey The API key for the feed
+     * @param varCodes The graph name of each variable
+     * @param varCount The number of variables; at most
+     * #IOTPLOTTER_GATEWAY_MAX_VARIABLES
+     * @param host The server's host name; nullptr for iotplotter.com
+     * @param port The server's port
+     * @return **int16_t** The station's number, for submit(); -1 if the
+     * gateway is already running or there are too many variables
+     */
+    int16_t addStation(const char* feedID, const char* apiKey,
+                       const char* const* varCodes, uint8_t varCount,
+                       const char* host = nullptr, uint16_t port = 80);
+    /**
+     * @brief Set the number of decimal places a station's variable is posted
+     * with
+     *
+     * @param station The station's number
+     * @param varNum The variable's position
+     * @param decimals The number of decimal places; the default is 2
+     */
+    void setPrecision(int16_t station, uint8_t varNum, uint8_t decimals);
+    /**
+     * @brief Set how samples are gathered into posts
+     *
+     * @param maxSamples The most samples in one post; the snapshot may hold
+     * fewer, in which case the rest go in the next post
+     * @param lingerMs The longest a sample waits for others to join it
+     */
+    void setBatching(uint8_t maxSamples, uint32_t lingerMs);
+
+    /**
+     * @brief Start the dispatcher and worker threads
+     */
+    void begin(void);
+    /**
+     * @brief Post everything already submitted, then stop the threads
+     *
+     * Samples whose final post fails are dropped.
+     */
+    void end(void);
+
+    /**
+     * @brief Hand over a sample from a station.
+     *
+     * This is safe to call from any number of threads at once, and never
+     * blocks.
+     *
+     * @param station The station's number, from addStation()
+     * @param epoch The sample's epoch time
+     * @param values The station's values, in the order of its var codes
+     * @param count The number of values; missing values are posted as
+     * -9999
+     * @return **bool** False if the queue was full (or the station unknown)
+     * and the sample was dropped
+     */
+    bool submit(int16_t station, uint32_t epoch, const float* values,
+                uint8_t count);
+
+    /**
+     * @brief Get the gateway's running totals
+     *
+     * @return **IoTPlotterGatewayStats** A copy of the totals
+     */
+    IoTPlotterGatewayStats getStats(void);
+    /**
+     * @brief Estimate a percentile of the time from submit() to the
+     * portal's answer
+     *
+     * @param stats The totals to look in
+     * @param percentile The percentile, from 0 to 100
+     * @return **uint64_t** The top of the histogram bucket the percentile
+     * falls in, in µs
+     */
+    static uint64_t latencyPercentile(const IoTPlotterGatewayStats& stats,
+                                      float percentile);
+
+ private:
+    /**
+     * @brief A sample on its way through the gateway
+     */
+    struct Sample {
+        uint64_t submitted;  ///< Monotonic µs when submit() took it
+        uint32_t arrived;    ///< Monotonic ms when the dispatcher took it
+        uint32_t epoch;
+        int16_t  station;
+        uint8_t  count;
+        float    values[IOTPLOTTER_GATEWAY_MAX_VARIABLES];
+    };
+    /**
+     * @brief A slot of the ingest ring, with its sequence number
+     */
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Sample              sample;
+    };
+    /**
+     * @brief One station, its feed and its backlog
+     */
+    struct Station {
+        const char*        feedID;
+        const char*        apiKey;
+        const char* const* varCodes;
+        uint8_t            varCount;
+        const char*        host;
+        uint16_t           port;
+        uint8_t            decimals[IOTPLOTTER_GATEWAY_MAX_VARIABLES];
+        std::deque<Sample> pending;
+        IoTPlotterRetry    retry;
+        bool               queued   = false;  ///< On the ready list
+        bool               inFlight = false;  ///< Being posted by a worker
+    };
+    /**
+     * @brief A worker's persistent connection
+     */
+    struct Connection {
+        int         fd   = -1;
+        const char* host = nullptr;
+        uint16_t    port = 0;
+    };
+
+    bool    pop(Sample& sample);
+    void    dispatcherLoop(void);
+    void    workerLoop(void);
+    void    markReady(int16_t station, uint32_t now);
+    void    finishBatch(int16_t station, std::vector<Sample>& batch,
+                        uint8_t posted, int16_t code, uint8_t failure,
+                        uint32_t retryAfter);
+    int16_t post(Connection& connection, const Station& station,
+                 const std::vector<Sample>& batch,
+                 IoTPlotterSnapshot& snapshot, uint8_t& posted,
+                 uint8_t& failure, uint32_t& retryAfter);
+    bool    connect(Connection& connection, const Station& station);
+    void    disconnect(Connection& connection);
+
+    static uint32_t nowMillis(void);
+    static uint64_t nowMicros(void);
+
+    // The lock-free ingest ring; many producers, the dispatcher consumes
+    Cell*               _ring;
+    std::atomic<size_t> _enqueuePos{0};
+    size_t              _dequeuePos = 0;
+
+    std::vector<Station> _stations;
+    uint8_t              _workers;
+    uint8_t              _maxBatch = 16;
+    uint32_t             _lingerMs = 1000;
+
+    // Everything below is guarded by _lock
+    std::mutex               _lock;
+    std::condition_variable  _workReady;
+    std::deque<int16_t>      _ready;
+    uint16_t                 _inFlight = 0;
+    IoTPlotterGatewayStats   _stats    = {};
+    std::atomic<uint64_t>    _submitted{0};
+    std::atomic<uint64_t>    _dropped{0};
+    std::atomic<uint64_t>    _connects{0};
+
+    std::atomic<bool>        _running{false};
+    std::atomic<bool>        _stopping{false};
+    bool                     _workersDone = false;
+    std::thread              _dispatcher;
+    std::vector<std::thread> _pool;
+};
+
+#endif  // !defined(ARDUINO)
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERGATEWAY_H_
@@ -0,0 +1,92 @@
+/**
+ * @file IoTPlotterMetrics.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterMetrics struct.
+ */
+
+#include "IoTPlotterMetrics.h"
+
+
+// The graph names are only needed when the metrics are posted, so on an
+// Arduino they stay in flash, table and all
+#if defined(ARDUINO)
+#define IOTPLOTTER_METRIC_NAME(name, text) static const char name[] PROGMEM = text
+#define IOTPLOTTER_METRIC_TABLE static const char* const graphNames[] PROGMEM
+#else
+#define IOTPLOTTER_METRIC_NAME(name, text) static const char name[] = text
+#define IOTPLOTTER_METRIC_TABLE static const char* const graphNames[]
+#endif
+IOTPLOTTER_METRIC_NAME(postsName, "posts");
+IOTPLOTTER_METRIC_NAME(connectName, "connect_ms");
+IOTPLOTTER_METRIC_NAME(serializeName, "serialize_ms");
+IOTPLOTTER_METRIC_NAME(prerenderName, "prerender_ms");
+IOTPLOTTER_METRIC_NAME(sendName, "send_ms");
+IOTPLOTTER_METRIC_NAME(statusName, "status_ms");
+IOTPLOTTER_METRIC_NAME(bytesName, "bytes");
+IOTPLOTTER_METRIC_NAME(flushesName, "flushes");
+IOTPLOTTER_METRIC_NAME(tlsFullName, "tls_full");
+IOTPLOTTER_METRIC_NAME(tlsResumedName, "tls_resumed");
+IOTPLOTTER_METRIC_NAME(tlsFullMsName, "tls_full_ms");
+IOTPLOTTER_METRIC_NAME(tlsResumedMsName, "tls_resumed_ms");
+IOTPLOTTER_METRIC_NAME(tlsFullBytesName, "tls_full_bytes");
+IOTPLOTTER_METRIC_NAME(tlsResumedBytesName, "tls_resumed_bytes");
+IOTPLOTTER_METRIC_NAME(httpNoneName, "http_none");
+IOTPLOTTER_METRIC_NAME(http1xxName, "http_1xx");
+IOTPLOTTER_METRIC_NAME(http2xxName, "http_2xx");
+IOTPLOTTER_METRIC_NAME(http3xxName, "http_3xx");
+IOTPLOTTER_METRIC_NAME(http4xxName, "http_4xx");
+IOTPLOTTER_METRIC_NAME(http5xxName, "http_5xx");
+IOTPLOTTER_METRIC_TABLE = {
+    postsName,        connectName,         serializeName,  prerenderName,
+    sendName,         statusName,          bytesName,      flushesName,
+    tlsFullName,      tlsResumedName,      tlsFullMsName,  tlsResumedMsName,
+    tlsFullBytesName, tlsResumedBytesName, httpNoneName,   http1xxName,
+    http2xxName,      http3xxName,         http4xxName,    http5xxName};
+
+
+IoTPlotterMetrics::GraphName IoTPlotterMetrics::graphName(uint8_t field) {
+#if defined(ARDUINO)
+    return reinterpret_cast<GraphName>(pgm_read_ptr(&graphNames[field]));
+#else
+    return graphNames[field];
+#endif
+}
+
+
+void IoTPlotterMetrics::clear(void) {
+    memset(this, 0, sizeof(*this));
+}
+
+
+void IoTPlotterMetrics::add(const IoTPlotterMetrics& other) {
+    posts += other.posts;
+    connectMs += other.connectMs;
+    serializeMs += other.serializeMs;
+    prerenderMs += other.prerenderMs;
+    sendMs += other.sendMs;
+    statusMs += other.statusMs;
+    bytesWritten += other.bytesWritten;
+    flushes += other.flushes;
+    handshakes += other.handshakes;
+    resumptions += other.resumptions;
+    handshakeMs += other.handshakeMs;
+    resumeMs += other.resumeMs;
+    handshakeBytes += other.handshakeBytes;
+    resumeBytes += other.resumeBytes;
+    handshakeBytesCounted = handshakeBytesCounted ||
+        other.handshakeBytesCounted;
+    for (uint8_t i = 0; i < IOTPLOTTER_RESPONSE_CLASSES; i++) {
+        responses[i] += other.responses[i];
+    }
+}
+
+
+void IoTPlotterMetrics::addResponse(int16_t responseCode) {
+    uint8_t bucket = responseCode >= 100 && responseCode < 600
+        ? responseCode / 100
+        : 0;
+    responses[bucket]++;
+}
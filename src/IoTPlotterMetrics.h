@@ -0,0 +1,139 @@
+/**
+ * @file IoTPlotterMetrics.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterMetrics struct, the timings, byte counts and
+ * response statistics the IoTPlotter publisher keeps about its posts.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERMETRICS_H_
+#define SRC_PUBLISHERS_IOTPLOTTERMETRICS_H_
+
+// Included Dependencies
+#include "IoTPlotterSerializer.h"
+
+/**
+ * @brief The number of buckets in the response code histogram: one for no
+ * response at all, then one for each class from 1xx to 5xx.
+ */
+#define IOTPLOTTER_RESPONSE_CLASSES 6
+
+
+/**
+ * @brief Where the time and bytes of one or more posts went.
+ *
+ * The publisher keeps one of these for the most recent publish (which may
+ * be several posts, when batched samples overflow the snapshot or the queue
+ * is drained) and one that adds up every post since the last reset.
+ *
+ * The times are in milliseconds.  Sending is the time spent handing bytes to
+ * the client; serializing is the rest of the time spent building the request,
+ * including taking the snapshot.  Pre-rendering is the time spent laying out
+ * requests before connecting, which is connected time saved.
+ *
+ * Over TLS, each new connection is also counted as a full or a resumed
+ * handshake, with its time (the whole of connect(), TCP included) and, when
+ * the TLS client can count them, its bytes, so the two can be compared.
+ * Bytes that weren't counted are left out of writeJson() rather than posted
+ * as zeros.
+ *
+ * @ingroup the_publishers
+ */
+struct IoTPlotterMetrics {
+    uint16_t posts;         ///< Number of posts attempted
+    uint32_t connectMs;     ///< Time spent connecting, or checking a kept-alive connection
+    uint32_t serializeMs;   ///< Time spent formatting and laying out requests
+    uint32_t prerenderMs;   ///< Time spent laying out requests before connecting
+    uint32_t sendMs;        ///< Time spent writing to the client
+    uint32_t statusMs;      ///< Time from the end of a request to its status line
+    uint32_t bytesWritten;  ///< Bytes of request written to the client
+    uint32_t flushes;       ///< Number of times the tx buffer was written out
+    uint16_t handshakes;    ///< Connections made with a full TLS handshake
+    uint16_t resumptions;   ///< Connections that resumed a TLS session
+    uint32_t handshakeMs;   ///< Time spent connecting with a full handshake
+    uint32_t resumeMs;      ///< Time spent connecting with a resumed session
+    uint32_t handshakeBytes;  ///< Bytes of full handshakes, if the client can tell
+    uint32_t resumeBytes;     ///< Bytes of resumed handshakes, if the client can tell
+    bool     handshakeBytesCounted;  ///< The client could tell the bytes
+    /// Responses by class: none (0, or a malformed status line), 1xx, 2xx,
+    /// 3xx, 4xx and 5xx.  Failures to connect or send count as 504.
+    uint16_t responses[IOTPLOTTER_RESPONSE_CLASSES];
+
+    /**
+     * @brief Zero everything
+     */
+    void clear(void);
+    /**
+     * @brief Add another set of metrics to this one
+     *
+     * @param other The metrics to add
+     */
+    void add(const IoTPlotterMetrics& other);
+    /**
+     * @brief Count a response code in the histogram
+     *
+     * @param responseCode The http status code, or 0 for none
+     */
+    void addResponse(int16_t responseCode);
+
+    /**
+     * @brief Write the metrics as an IoTPlotter JSON body, one graph per
+     * metric, so they can be posted to a feed of their own
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     * @param epoch The epoch to give every value
+     */
+    template <typename Sink>
+    void writeJson(Sink& sink, uint32_t epoch) const;
+
+#if defined(ARDUINO)
+    /** @brief A graph name, which is kept in flash on an Arduino */
+    typedef const __FlashStringHelper* GraphName;
+#else
+    typedef const char* GraphName;
+#endif
+    /**
+     * @brief Get the graph name used by writeJson() for a field
+     *
+     * @param field The position of the field, in the order of the fields,
+     * followed by the histogram buckets
+     * @return **GraphName** The graph name
+     */
+    static GraphName graphName(uint8_t field);
+};
+
+
+template <typename Sink>
+void IoTPlotterMetrics::writeJson(Sink& sink, uint32_t epoch) const {
+    const uint32_t values[] = {
+        posts,          connectMs,    serializeMs,  prerenderMs,
+        sendMs,         statusMs,     bytesWritten, flushes,
+        handshakes,     resumptions,  handshakeMs,  resumeMs,
+        handshakeBytes, resumeBytes,  responses[0], responses[1],
+        responses[2],   responses[3], responses[4], responses[5]};
+    const uint8_t  count = sizeof(values) / sizeof(values[0]);
+    // Where handshakeBytes and resumeBytes are among the values
+    const uint8_t handshakeBytesAt = 12;
+    IoTPlotterSerializer::writeText(sink, IoTPlotterSerializer::samplingFeatureTag);
+    for (uint8_t i = 0; i < count; i++) {
+        if (!handshakeBytesCounted &&
+            (i == handshakeBytesAt || i == handshakeBytesAt + 1)) {
+            continue;
+        }
+        IoTPlotterSerializer::writeText(sink, graphName(i));
+        IoTPlotterSerializer::writeText(sink, IoTPlotterSerializer::JSONvalueTag);
+        IoTPlotterSerializer::writeUnsigned(sink, values[i]);
+        IoTPlotterSerializer::writeText(sink, IoTPlotterSerializer::epochTag);
+        IoTPlotterSerializer::writeUnsigned(sink, epoch);
+        IoTPlotterSerializer::writeText(sink,
+                                        i + 1 != count
+                                            ? IoTPlotterSerializer::nextGraphTag
+                                            : IoTPlotterSerializer::closingTag);
+    }
+}
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERMETRICS_H_
@@ -8,7 +8,14 @@
  */
 
 #include "IoTPlotterPublisher.h"
+#include "IoTPlotterTxWriter.h"
+#include "IoTPlotterQueue.h"
+#include "IoTPlotterBackfill.h"
+#include "IoTPlotterStore.h"
 
+#if IOTPLOTTER_QUEUE_MAX_VALUES < IOTPLOTTER_MAX_VARIABLES
+#error IOTPLOTTER_QUEUE_MAX_VALUES must be at least IOTPLOTTER_MAX_VARIABLES
+#endif
 
 // ============================================================================
 //  Functions for the IoTPlotter data portal receivers.
@@ -17,19 +24,24 @@
 // Constant values for post requests
 // Example taken from https://iotplotter.com/docs/
 // I want to refer to these more than once while ensuring there is only one copy
-// in memory
-const char* IoTPlotterPublisher::IoTPlotterHost       = "iotplotter.com";
-const char* IoTPlotterPublisher::postEndpoint        = "/api/v2/feed/";
-const int   IoTPlotterPublisher::IoTPlotterPort       = 80;  // LPM: Not necessary on IoTPlotter
-const char* IoTPlotterPublisher::apiHeader         = "\r\napi-key: ";  // LPM: was TokenHeader
-const char* IoTPlotterPublisher::contentTypeHeader =
-    "\r\nContent-Type: application/x-www-form-urlencoded";
-const char* IoTPlotterPublisher::contentLengthHeader = "\r\nContent-Length: ";
+// in memory (and in low-memory mode, that copy is in flash)
+IOTPLOTTER_TEXT_ARRAY(postEndpointText, IOTPLOTTER_POST_ENDPOINT);
+IOTPLOTTER_TEXT_ARRAY(apiHeaderText, IOTPLOTTER_API_HEADER);
+IOTPLOTTER_TEXT_ARRAY(contentTypeText, IOTPLOTTER_CONTENT_TYPE_HEADER);
+IOTPLOTTER_TEXT_ARRAY(contentLengthText, IOTPLOTTER_CONTENT_LENGTH_HEADER);
+const char*    IoTPlotterPublisher::IoTPlotterHost      = IOTPLOTTER_HOST;
+IoTPlotterText IoTPlotterPublisher::postEndpoint        = IOTPLOTTER_TEXT(postEndpointText);
+const int      IoTPlotterPublisher::IoTPlotterPort      = 80;  // LPM: Not necessary on IoTPlotter
+IoTPlotterText IoTPlotterPublisher::apiHeader           = IOTPLOTTER_TEXT(apiHeaderText);  // LPM: was TokenHeader
+IoTPlotterText IoTPlotterPublisher::contentTypeHeader   = IOTPLOTTER_TEXT(contentTypeText);
+IoTPlotterText IoTPlotterPublisher::contentLengthHeader = IOTPLOTTER_TEXT(contentLengthText);
 
-
-const char* IoTPlotterPublisher::samplingFeatureTag = "{\"data\":{\"";  // start of the JSON package
-const char* IoTPlotterPublisher::JSONvalueTag = "\":[{\"value\":";
-const char* IoTPlotterPublisher::epochTag       = ", \"epoch\":";        // LPM check this
+// The headers only some posts carry.  The rest of the fixed request text is
+// the IoTPlotterSerializer's, shared with the gateway.  The dataPublisher's
+// own postHeader, HTTPtag and hostHeader are always in RAM, so they aren't
+// used here.
+IOTPLOTTER_TEXT_ARRAY(chunkedText, "\r\nTransfer-Encoding: chunked");
+IOTPLOTTER_TEXT_ARRAY(gzipText, "\r\nContent-Encoding: gzip");
 
 
 // Constructors
@@ -64,81 +76,495 @@ IoTPlotterPublisher::~IoTPlotterPublisher() {}
 
 void IoTPlotterPublisher::setToken(const char* apiKey) {
     _registrationToken = apiKey;        // was registrationToken
+    renderHeader();
 }
 
 void IoTPlotterPublisher::setFeedID(const char* feedID) {
     _feedID = feedID;        // 
+    renderHeader();
+    // Every logger has its own feed, so its own spread of retries
+    uint32_t hash = 2166136261UL;  // FNV-1a
+    for (const char* c = feedID; c != nullptr && *c != '\0'; c++) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619UL;
+    }
+    _retry.seed(hash);
 }
 
 
-// Calculates how long the JSON string will be
-uint16_t IoTPlotterPublisher::calculateJsonSize() {
-    uint16_t jsonLength = 10;  // {"data":{"        start of the JSON string, to be followed by first graph name
-    // Cycle through all variables in the _internalArray holding the variable names
-    for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
-        // Create GRAPH_NAME based on getVarCodeAtI
-        jsonLength +=
-            _baseLogger->getVarCodeAtI(i).length();  // VarCode length, used as GRAPH_NAME
-        
-        jsonLength += 12;           //  ":[{"value":   The stuff after GRAPH_NAME, before reporting a numeric value
-        jsonLength += _baseLogger->getValueStringAtI(i).length();  // The length of the reported numeric value
-        jsonLength += 10;           // , "epoch":
-        jsonLength += 10;          // markedLocalEpochTime or markedUTCEpochTime, should be 10 digits
-        jsonLength +=  2;           // }]      end of GRAPH_NAME segment
+// Fixes the decimal places of one variable
+void IoTPlotterPublisher::setPrecision(uint8_t varNum, uint8_t decimals) {
+    if (varNum >= IOTPLOTTER_MAX_PRECISIONS) return;
+    if (decimals > IOTPLOTTER_MAX_DECIMALS) decimals = IOTPLOTTER_MAX_DECIMALS;
+    uint8_t shift = (varNum & 1) * 4;
+    _decimals[varNum / 2] = (_decimals[varNum / 2] & ~(0x0F << shift)) |
+        ((decimals + 1) << shift);
+}
+
+
+// Use a request header block built at compile time
+void IoTPlotterPublisher::setRequestHeader(const char* header) {
+    _staticHeader = header != nullptr;
+    if (_staticHeader) {
+        _header       = header;
+        _headerLength = strlen(header);
+    } else {
+        renderHeader();
+    }
+}
+
+
+// Renders the part of the request headers that is the same for every post
+void IoTPlotterPublisher::renderHeader(void) {
+    if (_staticHeader) return;
+#if IOTPLOTTER_HEADER_CACHE_SIZE > 0
+    IoTPlotterBufferSink sink(_headerCache, sizeof(_headerCache));
+    writeHeaderBlock(sink);
+    if (sink.overflowed()) {
+        // Too long to cache; it will be written out piece by piece instead
+        MS_DBG(F("IoTPlotter request header too long to cache"));
+        _header       = nullptr;
+        _headerLength = 0;
+    } else {
+        _header       = _headerCache;
+        _headerLength = sink.length();
+    }
+#endif
+}
+
+
+// The number of samples that go into each POST
+uint8_t IoTPlotterPublisher::batchSize(void) {
+    if (_sendEveryX < 1) return 1;
+    if (_sendEveryX > IOTPLOTTER_MAX_BATCH) return IOTPLOTTER_MAX_BATCH;
+    return _sendEveryX;
+}
+
+
+// Whether samples go through the cache rather than straight from the logger
+bool IoTPlotterPublisher::usesSampleCache(void) {
+    return batchSize() > 1 || _queue != nullptr || _backfill != nullptr;
+}
+
+
+// The number of variables reported in each sample
+uint8_t IoTPlotterPublisher::reportedVarCount(void) {
+    uint8_t varCount = _baseLogger->getArrayVarCount();
+    // Only the variables that fit in the sample cache can be batched or queued
+    if (usesSampleCache() && varCount > IOTPLOTTER_MAX_VARIABLES) {
+        return IOTPLOTTER_MAX_VARIABLES;
+    }
+    return varCount;
+}
+
+
+// Copies the logger's current values into the sample cache
+void IoTPlotterPublisher::cacheSample(void) {
+    uint8_t slot;
+    if (_sampleCount < IOTPLOTTER_MAX_BATCH) {
+        slot = (_sampleHead + _sampleCount) % IOTPLOTTER_MAX_BATCH;
+        _sampleCount++;
+    } else {
+        // The cache is full; the oldest sample is overwritten
+        MS_DBG(F("Sample cache full, dropping the oldest sample"));
+        slot        = _sampleHead;
+        _sampleHead = (_sampleHead + 1) % IOTPLOTTER_MAX_BATCH;
+    }
+    _sampleEpochs[slot] = Logger::markedLocalEpochTime;
+    for (uint8_t i = 0; i < reportedVarCount(); i++) {
+        _sampleValues[slot][i] = _baseLogger->getValueAtI(i);
+    }
+}
+
+
+// Empties the sample cache after its contents have been published
+void IoTPlotterPublisher::clearSamples(void) {
+    _sampleHead  = 0;
+    _sampleCount = 0;
+}
+
+
+// Forgets the oldest cached samples once they have been published
+void IoTPlotterPublisher::dropSamples(uint8_t count) {
+    if (count >= _sampleCount) {
+        clearSamples();
+        return;
+    }
+    _sampleHead = (_sampleHead + count) % IOTPLOTTER_MAX_BATCH;
+    _sampleCount -= count;
+}
+
+
+// Copies the text of everything to be published into the snapshot, formatting
+// each value exactly once
+uint8_t IoTPlotterPublisher::takeSnapshot(uint8_t firstVar, uint8_t maxVars,
+                                          uint8_t samples) {
+    uint32_t start = millis();
+    _lengthKnown   = false;
+    // With nothing cached, the live values from the logger are reported
+    uint8_t pending = _sampleCount > 0 ? _sampleCount : 1;
+    bool    exact   = samples > 0;
+    if (!exact || samples > pending) samples = pending;
 
-        // Test if there are additional variables to report
-        if (i + 1 != _baseLogger->getArrayVarCount()) {
-            jsonLength += 2;  // ,"     Start of next GRAPH_NAME iteration
+    if (_snapshot.firstVar() == firstVar && _snapshot.codeCount() > 0 &&
+        _snapshot.codeCount() <= maxVars) {
+        // The var codes never change, so they are only fetched once while
+        // they all fit
+        _snapshot.clearSamples();
+    } else {
+        _snapshot.clear(firstVar);
+        _snapshot.setCodeSource(copyVarCode, this);
+        for (uint8_t i = 0; i < maxVars; i++) {
+            String varCode = _baseLogger->getVarCodeAtI(firstVar + i);
+            if (_snapshot.addVarCode(varCode.c_str(), varCode.length())) {
+                continue;
+            }
+            // A var code too long for the whole snapshot is left in the
+            // logger and streamed from there as the request is written
+            if (_snapshot.codeCount() > 0 || !_snapshot.addVarCode("", 0)) {
+                break;
+            }
         }
     }
-    jsonLength += 2;  // }}   Close off the JSON string
 
-    return jsonLength;
+    while (_snapshot.varCount() > 0) {
+        uint8_t  varCount = _snapshot.varCount();
+        uint16_t added    = 0;  // Values that fit, across all the samples
+#if IOTPLOTTER_DEADBAND
+        if (!_draining) applyDeadband(firstVar, varCount, samples);
+#endif
+        uint8_t s = 0;
+        for (; s < samples; s++) {
+            bool fits = _snapshot.addEpoch(sampleEpoch(s));
+            for (uint8_t i = 0; fits && i < varCount; i++) {
+                // A graph that's left out needs no text, just its place
+                fits = _snapshot.isOmitted(i)
+                    ? _snapshot.addValue("", 0)
+                    : addValueAtI(firstVar + i, sampleValue(s, firstVar + i));
+                if (fits) added++;
+            }
+            if (!fits) break;
+        }
+        if (s == samples) break;
+        if (s > 0 && !exact) {
+            // The rest of the samples wait for the next post
+            _snapshot.discardPartialSample();
+            break;
+        }
+        // Drop enough variables for the samples to fit with the room their
+        // codes took; the rest go in the next post
+        uint8_t keep = added / (exact ? samples : 1);
+        if (keep >= varCount) keep = varCount - 1;
+        uint16_t codeLength;
+        _snapshot.varCode(0, codeLength);
+        if (keep == 0 && codeLength > 0) {
+            // Not even the first variable's values fit beside its var code;
+            // stream the var code instead, to leave the room for the values
+            _snapshot.keepVarCodes(0);
+            _snapshot.addVarCode("", 0);
+            continue;
+        }
+        _snapshot.keepVarCodes(keep);
+    }
+    _snapshotMillis = millis() - start;
+    return _snapshot.sampleCount();
 }
 
 
-// This prints a properly formatted JSON for IoTPlotter to an Arduino stream
-void IoTPlotterPublisher::printSensorDataJSON(Stream* stream) {
-    stream->print(samplingFeatureTag);     // {"data":{"
-    for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
-        stream->print(_baseLogger->getVarCodeAtI(i));  // VarCode, used as GRAPH_NAME
-        stream->print(JSONvalueTag);     // ":[{"value":
-        stream->print(_baseLogger->getValueStringAtI(i));       // print the actual value
-        stream->print(epochTag);      // , "epoch":
-        stream->print(Logger::markedLocalEpochTime); // print time  options: Logger::markedLocalEpochTime or Logger::markedUTCEpochTime 
-        stream->print("}]");
+// Copies a piece of a var code too long for the snapshot, for the serializer
+size_t IoTPlotterPublisher::copyVarCode(void* context, uint8_t position,
+                                        size_t offset, char* buffer,
+                                        size_t length) {
+    IoTPlotterPublisher* publisher = static_cast<IoTPlotterPublisher*>(context);
+    String varCode = publisher->_baseLogger->getVarCodeAtI(position);
+    if (offset >= varCode.length()) return 0;
+    if (length > varCode.length() - offset) length = varCode.length() - offset;
+    memcpy(buffer, varCode.c_str() + offset, length);
+    return length;
+}
+
 
-        if (i + 1 != _baseLogger->getArrayVarCount()) { 
-            stream->print(",\"");       // start of the next iteration of GRAPH_NAME 
+// Starts on the variables of the pending samples
+void IoTPlotterPublisher::beginPages(void) {
+    uint8_t varCount = reportedVarCount();
+    // Starting where the snapshot already holds the var codes saves fetching
+    // them again when they don't all fit at once
+    _pageStart    = _snapshot.firstVar() < varCount ? _snapshot.firstVar() : 0;
+    _pageVarsLeft = varCount;
+    _postSamples  = 0;
+}
+
+
+// Posts the next run of variables of the pending samples
+bool IoTPlotterPublisher::startPagePost(void) {
+    uint8_t varCount = reportedVarCount();
+    while (_pageVarsLeft > 0) {
+        uint8_t maxVars = varCount - _pageStart;
+        if (maxVars > _pageVarsLeft) maxVars = _pageVarsLeft;
+        uint8_t samples = takeSnapshot(_pageStart, maxVars, _postSamples);
+        uint8_t vars    = _snapshot.varCount();
+        if (samples == 0) {
+            String varCode = _baseLogger->getVarCodeAtI(_pageStart);
+            PRINTOUT(F("IoTPlotter variable"), varCode,
+                     F("doesn't fit in the snapshot, leaving it out"));
+            vars = 1;
+        } else if (_postSamples == 0) {
+            // Every later run of variables carries the same samples
+            _postSamples = samples;
         }
+        _pageStart = (_pageStart + vars) % varCount;
+        _pageVarsLeft -= vars;
+        if (samples > 0 && _snapshot.graphCount() > 0) {
+            if (_pageVarsLeft > 0 || vars < varCount) {
+                MS_DBG(F("Posting"), vars, F("of"), varCount,
+                       F("IoTPlotter variables"));
+            }
+            startPost(_postSamples);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// A value of one of the samples going into the snapshot
+float IoTPlotterPublisher::sampleValue(uint8_t sample, uint8_t varNum) {
+    if (_sampleCount == 0) return _baseLogger->getValueAtI(varNum);
+    return _sampleValues[(_sampleHead + sample) % IOTPLOTTER_MAX_BATCH][varNum];
+}
+
+
+// The epoch of one of the samples going into the snapshot
+uint32_t IoTPlotterPublisher::sampleEpoch(uint8_t sample) {
+    if (_sampleCount == 0) return Logger::markedLocalEpochTime;
+    return _sampleEpochs[(_sampleHead + sample) % IOTPLOTTER_MAX_BATCH];
+}
+
+
+#if IOTPLOTTER_DEADBAND
+// Leaves out the graphs whose values haven't moved past their deadband
+void IoTPlotterPublisher::applyDeadband(uint8_t firstVar, uint8_t varCount,
+                                        uint8_t samples) {
+    for (uint8_t i = 0; i < varCount; i++) {
+        uint8_t v = firstVar + i;  // The variable's place in the logger
+        if (v >= IOTPLOTTER_MAX_VARIABLES) break;
+        if ((_deadbandOn[v / 8] & (1 << (v % 8))) == 0) continue;
+        bool send = _reportedEpoch[v] == 0;  // Never published yet
+        for (uint8_t s = 0; !send && s < samples; s++) {
+            float    value = sampleValue(s, v);
+            uint32_t epoch = sampleEpoch(s);
+            if (_maxSilence > 0 && epoch - _reportedEpoch[v] >= _maxSilence) {
+                send = true;
+            } else if (isnan(value) || isnan(_reported[v])) {
+                // A sensor going missing, or coming back, is a change
+                send = isnan(value) != isnan(_reported[v]);
+            } else {
+                send = fabs(value - _reported[v]) > _deadband[v];
+            }
+        }
+        if (!send) _snapshot.omitVar(i);
+    }
+}
+
+
+// Notes what the portal has now been sent, for the deadband
+void IoTPlotterPublisher::recordReported(void) {
+    uint8_t last = _postSamples > 0 ? _postSamples - 1 : 0;
+    for (uint8_t i = 0; i < _snapshot.varCount(); i++) {
+        uint8_t v = _snapshot.firstVar() + i;
+        if (v >= IOTPLOTTER_MAX_VARIABLES) break;
+        if (_snapshot.isOmitted(i)) continue;
+        _reported[v]      = sampleValue(last, v);
+        _reportedEpoch[v] = sampleEpoch(last);
+    }
+}
+
+
+// Sets the deadband of one variable
+void IoTPlotterPublisher::setDeadband(uint8_t varNum, float threshold) {
+    if (varNum >= IOTPLOTTER_MAX_VARIABLES) return;
+    uint8_t bit = 1 << (varNum % 8);
+    if (threshold < 0) {
+        _deadbandOn[varNum / 8] &= ~bit;
+    } else {
+        _deadbandOn[varNum / 8] |= bit;
+        _deadband[varNum] = threshold;
     }
+}
+#else
+// Change-only publishing wasn't built in
+void IoTPlotterPublisher::setDeadband(uint8_t varNum, float threshold) {
+    (void)varNum;
+    (void)threshold;
+    PRINTOUT(F("IoTPlotter deadbands need IOTPLOTTER_DEADBAND set to 1"));
+}
+#endif
+
+
+// The decimal places a variable is published with
+uint8_t IoTPlotterPublisher::decimalsAtI(uint8_t varNum) {
+    // Nowhere to keep what the logger says, so don't ask it every time
+    if (varNum >= IOTPLOTTER_MAX_PRECISIONS) return IOTPLOTTER_DEFAULT_DECIMALS;
+    uint8_t known = (_decimals[varNum / 2] >> ((varNum & 1) * 4)) & 0x0F;
+    if (known > 0) return known - 1;
+    // Learn the variable's resolution from how the logger formats it.  This
+    // allocates a String, but only the once.
+    String  sample   = _baseLogger->formatValueStringAtI(varNum, 1.0f);
+    int     point    = sample.indexOf('.');
+    uint8_t decimals = point < 0 ? 0 : sample.length() - point - 1;
+    setPrecision(varNum, decimals);
+    return decimals > IOTPLOTTER_MAX_DECIMALS ? IOTPLOTTER_MAX_DECIMALS
+                                              : decimals;
+}
+
 
-    stream->print("}}");            // close off the JSON string
+// Formats one value straight into the snapshot
+bool IoTPlotterPublisher::addValueAtI(uint8_t varNum, float value) {
+    char    text[IOTPLOTTER_NUMBER_TEXT_SIZE];
+    uint8_t length =
+        IoTPlotterFormat::formatFixed(text, value, decimalsAtI(varNum));
+    if (length > 0) return _snapshot.addValue(text, length);
+    // NaN and huge values are left to the logger, so they read the same as
+    // they do on the SD card
+    String formatted = _baseLogger->formatValueStringAtI(varNum, value);
+    return _snapshot.addValue(formatted.c_str(), formatted.length());
+}
+
+
+// Calculates how long the JSON string will be
+uint16_t IoTPlotterPublisher::calculateJsonSize() {
+    // A publish in progress is still posting from the snapshot; measure that
+    if (!isPublishing()) takeSnapshot();
+    IoTPlotterCountingSink counter;
+    IoTPlotterSerializer::writeJson(counter, _snapshot);
+    return counter.count();
+}
+
+
+// This prints a properly formatted JSON for IoTPlotter to an Arduino stream
+void IoTPlotterPublisher::printSensorDataJSON(Stream* stream) {
+    if (!isPublishing()) takeSnapshot();
+    IoTPlotterStreamSink sink(stream);
+    IoTPlotterSerializer::writeJson(sink, _snapshot);
 }
 
 
 // This prints a fully structured post request for IoTPlotter to the
 // specified stream.
 void IoTPlotterPublisher::printIoTPlotterRequest(Stream* stream) {
-    // Stream the HTTP headers for the post request
-    stream->print(postHeader);          // POST  - found in dataPublisherBase.cpp
-    stream->print("http://");           // http://                                        
-    stream->print(IoTPlotterHost);      // iotplotter.com
-    stream->print(postEndpoint);        // /api/v2/feed/
-    stream->print(_feedID);             // your feed ID inserted into the http url
-    stream->print(HTTPtag);             // HTTP/1.1
-    stream->print("\r\nConnection: Close"); // Connection: Close
-    stream->print(apiHeader);           // api-key:
-    stream->print(_registrationToken);  // the actual API key for your feed
-    stream->print(contentTypeHeader);   // "\r\nContent-Type: application/x-www-form-urlencoded"
-    stream->print(contentLengthHeader); // "\r\nContent-Length: "
-    stream->print(calculateJsonSize()); // Hopefully the correct size of the JSON payload
-    stream->print(hostHeader);          // "\r\nHost: "  in dataPublisherBase.cpp
-    stream->print(IoTPlotterHost);      // iotplotter.com
-    stream->print("\r\n\r\n"); 
-
-    // Stream the JSON itself
-    printSensorDataJSON(stream);
+    // Laying out a request would change the state of the one being posted
+    if (isPublishing()) {
+        PRINTOUT(F("IoTPlotter publish in progress, request not printed"));
+        return;
+    }
+    takeSnapshot();
+    _gzip = false;
+    IoTPlotterStreamSink sink(stream);
+    writeRequest(sink);
+}
+
+
+// Writes the request line and the headers that don't change from post to
+// post, the same way the gateway does
+template <typename Sink>
+void IoTPlotterPublisher::writeHeaderBlock(Sink& sink) {
+    IoTPlotterSerializer::writeHeaderBlock(
+        sink, postHost(), postPort(), _tls != nullptr,
+        _metricsBody != nullptr ? _metricsFeedID : postFeedID(),
+        _csv && _metricsBody == nullptr, _keepAlive, postKey());
+}
+
+
+// Writes all of the request headers
+template <typename Sink>
+void IoTPlotterPublisher::writeHeaders(Sink& sink, bool chunked) {
+    // The cached header block, which is only for the feed's own data
+    if (_headerLength > 0 && _metricsBody == nullptr && _mirror == 0) {
+        sink.write(_header, _headerLength);
+    } else {
+        writeHeaderBlock(sink);
+    }
+
+    // and the ones that change
+    if (_gzip) {
+        IoTPlotterSerializer::writeText(sink, IOTPLOTTER_TEXT(gzipText));
+    }
+    if (chunked) {
+        IoTPlotterSerializer::writeText(sink, IOTPLOTTER_TEXT(chunkedText));
+    } else {
+        // Measure the body with the same code that will write it, once for
+        // each set of variables posted from a snapshot
+        if (_metricsBody != nullptr || !_lengthKnown ||
+            _lengthMask != postMask()) {
+            IoTPlotterCountingSink counter;
+            writeBody(counter);
+            _bodyLength  = counter.count();
+            _lengthMask  = postMask();
+            _lengthKnown = _metricsBody == nullptr;
+        }
+        IoTPlotterSerializer::writeText(sink,
+                                        IoTPlotterSerializer::contentLengthTag);
+        IoTPlotterSerializer::writeUnsigned(sink, _bodyLength);
+    }
+    // The blank line before the JSON
+    IoTPlotterSerializer::writeText(sink, IoTPlotterSerializer::endHeadersTag);
+}
+
+
+// Writes the request line, the headers and the JSON for the current snapshot
+template <typename Sink>
+void IoTPlotterPublisher::writeRequest(Sink& sink) {
+    writeHeaders(sink, false);
+    writeBody(sink);
+}
+
+
+// Writes the body of the current post, compressed if it's to be
+template <typename Sink>
+void IoTPlotterPublisher::writeBody(Sink& sink) {
+    if (!_gzip) {
+        writeContent(sink);
+        return;
+    }
+    IoTPlotterGzipSink<Sink> gzip(sink, *_deflate);
+    writeContent(gzip);
+    gzip.finish();
+}
+
+
+// Writes the next stretch of the body, compressed if it's to be
+template <typename Sink>
+bool IoTPlotterPublisher::writeBodyPiece(Sink& sink, size_t length) {
+    if (!_gzip) {
+        IoTPlotterWindowSink<Sink> window(sink, _bodySent, length);
+        writeContent(window);
+        _bodySent += window.passed();
+        return window.passed() < length;
+    }
+    // The compressor is left part way through the body between calls, so
+    // what it has already had is only skipped over here
+    IoTPlotterGzipSink<Sink> gzip(sink, *_deflate, _bodySent > 0);
+    IoTPlotterWindowSink<IoTPlotterGzipSink<Sink>> window(gzip, _bodySent,
+                                                         length);
+    writeContent(window);
+    _bodySent += window.passed();
+    if (window.passed() < length) {
+        gzip.finish();
+        return true;
+    }
+    return false;
+}
+
+
+// Writes the body of the current post as it is
+template <typename Sink>
+void IoTPlotterPublisher::writeContent(Sink& sink) {
+    if (_metricsBody != nullptr) {
+        _metricsBody->writeJson(sink, _metricsEpoch);
+    } else if (_csv) {
+        IoTPlotterSerializer::writeCsv(sink, _snapshot, postMask());
+    } else {
+        IoTPlotterSerializer::writeJson(sink, _snapshot, postMask());
+    }
 }
 
 
@@ -167,153 +593,904 @@ void IoTPlotterPublisher::begin(Logger&     baseLogger,
 // The return is the http status code of the response.
 // int16_t IoTPlotterPublisher::postDataEnviroDIY(void)
 int16_t IoTPlotterPublisher::publishData(Client* outClient) {
-    // Create a buffer for the portions of the request and response
-    char     tempBuffer[37] = "";
-    uint16_t did_respond    = 0;
-
-    MS_DBG(F("Outgoing JSON size:"), calculateJsonSize());
-
-    // Open a TCP/IP connection to the IoTPlotter Data Portal 
-    MS_DBG(F("Connecting client"));
-    MS_START_DEBUG_TIMER;
-    if (outClient->connect(IoTPlotterHost, IoTPlotterPort)) {        // TODO: Deal with the port that isn't needed? Or just leave it at 80
-        MS_DBG(F("Client connected after"), MS_PRINT_DEBUG_TIMER, F("ms\n"));
-
-        // copy the initial post header into the tx buffer
-        snprintf(txBuffer, sizeof(txBuffer), "%s", postHeader);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", "http://");
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", IoTPlotterHost);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", postEndpoint);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", _feedID);                 
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", HTTPtag);
-
-        // add the rest of the HTTP POST headers to the outgoing buffer
-        // Before adding each line/chunk to the outgoing buffer, we make sure
-        // there is space for that line, sending out buffer if not. This shouldn't
-        // really be an issue with the default buffer size of 750 char
-        if (bufferFree() < 28) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", "\r\nConnection: Close");
-
-        // Add on the API key header line
-        if (bufferFree() < 55) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", apiHeader);  // API key
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", _registrationToken);
-
-        // Add on the content type header line
-        if (bufferFree() < 55) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", contentTypeHeader);  // content type
-
-        // Add on the content length header line
-        if (bufferFree() < 25) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s",
-                 contentLengthHeader);
-        itoa(calculateJsonSize(), tempBuffer, 10);  // BASE 10
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", tempBuffer);
-        
-        // Add on the Host header line
-        if (bufferFree() < 25) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", hostHeader);  // Host header
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", IoTPlotterHost);  // Host name 
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", "\r\n");  // newline before JSON package
-
-        // put the start of the JSON into the outgoing response_buffer
-        if (bufferFree() < 21) printTxBuffer(outClient);
-        snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", samplingFeatureTag);        // sends {\"data\":{\"
-
-            //  For each variable that gets its own graph, you'll need to 
-            // start with a \"GRAPH_NAME\":[{ prefix where GRAPH_NAME is the title of your graph
-            // \"HALL0\":[{\"value\":xx.xx,\"epoch\":xxxxxxxxxx}]
-
-        for (uint8_t i = 0; i < _baseLogger->getArrayVarCount(); i++) {
-            // Once the buffer fills, send it out
-            if (bufferFree() < 47) printTxBuffer(outClient);
-            // Grab the VarCode, convert to character array, stick in tempBuffer
-            _baseLogger->getVarCodeAtI(i).toCharArray(tempBuffer, 37);
-            // print tempBuffer - this becomes the GRAPH_NAME on IoTPlotter
-            snprintf(txBuffer + strlen(txBuffer),
-                     sizeof(txBuffer) - strlen(txBuffer), "%s", tempBuffer);
-            // Insert the text that comes before reporting a numeric value                     
-            snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", JSONvalueTag);
-            // Grab the numeric value for this variable, convert to a character array and stick in tempBuffer
-            _baseLogger->getValueStringAtI(i).toCharArray(tempBuffer, 37);
-            // Print the variable value that's in tempBuffer now
-            snprintf(txBuffer + strlen(txBuffer),
-                     sizeof(txBuffer) - strlen(txBuffer), "%s", tempBuffer);
-            // Insert the text that comes after a value and before reporting the epoch timestamp                     
-            snprintf(txBuffer + strlen(txBuffer),
-                 sizeof(txBuffer) - strlen(txBuffer), "%s", epochTag);
-            // Get the unsigned long integer epoch timestamp and convert to ASCII character array to put into tempBuffer
-            ultoa(Logger::markedLocalEpochTime, tempBuffer, 10);  // BASE 10
-            // Print the contents of tempBuffer (the epoch timestamp)
-            snprintf(txBuffer + strlen(txBuffer),
-                     sizeof(txBuffer) - strlen(txBuffer), "%s", tempBuffer);
-            if (i + 1 != _baseLogger->getArrayVarCount()) {     // Prep for another variable to be printed
-                txBuffer[strlen(txBuffer)] = '}';
-                txBuffer[strlen(txBuffer)] = ']';
-                txBuffer[strlen(txBuffer)] = ',';
-                txBuffer[strlen(txBuffer)] = '"';      // was '\"', didn't work any better// to be followed by the next GRAPH_NAME (VarCode)
-            } else {        // finish off the JSON string
-                txBuffer[strlen(txBuffer)] = '}';
-                txBuffer[strlen(txBuffer)] = ']';
-                txBuffer[strlen(txBuffer)] = '}';
-                txBuffer[strlen(txBuffer)] = '}';
+    if (!startPublish(outClient)) return _publishResult;
+    // Run the whole publish through to the end before returning
+    while (poll()) {
+        // Don't spin flat out while the server thinks, or while waiting to
+        // retry
+        if (_postState == IOTPLOTTER_AWAIT_STATUS ||
+            _postState == IOTPLOTTER_BACKOFF) {
+            delay(10);
+        }
+    }
+    return _publishResult;
+}
+
+
+// Starts a publish which is then carried forward by calls to poll()
+bool IoTPlotterPublisher::startPublish(Client* outClient) {
+    if (isPublishing()) {
+        MS_DBG(F("IoTPlotter publish already in progress"));
+        return false;
+    }
+    _publishResult = 0;
+
+    // When batching, hold the sample until there are enough to send together
+    if (usesSampleCache()) {
+        cacheSample();
+        if (_sampleCount < batchSize()) {
+            MS_DBG(F("Cached sample"), _sampleCount, F("of"), batchSize(),
+                   F("for IoTPlotter"));
+            return false;
+        }
+    }
+
+    // Don't go near the server while backing off from earlier failures, as
+    // long as the samples can wait on the queue; without one they're posted
+    // anyway rather than lost
+    if (_queue != nullptr && !_retry.canAttempt(millis())) {
+        MS_DBG(F("IoTPlotter backing off for another"),
+               _retry.waitRemaining(millis()), F("ms"));
+        queueSamples();
+        return false;
+    }
+    _retry.beginPublish();
+
+    _postClient    = outClient;
+    _draining      = false;
+    _mirror        = 0;
+    _lastMetrics.clear();
+    beginPages();
+    if (!startPagePost()) {
+        if (_postSamples == 0 && reportedVarCount() > 0) {
+            // Not one of the variables fits; they never will
+            PRINTOUT(F("No IoTPlotter variables fit in the snapshot"));
+            _publishResult = 413;
+        } else {
+            // Every variable is inside its deadband; there's nothing to say
+            MS_DBG(F("No IoTPlotter values changed, not posting"));
+        }
+        clearSamples();
+        return false;
+    }
+    return true;
+}
+
+
+// Takes the next step of a publish started with startPublish()
+bool IoTPlotterPublisher::poll(void) {
+    switch (_postState) {
+        case IOTPLOTTER_CONNECT: {
+            if (_keepAlive && _connectionOpen && _postClient->connected() &&
+                _openPort == postPort() &&
+                strcmp(_openHost, postHost()) == 0) {
+                // Carry on over the connection left open by the last post
+                MS_DBG(F("Reusing open connection"));
+                _postMetrics.connectMs += millis() - _phaseStart;
+                _connectionReused = true;
+                _connectionsReused++;
+                _bytesSent = 0;
+                _bodySent  = 0;
+                _bodyBegun = false;
+                enterPhase(IOTPLOTTER_SEND);
+                break;
+            }
+            if (_connectionOpen) {
+                // The server or the modem has dropped the kept-alive
+                // connection since the last post, or it goes somewhere else
+                _postClient->stop();
+                _connectionOpen = false;
             }
+            // Open a TCP/IP connection to the IoTPlotter Data Portal
+            MS_DBG(F("Connecting client"));
+            if (_tls != nullptr) _tls->beginConnect(postHost(), postPort());
+            if (_postClient->connect(postHost(), postPort())) {
+                MS_DBG(F("Client connected after"), millis() - _phaseStart,
+                       F("ms\n"));
+                _postMetrics.connectMs += millis() - _phaseStart;
+                if (_tls != nullptr) recordHandshake();
+                _connectionOpen   = true;
+                _openHost         = postHost();
+                _openPort         = postPort();
+                _connectionReused = false;
+                _connectionsOpened++;
+                _bytesSent = 0;
+                _bodySent  = 0;
+                _bodyBegun = false;
+                enterPhase(IOTPLOTTER_SEND);
+            } else if (millis() - _phaseStart >= _connectTimeout) {
+                _postMetrics.connectMs += millis() - _phaseStart;
+                if (_tls != nullptr) _tls->endConnect(false);
+                PRINTOUT(F("\n -- Unable to Establish Connection to IoTPlotter "
+                           "Data Portal --"));
+                _postFailure = IOTPLOTTER_CONNECT_FAILURE;
+                finishPost(504);
+            }
+            break;
         }
+        case IOTPLOTTER_SEND: {
+            // Send the next buffer-full of the request.  A request laid out
+            // live has its headers run from the top each time, which costs
+            // little, and then its body carried on from where the last poll
+            // left it.  A chunked body is sent a buffer-full at a time like
+            // any other, each poll's ending a chunk, so it can time out too.
+            uint32_t           start = millis();
+            IoTPlotterTxWriter writer(txBuffer, sizeof(txBuffer), _postClient,
+                                      _mtu);
+            bool               done;
+            // As many whole writes as fit in the buffer
+            size_t segment = _mtu > 0 && _mtu < sizeof(txBuffer)
+                ? _mtu
+                : sizeof(txBuffer);
+            size_t length = sizeof(txBuffer) / segment * segment;
+            if (_prerendered != IOTPLOTTER_LIVE) {
+                // Nothing to lay out, just send the next stretch
+                if (length > _prerenderLength - _bytesSent) {
+                    length = _prerenderLength - _bytesSent;
+                }
+                if (_prerendered == IOTPLOTTER_IN_BUFFER) {
+                    writer.write(_prerenderBuffer + _bytesSent, length);
+                } else {
+                    // Read back from the spill through the pre-render buffer
+                    if (length > _prerenderSize) {
+                        length = _prerenderSize >= segment
+                            ? _prerenderSize / segment * segment
+                            : _prerenderSize;
+                    }
+                    if (_spill->read(_bytesSent,
+                                     reinterpret_cast<uint8_t*>(
+                                         _prerenderBuffer),
+                                     length) != length) {
+                        PRINTOUT(F("Unable to read back IoTPlotter request"));
+                        _postResponse = 504;
+                        enterPhase(IOTPLOTTER_CLOSE);
+                        break;
+                    }
+                    writer.write(_prerenderBuffer, length);
+                }
+                writer.flush();
+                _bytesSent += length;
+                done = _bytesSent >= _prerenderLength;
+            } else {
+                size_t budget = length;
+                if (!_bodyBegun) {
+                    IoTPlotterWindowSink<IoTPlotterTxWriter> window(
+                        writer, _bytesSent, budget);
+                    writeHeaders(window, _postChunked);
+                    _bytesSent += window.passed();
+                    budget -= window.passed();
+                    _bodyBegun = budget > 0;
+                }
+                done = false;
+                if (_bodyBegun && budget > 0) {
+                    if (_postChunked) writer.beginChunked();
+                    done = writeBodyPiece(writer, budget);
+                    if (_postChunked && done) writer.finishChunked();
+                }
+                writer.flush();
+            }
+            // Leave the shared buffer empty (and null terminated) for the
+            // other publishers, which find its end with strlen
+            emptyTxBuffer();
 
-        // Send out the finished request (or the last unsent section of it)
-        printTxBuffer(outClient, true);
+            // Whatever time wasn't spent in the client went to laying out
+            // the request
+            uint32_t sendMs = writer.sendMillis();
+            _postMetrics.sendMs += sendMs;
+            _postMetrics.serializeMs += millis() - start - sendMs;
+            _postMetrics.bytesWritten += writer.bytesSent();
+            _postMetrics.flushes += writer.flushCount();
 
-        // Wait 10 seconds for a response from the server
-        uint32_t start = millis();
-        while ((millis() - start) < 10000L && outClient->available() < 12) {
-            delay(10);
+            if (writer.hasWriteError()) {
+                if (_connectionReused) {
+                    reconnect();
+                } else {
+                    PRINTOUT(F("Unable to send to IoTPlotter"));
+                    _postResponse = 504;
+                    _postFailure  = IOTPLOTTER_TIMEOUT_FAILURE;
+                    enterPhase(IOTPLOTTER_CLOSE);
+                }
+            } else if (done) {
+                // That was the end of the request
+                _response.begin();
+                enterPhase(IOTPLOTTER_AWAIT_STATUS);
+            } else if (millis() - _phaseStart >= _sendTimeout) {
+                PRINTOUT(F("Timed out sending to IoTPlotter"));
+                _postResponse = 504;
+                _postFailure  = IOTPLOTTER_TIMEOUT_FAILURE;
+                enterPhase(IOTPLOTTER_CLOSE);
+            }
+            break;
         }
+        case IOTPLOTTER_AWAIT_STATUS: {
+            // Take whatever has arrived so far, without waiting for more
+            readResponse();
+            if (_response.hasStatus()) {
+                _postMetrics.statusMs += millis() - _phaseStart;
+                _postResponse = _response.statusCode();
+                // The rest of the response has to be read off a connection
+                // that's going to be used again.  Otherwise only a failure's
+                // headers matter, for a Retry-After.
+                enterPhase(_keepAlive || _postResponse / 100 != 2
+                               ? IOTPLOTTER_READ_BODY
+                               : IOTPLOTTER_CLOSE);
+            } else if (_connectionReused && !_postClient->connected() &&
+                       _postClient->available() <= 0) {
+                // The server closed the kept-alive connection before it saw
+                // the request; send it again on a new one
+                reconnect();
+            } else if (millis() - _phaseStart >= _statusTimeout) {
+                _postResponse = 504;
+                _postFailure  = IOTPLOTTER_TIMEOUT_FAILURE;
+                enterPhase(IOTPLOTTER_CLOSE);
+            }
+            break;
+        }
+        case IOTPLOTTER_READ_BODY: {
+            readResponse();
+            if (_response.isComplete() ||
+                (!_keepAlive && _response.hasHeaders()) ||
+                millis() - _phaseStart >= _statusTimeout) {
+                enterPhase(IOTPLOTTER_CLOSE);
+            }
+            break;
+        }
+        case IOTPLOTTER_CLOSE: {
+            if (_keepAlive && _response.isComplete() &&
+                _response.keepAlive()) {
+                // Leave the connection open for the next post
+                MS_DBG(F("Keeping connection open"));
+            } else {
+                // Close the TCP/IP connection
+                MS_DBG(F("Stopping client"));
+                MS_START_DEBUG_TIMER;
+                _postClient->stop();
+                MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER,
+                       F("ms"));
+                _connectionOpen = false;
+            }
+            finishPost(_postResponse);
+            break;
+        }
+        case IOTPLOTTER_BACKOFF: {
+            // Send the same request again once the scheduler allows it
+            if (_retry.canAttempt(millis())) enterPhase(IOTPLOTTER_CONNECT);
+            break;
+        }
+        default: break;
+    }
+    return isPublishing();
+}
+
 
-        // Read only the first 12 characters of the response
-        // We're only reading as far as the http code, anything beyond that
-        // we don't care about.
-        did_respond = outClient->readBytes(tempBuffer, 12);
+// Feeds whatever has arrived of the response to the parser
+void IoTPlotterPublisher::readResponse(void) {
+    while (!_response.isComplete() && _postClient->available() > 0) {
+        int c = _postClient->read();
+        if (c < 0) break;
+        _response.feed(static_cast<char>(c));
+        // Without keep-alive, nothing after the status of a success or the
+        // headers of a failure matters
+        if (!_keepAlive &&
+            (_response.hasHeaders() ||
+             (_response.hasStatus() && _response.statusCode() / 100 == 2))) {
+            break;
+        }
+    }
+}
+
+
+// Drops a dead kept-alive connection and starts the post over on a new one
+void IoTPlotterPublisher::reconnect(void) {
+    MS_DBG(F("Kept-alive connection was closed, reconnecting"));
+    _postClient->stop();
+    _connectionOpen   = false;
+    _connectionReused = false;
+    _reconnects++;
+    enterPhase(IOTPLOTTER_CONNECT);
+}
+
+
+// Turns persistent connections on or off
+void IoTPlotterPublisher::setKeepAlive(bool keepAlive) {
+    _keepAlive = keepAlive;
+    if (!keepAlive) closeConnection();
+    // The Connection header is part of the cached header block
+    renderHeader();
+}
 
-        // Close the TCP/IP connection
-        MS_DBG(F("Stopping client"));
-        MS_RESET_DEBUG_TIMER;
-        outClient->stop();
-        MS_DBG(F("Client stopped after"), MS_PRINT_DEBUG_TIMER, F("ms"));
+
+// Switches between plain HTTP and TLS
+void IoTPlotterPublisher::setTls(IoTPlotterTlsAdapter* tls) {
+    // The old connection is to the wrong port, or in the clear
+    closeConnection();
+    _tls = tls;
+    // The scheme is part of the cached header block
+    renderHeader();
+}
+
+
+// Counts the handshake of the connection just made as full or resumed
+void IoTPlotterPublisher::recordHandshake(void) {
+    uint32_t elapsed = millis() - _phaseStart;
+    bool     resumed = _tls->endConnect(true);
+    uint32_t bytes   = _tls->handshakeBytes();
+    // No handshake takes 0 bytes; that's a client that can't count them
+    if (bytes > 0) _postMetrics.handshakeBytesCounted = true;
+    if (resumed) {
+        MS_DBG(F("TLS session resumed"));
+        _postMetrics.resumptions++;
+        _postMetrics.resumeMs += elapsed;
+        _postMetrics.resumeBytes += bytes;
     } else {
-        PRINTOUT(F("\n -- Unable to Establish Connection to EnviroDIY Data "
-                   "Portal --"));
+        _postMetrics.handshakes++;
+        _postMetrics.handshakeMs += elapsed;
+        _postMetrics.handshakeBytes += bytes;
+    }
+}
+
+
+// Switches the body between JSON and CSV
+void IoTPlotterPublisher::setCsvPayload(bool csv) {
+    _csv         = csv;
+    _lengthKnown = false;
+    // The endpoint is part of the cached header block
+    renderHeader();
+}
+
+
+// Closes a connection left open for the next post
+void IoTPlotterPublisher::closeConnection(void) {
+    if (_connectionOpen && !isPublishing() && _postClient != nullptr) {
+        _postClient->stop();
+        _connectionOpen = false;
+    }
+}
+
+
+// Sets how long each phase of a post may take
+void IoTPlotterPublisher::setPhaseTimeouts(uint32_t connectTimeout,
+                                           uint32_t sendTimeout,
+                                           uint32_t statusTimeout) {
+    _connectTimeout = connectTimeout;
+    _sendTimeout    = sendTimeout;
+    _statusTimeout  = statusTimeout;
+}
+
+
+// Moves a post on to its next phase and starts that phase's clock
+void IoTPlotterPublisher::enterPhase(uint8_t phase) {
+    _postState  = phase;
+    _phaseStart = millis();
+}
+
+
+// Lays out the whole request before connecting, where there's room for it
+void IoTPlotterPublisher::prerender(void) {
+    _prerendered = IOTPLOTTER_LIVE;
+    if (_prerenderBuffer == nullptr) return;
+    uint32_t start = millis();
+
+    IoTPlotterBufferSink sink(_prerenderBuffer, _prerenderSize);
+    writeRequest(sink);
+    if (!sink.overflowed()) {
+        _prerendered     = IOTPLOTTER_IN_BUFFER;
+        _prerenderLength = sink.length();
+    } else if (_spill != nullptr && _spill->clear()) {
+        IoTPlotterStoreSink spill(_spill, _prerenderBuffer, _prerenderSize);
+        writeRequest(spill);
+        if (spill.finish()) {
+            _prerendered     = IOTPLOTTER_IN_SPILL;
+            _prerenderLength = spill.length();
+        }
+    }
+    if (_prerendered == IOTPLOTTER_LIVE) {
+        MS_DBG(F("IoTPlotter request too big to pre-render"));
+    }
+    _postMetrics.prerenderMs += millis() - start;
+}
+
+
+// Decides whether to gzip the body of the post about to start
+void IoTPlotterPublisher::chooseEncoding(void) {
+    // A length measured compressed is no good for the body as it is
+    if (_gzip) _lengthKnown = false;
+    _gzip = false;
+    if (_deflate == nullptr || _metricsBody != nullptr ||
+        (_refused[_mirror] & IOTPLOTTER_REFUSED_GZIP)) {
+        return;
     }
+    uint32_t start = millis();
 
-    // Process the HTTP response
-    int16_t responseCode = 0;
-    if (did_respond > 0) {
-        char responseCode_char[4];
-        for (uint8_t i = 0; i < 3; i++) {
-            responseCode_char[i] = tempBuffer[i + 9];
+    IoTPlotterCountingSink plain;
+    writeContent(plain);
+    _bodyLength  = plain.count();
+    _lengthMask  = postMask();
+    _lengthKnown = true;
+    if (_bodyLength >= _compressMin) {
+        if (_postChunked) {
+            // Not worth a second pass just to compare
+            _gzip        = true;
+            _lengthKnown = false;
+        } else {
+            // The compressed length is needed for the Content-Length anyway
+            IoTPlotterCountingSink                     packed;
+            IoTPlotterGzipSink<IoTPlotterCountingSink> gzip(packed, *_deflate);
+            writeContent(gzip);
+            gzip.finish();
+            if (packed.count() < _bodyLength) {
+                _gzip       = true;
+                _bodyLength = packed.count();
+            }
         }
-        responseCode = atoi(responseCode_char);
-    } else {
-        responseCode = 504;
     }
+    MS_DBG(F("IoTPlotter body of"), plain.count(), F("bytes"),
+           _gzip ? F("gzipped") : F("sent as it is"));
+    _postMetrics.serializeMs += millis() - start;
+}
+
+
+// Turns compression of the body on or off
+void IoTPlotterPublisher::setCompression(IoTPlotterDeflate* deflate,
+                                         uint16_t           minBodyLength) {
+    _deflate     = deflate;
+    _compressMin = minBodyLength;
+    _lengthKnown = false;
+}
+
+
+// Sets where requests are laid out before connecting
+void IoTPlotterPublisher::setPrerender(char* buffer, uint16_t size,
+                                       IoTPlotterStore* spill) {
+    _prerenderBuffer = buffer;
+    _prerenderSize   = size;
+    _spill           = spill;
+}
 
+
+// Begins posting the current snapshot
+void IoTPlotterPublisher::startPost(uint8_t samples) {
+    _postSamples  = samples;
+    _postResponse = 0;
+    _postFailure  = IOTPLOTTER_NO_FAILURE;
+    // Nothing from the last response may stand in for this one's
+    _response.begin();
+    _postMetrics.clear();
+    _postMetrics.serializeMs = _snapshotMillis;
+    // A destination that has refused chunked bodies gets a Content-Length
+    _postChunked = _chunked &&
+        !(_refused[_mirror] & IOTPLOTTER_REFUSED_CHUNKED);
+    chooseEncoding();
+    prerender();
+    enterPhase(IOTPLOTTER_CONNECT);
+}
+
+
+// Deals with the outcome of a post, and starts the next one if there is more
+// to send
+void IoTPlotterPublisher::finishPost(int16_t responseCode) {
     PRINTOUT(F("-- Response Code --"));
     PRINTOUT(responseCode);
+    enterPhase(IOTPLOTTER_IDLE);
+
+    if (_metricsBody == nullptr) {
+        // The metrics post isn't counted in the metrics
+        _postMetrics.posts = 1;
+        _postMetrics.addResponse(responseCode);
+        _lastMetrics.add(_postMetrics);
+        _totalMetrics.add(_postMetrics);
+    }
+
+    if (_postChunked && (responseCode == 411 || responseCode == 501)) {
+        // This destination won't take a chunked body; send the same snapshot
+        // again, measured up front, as every later post to it will be
+        PRINTOUT(F("IoTPlotter refused a chunked body, using Content-Length"));
+        _refused[_mirror] |= IOTPLOTTER_REFUSED_CHUNKED;
+        _snapshotMillis = 0;
+        startPost(_postSamples);
+        return;
+    }
+    if (_gzip && responseCode == 415) {
+        // Likewise a compressed one
+        PRINTOUT(F("IoTPlotter refused a gzipped body, sending it as it is"));
+        _refused[_mirror] |= IOTPLOTTER_REFUSED_GZIP;
+        _snapshotMillis = 0;
+        startPost(_postSamples);
+        return;
+    }
+
+    if (_metricsBody != nullptr) {
+        _publishResult = responseCode;
+        return;
+    }
+
+    if (_mirror > 0) {
+        // A mirror that fails just misses out; the samples belong to the feed
+        if (responseCode < 200 || responseCode >= 300) {
+            PRINTOUT(F("IoTPlotter mirror"), postFeedID(), F("failed"));
+        }
+        if (startMirrorPost(_mirror)) return;
+        // Every mirror has had its turn; carry on from the feed's own post
+        _mirror      = 0;
+        responseCode = _feedResponse;
+    } else if (responseCode >= 200 && responseCode < 300 &&
+               startMirrorPost(0)) {
+        _feedResponse = responseCode;
+        return;
+    }
+
+    bool success = responseCode >= 200 && responseCode < 300;
+    if (success) {
+        _retry.recordSuccess();
+#if IOTPLOTTER_DEADBAND
+        if (!_draining) recordReported();
+#endif
+        // The same samples go on with the variables that didn't fit
+        if (startPagePost()) return;
+    } else {
+        // Honour a Retry-After, but not past a day
+        uint32_t retryAfter = _response.hasStatus() ? _response.retryAfter()
+                                                    : 0;
+        if (retryAfter > 86400L) retryAfter = 86400L;
+        bool retry = _retry.recordFailure(failureClass(responseCode), millis(),
+                                          retryAfter * 1000);
+        if (_retry.isOpen(millis())) {
+            PRINTOUT(F("Too many IoTPlotter failures, pausing for"),
+                     _retry.waitRemaining(millis()), F("ms"));
+        }
+        if (retry && !_draining &&
+            _retry.waitRemaining(millis()) <= IOTPLOTTER_MAX_RETRY_WAIT) {
+            // Send the same snapshot again, after a short backoff; a longer
+            // one is left to a later publish
+            PRINTOUT(F("Retrying IoTPlotter post in"),
+                     _retry.waitRemaining(millis()), F("ms"));
+            _postResponse = 0;
+            _postFailure  = IOTPLOTTER_NO_FAILURE;
+            _response.begin();
+            _postMetrics.clear();
+            enterPhase(IOTPLOTTER_BACKOFF);
+            return;
+        }
+    }
+    if (!_draining) {
+        _publishResult = responseCode;
+        if (!success) {
+            if (_queue != nullptr && isRetryable(responseCode)) {
+                // Move the samples out of RAM and onto the storage medium,
+                // where they survive a reset and wait for the connection to
+                // come back
+                queueSamples();
+            }
+            return;
+        }
+        // Only forget the cached samples once the portal has accepted all
+        // of their variables
+        dropSamples(_postSamples);
+        // If the snapshot couldn't hold all the cached samples, the rest go
+        // in another post, unless none of them changed enough to matter
+        if (_sampleCount > 0) {
+            beginPages();
+            if (startPagePost()) return;
+            clearSamples();
+        }
+        // The connection is good, so catch up on anything sent while it
+        // wasn't
+        if (_queue == nullptr) return;
+        _draining    = true;
+        _drainBudget = _maxDrainBytes;
+    } else if (_backfill != nullptr) {
+        // backfill() starts the next batch itself, once it has seen how this
+        // one went
+        _publishResult = responseCode;
+        clearSamples();
+        if (success) _backfill->commit(_drainEnd);
+        return;
+    } else {
+        clearSamples();
+        if (!success && isRetryable(responseCode)) {
+            // Leave the records on the queue for the next connection
+            return;
+        }
+        if (!success) {
+            // The portal will never take this batch, don't let it block the
+            // rest of the queue
+            PRINTOUT(F("IoTPlotter rejected queued samples, dropping them"));
+        }
+        uint32_t used = _drainEnd - _queue->readCursor();
+        _drainBudget  = used < _drainBudget ? _drainBudget - used : 0;
+        _queue->commit(_drainEnd);
+    }
+    startDrainPost();
+}
+
+
+// Zeroes the cumulative metrics
+void IoTPlotterPublisher::resetMetrics(void) {
+    _totalMetrics.clear();
+}
+
+
+// Prints the metrics in the same JSON layout as the data
+void IoTPlotterPublisher::printMetricsJSON(Stream* stream, bool total) {
+    IoTPlotterStreamSink sink(stream);
+    (total ? _totalMetrics : _lastMetrics)
+        .writeJson(sink, Logger::markedLocalEpochTime);
+}
+
+
+// Posts the metrics to their own feed
+int16_t IoTPlotterPublisher::publishMetrics(Client* outClient,
+                                            const char* feedID, bool total) {
+    if (isPublishing()) return 0;
+    _metricsBody    = total ? &_totalMetrics : &_lastMetrics;
+    _metricsFeedID  = feedID;
+    _metricsEpoch   = Logger::markedLocalEpochTime;
+    _postClient     = outClient;
+    _draining       = false;
+    _publishResult  = 0;
+    _snapshotMillis = 0;
+    startPost(0);
+    while (poll()) {
+        if (_postState == IOTPLOTTER_AWAIT_STATUS) delay(10);
+    }
+    _metricsBody = nullptr;
+    return _publishResult;
+}
+
+
+// Uploads the rows of a data file that haven't been sent yet
+int16_t IoTPlotterPublisher::backfill(Client* outClient,
+                                      IoTPlotterBackfill* source,
+                                      uint32_t            maxBytes) {
+    if (isPublishing() || _sampleCount > 0) {
+        PRINTOUT(F("IoTPlotter backfill must wait for the cached samples"));
+        return 0;
+    }
+    if (!_retry.canAttempt(millis())) {
+        MS_DBG(F("IoTPlotter backing off for another"),
+               _retry.waitRemaining(millis()), F("ms"));
+        return 0;
+    }
+
+    // Find each of the logger's variables among the file's columns; rows are
+    // read into the sample cache, so only the variables it holds are sent
+    uint8_t varCount = _baseLogger->getArrayVarCount();
+    if (varCount > IOTPLOTTER_MAX_VARIABLES) {
+        PRINTOUT(F("Only the first"), IOTPLOTTER_MAX_VARIABLES,
+                 F("of"), varCount, F("variables are backfilled to IoTPlotter"));
+        varCount = IOTPLOTTER_MAX_VARIABLES;
+    }
+    uint32_t codeHashes[IOTPLOTTER_MAX_VARIABLES];
+    for (uint8_t i = 0; i < varCount; i++) {
+        String varCode = _baseLogger->getVarCodeAtI(i);
+        codeHashes[i]  = IoTPlotterBackfill::hashText(varCode.c_str(),
+                                                     varCode.length());
+    }
+    source->mapColumns(codeHashes, varCount);
+
+    // Every batch goes down the same connection, however the publisher is
+    // usually set up
+    bool keepAlive = _keepAlive;
+    if (!keepAlive) setKeepAlive(true);
+    _postClient    = outClient;
+    _backfill      = source;
+    _draining      = true;
+    _mirror        = 0;
+    _publishResult = 0;
+    _lastMetrics.clear();
+
+    int16_t  result = 0;
+    uint32_t start  = source->readCursor();
+    while (maxBytes == 0 || source->readCursor() - start < maxBytes) {
+        uint32_t left = maxBytes == 0
+            ? 0
+            : maxBytes - (source->readCursor() - start);
+        if (!startBackfillPost(left)) break;
+        while (poll()) {
+            if (_postState == IOTPLOTTER_AWAIT_STATUS) delay(10);
+        }
+        result = _publishResult;
+        if (result < 200 || result >= 300) break;
+    }
+    MS_DBG(F("IoTPlotter backfill sent"), source->readCursor() - start,
+           F("bytes of the file"));
+
+    clearSamples();
+    _backfill = nullptr;
+    _draining = false;
+    if (!keepAlive) setKeepAlive(false);
+    return result;
+}
+
+
+// Loads the next rows of the backfill file and starts posting them; returns
+// false once there are no more complete rows
+bool IoTPlotterPublisher::startBackfillPost(uint32_t maxBytes) {
+    uint8_t varCount = _baseLogger->getArrayVarCount();
+    if (varCount > IOTPLOTTER_MAX_VARIABLES) varCount = IOTPLOTTER_MAX_VARIABLES;
+    uint32_t start    = _backfill->readCursor();
+    uint32_t offset   = start;
+    // Rows are read straight into the (empty) cache, noting where each ends
+    uint32_t rowEnds[IOTPLOTTER_MAX_BATCH];
+    clearSamples();
+    while (_sampleCount < IOTPLOTTER_MAX_BATCH) {
+        uint32_t next = _backfill->read(offset, _sampleEpochs[_sampleCount],
+                                        _sampleValues[_sampleCount], varCount);
+        if (next == 0) break;
+        // Always send at least one row, even if it busts the budget
+        if (_sampleCount > 0 && maxBytes > 0 && next - start > maxBytes) break;
+        offset                  = next;
+        rowEnds[_sampleCount++] = next;
+    }
+    if (_sampleCount == 0) return false;
+
+    beginPages();
+    if (!startPagePost()) {
+        // Not one of the variables fits, so no row ever will; they're left
+        // in the file
+        PRINTOUT(F("No IoTPlotter variables fit in the snapshot"));
+        clearSamples();
+        return false;
+    }
+    // Anything the snapshot couldn't hold is read again for the next post
+    _drainEnd = rowEnds[_postSamples - 1];
+    MS_DBG(F("Posting"), _postSamples, F("backfilled IoTPlotter samples"));
+    return true;
+}
+
+
+// Attach a persistent queue for samples that could not be published
+void IoTPlotterPublisher::setQueue(IoTPlotterQueue* queue,
+                                   uint16_t         maxDrainBytes) {
+    _queue         = queue;
+    _maxDrainBytes = maxDrainBytes;
+}
+
+
+// Whether a failed post is worth trying again later
+bool IoTPlotterPublisher::isRetryable(int16_t responseCode) {
+    // No connection, no response or a server side error; a 4xx means the
+    // portal looked at the request and refused it, and would again
+    return responseCode <= 0 || responseCode >= 500;
+}
+
+
+// Adds another feed or server to mirror the posts to
+bool IoTPlotterPublisher::addDestination(const char* feedID,
+                                         const char* apiKey,
+                                         const uint8_t* varMask,
+                                         const char* host, uint16_t port) {
+    if (_destinationCount >= IOTPLOTTER_MAX_DESTINATIONS) return false;
+    IoTPlotterDestination& destination = _destinations[_destinationCount++];
+    destination.host    = host;
+    destination.port    = port;
+    destination.feedID  = feedID;
+    destination.apiKey  = apiKey;
+    destination.varMask = varMask;
+    return true;
+}
 
-    return responseCode;
+
+// Starts posting the snapshot to the next mirror with something to send
+bool IoTPlotterPublisher::startMirrorPost(uint8_t first) {
+    for (uint8_t d = first; d < _destinationCount; d++) {
+        _mirror = d + 1;
+        // Don't post an empty body where none of the mirror's variables have
+        // moved past their deadbands
+        bool changed = _snapshot.varCount() == 0;
+        for (uint8_t i = 0; !changed && i < _snapshot.varCount(); i++) {
+            changed = IoTPlotterSerializer::isIncluded(_snapshot, postMask(), i);
+        }
+        if (!changed) continue;
+        MS_DBG(F("Mirroring IoTPlotter post to"), postFeedID());
+        startPost(_postSamples);
+        return true;
+    }
+    _mirror = 0;
+    return false;
+}
+
+
+// The target of the post in progress
+const char* IoTPlotterPublisher::postHost(void) {
+    const char* host = _mirror > 0 ? _destinations[_mirror - 1].host : nullptr;
+    return host != nullptr ? host : IoTPlotterHost;
+}
+uint16_t IoTPlotterPublisher::postPort(void) {
+    uint16_t port = _mirror > 0 ? _destinations[_mirror - 1].port : 0;
+    if (port > 0) return port;
+    return _tls != nullptr ? IOTPLOTTER_TLS_PORT : IoTPlotterPort;
+}
+const char* IoTPlotterPublisher::postFeedID(void) {
+    return _mirror > 0 ? _destinations[_mirror - 1].feedID : _feedID;
+}
+const char* IoTPlotterPublisher::postKey(void) {
+    return _mirror > 0 ? _destinations[_mirror - 1].apiKey
+                       : _registrationToken;
+}
+const uint8_t* IoTPlotterPublisher::postMask(void) {
+    return _mirror > 0 ? _destinations[_mirror - 1].varMask : nullptr;
+}
+
+
+// Sorts a failed post into the class that sets how it is retried
+uint8_t IoTPlotterPublisher::failureClass(int16_t responseCode) {
+    // A 504 made up here rather than sent by the server says what went wrong
+    if (_postFailure != IOTPLOTTER_NO_FAILURE) return _postFailure;
+    return IoTPlotterRetry::classify(responseCode);
+}
+
+
+// Moves the cached samples into the persistent queue
+void IoTPlotterPublisher::queueSamples(void) {
+    uint8_t varCount = reportedVarCount();
+    while (_sampleCount > 0) {
+        if (!_queue->push(_sampleEpochs[_sampleHead],
+                          _sampleValues[_sampleHead], varCount)) {
+            // Keep whatever couldn't be written in RAM
+            PRINTOUT(F("Unable to queue IoTPlotter sample"));
+            return;
+        }
+        _sampleHead = (_sampleHead + 1) % IOTPLOTTER_MAX_BATCH;
+        _sampleCount--;
+    }
+    MS_DBG(F("IoTPlotter samples queued for a later connection"));
+}
+
+
+// Loads the next batch from the persistent queue and starts posting it;
+// returns false once the queue is empty or the drain budget has run out
+bool IoTPlotterPublisher::startDrainPost(void) {
+    uint8_t varCount = reportedVarCount();
+    while (_drainBudget > 0 && !_queue->isEmpty()) {
+        uint32_t start  = _queue->readCursor();
+        uint32_t end    = _queue->endOffset();
+        uint32_t offset = start;
+        // Load the cache (which is empty after a successful post) straight
+        // from the queue, oldest record first, noting where each one ends
+        uint32_t recordEnds[IOTPLOTTER_MAX_BATCH];
+        clearSamples();
+        while (_sampleCount < IOTPLOTTER_MAX_BATCH && offset < end) {
+            uint8_t  recordVars = 0;
+            uint32_t next       = _queue->read(offset,
+                                               _sampleEpochs[_sampleCount],
+                                               _sampleValues[_sampleCount],
+                                               IOTPLOTTER_MAX_VARIABLES,
+                                               recordVars);
+            if (next == 0) {
+                // A damaged or torn record; carry on from the next intact one
+                uint32_t intact = _queue->resync(offset);
+                PRINTOUT(F("Skipping damaged IoTPlotter queue bytes"), offset,
+                         F("to"), intact);
+                offset = intact;
+                continue;
+            }
+            // Always send at least one record, even if it busts the budget
+            if (_sampleCount > 0 && next - start > _drainBudget) break;
+            offset = next;
+            // Records from a different variable arrangement can't be posted
+            if (recordVars == varCount) recordEnds[_sampleCount++] = next;
+        }
+
+        if (_sampleCount == 0) {
+            // Nothing postable in that stretch of the queue; skip over it
+            _queue->commit(offset);
+            continue;
+        }
+        uint8_t loaded = _sampleCount;
+        beginPages();
+        if (!startPagePost()) {
+            // Not one of the variables fits; these records never will
+            PRINTOUT(F("Skipping IoTPlotter queue records that don't fit"));
+            _queue->commit(offset);
+            continue;
+        }
+        // Anything the snapshot couldn't hold is read again next time
+        _drainEnd = _postSamples < loaded ? recordEnds[_postSamples - 1]
+                                          : offset;
+        MS_DBG(F("Posting"), _postSamples, F("queued IoTPlotter samples"));
+        return true;
+    }
+    clearSamples();
+    return false;
 }
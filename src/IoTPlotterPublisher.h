@@ -24,6 +24,205 @@
 #include "ModSensorDebugger.h"
 #undef MS_DEBUGGING_STD
 #include "dataPublisherBase.h"
+#include "IoTPlotterSerializer.h"
+#include "IoTPlotterResponse.h"
+#include "IoTPlotterMetrics.h"
+#include "IoTPlotterRetry.h"
+#include "IoTPlotterTls.h"
+#include "IoTPlotterDeflate.h"
+
+/**
+ * @brief The largest number of samples that can be cached and sent in a single
+ * POST when batching with sendEveryX.
+ *
+ * Each cached sample costs 4 bytes of RAM per variable plus 4 bytes for its
+ * timestamp.  Larger values of sendEveryX are clamped to this.
+ */
+#ifndef IOTPLOTTER_MAX_BATCH
+#define IOTPLOTTER_MAX_BATCH 5
+#endif
+
+/**
+ * @brief The largest number of variables that can be cached per sample when
+ * batching.
+ *
+ * Variables beyond this are left out of batched posts.  It does not limit
+ * unbatched (sendEveryX = 1) posts.
+ */
+#ifndef IOTPLOTTER_MAX_VARIABLES
+#define IOTPLOTTER_MAX_VARIABLES 20
+#endif
+
+/**
+ * @brief The number of variables whose decimal places are kept, learned from
+ * the logger once or set with IoTPlotterPublisher::setPrecision().
+ *
+ * Each takes half a byte of RAM.  Any variable past these is published with
+ * #IOTPLOTTER_DEFAULT_DECIMALS places rather than asking the logger, which
+ * would cost a String on every publish.
+ */
+#ifndef IOTPLOTTER_MAX_PRECISIONS
+#define IOTPLOTTER_MAX_PRECISIONS (2 * IOTPLOTTER_MAX_VARIABLES)
+#endif
+
+/**
+ * @brief The decimal places of a variable past #IOTPLOTTER_MAX_PRECISIONS.
+ */
+#ifndef IOTPLOTTER_DEFAULT_DECIMALS
+#define IOTPLOTTER_DEFAULT_DECIMALS 2
+#endif
+
+/**
+ * @brief The default limit on how many bytes of queued records are sent each
+ * time the queue is drained.
+ */
+#ifndef IOTPLOTTER_QUEUE_DRAIN_BYTES
+#define IOTPLOTTER_QUEUE_DRAIN_BYTES 2048
+#endif
+
+/**
+ * @brief The default time allowed for connecting to the server, in ms.
+ *
+ * Client::connect() blocks for as long as the client's own timeout.  If it
+ * fails, the connection is tried again on each call to
+ * IoTPlotterPublisher::poll() until this much time has passed; the default of
+ * 0 gives a single attempt.
+ */
+#ifndef IOTPLOTTER_CONNECT_TIMEOUT
+#define IOTPLOTTER_CONNECT_TIMEOUT 0L
+#endif
+/**
+ * @brief The default time allowed for sending the request, in ms.
+ */
+#ifndef IOTPLOTTER_SEND_TIMEOUT
+#define IOTPLOTTER_SEND_TIMEOUT 30000L
+#endif
+/**
+ * @brief The default time allowed between sending the request and receiving
+ * the response status line, in ms.
+ */
+#ifndef IOTPLOTTER_STATUS_TIMEOUT
+#define IOTPLOTTER_STATUS_TIMEOUT 10000L
+#endif
+/**
+ * @brief The longest a publish waits to retry a failed post, in ms.
+ *
+ * A backoff any longer isn't sat out inside publishData() or poll(): the
+ * publish ends with the failure and a later publish tries again once the
+ * backoff has passed.
+ */
+#ifndef IOTPLOTTER_MAX_RETRY_WAIT
+#define IOTPLOTTER_MAX_RETRY_WAIT 5000L
+#endif
+
+/**
+ * @brief The default number of bytes sent to the client in each write.
+ *
+ * 0 sends a whole tx buffer at a time.  Set it (or call
+ * IoTPlotterPublisher::setMtu()) to the modem's MTU or the most its send
+ * command takes at once, so each write is one packet or one AT command.
+ */
+#ifndef IOTPLOTTER_MTU
+#define IOTPLOTTER_MTU 0
+#endif
+
+/**
+ * @brief The number of bytes of RAM each publisher sets aside to cache the
+ * request headers that stay the same from post to post.
+ *
+ * The block holds the request line (with the feed ID) and the Connection,
+ * api-key, Content-Type and Host headers.  If it doesn't fit, the headers
+ * are written out piece by piece for every post instead.  On AVR boards and
+ * in #IOTPLOTTER_LOW_MEMORY mode the default is 0, for no cache at all.
+ */
+#ifndef IOTPLOTTER_HEADER_CACHE_SIZE
+#if defined(IOTPLOTTER_LOW_MEMORY) || defined(__AVR__)
+#define IOTPLOTTER_HEADER_CACHE_SIZE 0
+#else
+#define IOTPLOTTER_HEADER_CACHE_SIZE 256
+#endif
+#endif
+
+/**
+ * @brief Set to 0 to build without change-only publishing (see
+ * IoTPlotterPublisher::setDeadband()), saving the 13 bytes of RAM per
+ * variable (for #IOTPLOTTER_MAX_VARIABLES variables) it keeps.
+ *
+ * It is left out by default on AVR boards.
+ */
+#ifndef IOTPLOTTER_DEADBAND
+#if defined(__AVR__)
+#define IOTPLOTTER_DEADBAND 0
+#else
+#define IOTPLOTTER_DEADBAND 1
+#endif
+#endif
+
+/**
+ * @brief The largest number of extra destinations each publisher can mirror
+ * its posts to, besides its own feed.
+ */
+#ifndef IOTPLOTTER_MAX_DESTINATIONS
+#define IOTPLOTTER_MAX_DESTINATIONS 2
+#endif
+
+/**
+ * @brief The smallest body that is gzipped once compression is turned on;
+ * below this the header and trailer cost more than compression saves.
+ */
+#ifndef IOTPLOTTER_COMPRESS_MIN_BODY
+#define IOTPLOTTER_COMPRESS_MIN_BODY 256
+#endif
+
+/**
+ * @brief Build the complete, fixed request header block at compile time, for
+ * use with IoTPlotterPublisher::setRequestHeader().
+ *
+ * All three arguments must be string literals, for example
+ * `IOTPLOTTER_REQUEST_HEADER("123456789012", "abcdef...", "Close")`.
+ *
+ * @param feedID The IoTPlotter.com feed ID
+ * @param apiKey The API key for the feed
+ * @param connection The value of the Connection header: "Close", or
+ * "keep-alive" if keep-alive is turned on
+ */
+#define IOTPLOTTER_REQUEST_HEADER(feedID, apiKey, connection)               \
+    "POST http://" IOTPLOTTER_HOST IOTPLOTTER_POST_ENDPOINT feedID           \
+    " HTTP/1.1\r\nConnection: " connection IOTPLOTTER_API_HEADER apiKey      \
+        IOTPLOTTER_CONTENT_TYPE_HEADER "\r\nHost: " IOTPLOTTER_HOST
+
+/**
+ * @brief The same as #IOTPLOTTER_REQUEST_HEADER, for posting over TLS with
+ * IoTPlotterPublisher::setTls().
+ */
+#define IOTPLOTTER_TLS_REQUEST_HEADER(feedID, apiKey, connection)           \
+    "POST https://" IOTPLOTTER_HOST IOTPLOTTER_POST_ENDPOINT feedID          \
+    " HTTP/1.1\r\nConnection: " connection IOTPLOTTER_API_HEADER apiKey      \
+        IOTPLOTTER_CONTENT_TYPE_HEADER "\r\nHost: " IOTPLOTTER_HOST
+
+class IoTPlotterBackfill;
+class IoTPlotterQueue;
+class IoTPlotterStore;
+
+/**
+ * @brief An extra feed or server that an IoTPlotterPublisher mirrors its
+ * posts to.
+ */
+typedef struct IoTPlotterDestination {
+    /** @brief The server's host name; nullptr for iotplotter.com */
+    const char* host;
+    /** @brief The server's port; 0 for port 80 */
+    uint16_t port;
+    /** @brief The feed ID in the request path */
+    const char* feedID;
+    /** @brief The value of the api-key header */
+    const char* apiKey;
+    /**
+     * @brief One bit per variable to post, the lowest bit of the first byte
+     * for the first variable; nullptr for every variable
+     */
+    const uint8_t* varMask;
+} IoTPlotterDestination;
 
 
 // ============================================================================
@@ -51,8 +250,8 @@ class IoTPlotterPublisher : public dataPublisher {
      * logger.
      *
      * @param baseLogger The logger supplying the data to be published
-     * @param sendEveryX Currently unimplemented, intended for future use to
-     * enable caching and bulk publishing
+     * @param sendEveryX The number of samples to cache and send together in
+     * a single POST; clamped to #IOTPLOTTER_MAX_BATCH
      * @param sendOffset Currently unimplemented, intended for future use to
      * enable publishing data at a time slightly delayed from when it is
      * collected
@@ -72,8 +271,8 @@ class IoTPlotterPublisher : public dataPublisher {
      * @param inClient An Arduino client instance to use to print data to.
      * Allows the use of any type of client and multiple clients tied to a
      * single TinyGSM modem instance
-     * @param sendEveryX Currently unimplemented, intended for future use to
-     * enable caching and bulk publishing
+     * @param sendEveryX The number of samples to cache and send together in
+     * a single POST; clamped to #IOTPLOTTER_MAX_BATCH
      * @param sendOffset Currently unimplemented, intended for future use to
      * enable publishing data at a time slightly delayed from when it is
      * collected
@@ -94,8 +293,8 @@ class IoTPlotterPublisher : public dataPublisher {
      * IoTPlotter.com data portal. Akin to the EnvironDIY registrationToken on MMW
      * @param feedID The feed ID for the site on the
      * IoTPlotter.com data portal. Akin to samplingFeatureUUID from MMW
-     * @param sendEveryX Currently unimplemented, intended for future use to
-     * enable caching and bulk publishing
+     * @param sendEveryX The number of samples to cache and send together in
+     * a single POST; clamped to #IOTPLOTTER_MAX_BATCH
      * @param sendOffset Currently unimplemented, intended for future use to
      * enable publishing data at a time slightly delayed from when it is
      * collected
@@ -114,8 +313,8 @@ class IoTPlotterPublisher : public dataPublisher {
      * IoTPlotter.com data portal. Akin to the EnvironDIY registrationToken on MMW
      * @param feedID The feed ID for the site on the
      * IoTPlotter.com data portal. Akin to samplingFeatureUUID from MMW
-     * @param sendEveryX Currently unimplemented, intended for future use to
-     * enable caching and bulk publishing
+     * @param sendEveryX The number of samples to cache and send together in
+     * a single POST; clamped to #IOTPLOTTER_MAX_BATCH
      * @param sendOffset Currently unimplemented, intended for future use to
      * enable publishing data at a time slightly delayed from when it is
      * collected
@@ -152,9 +351,29 @@ class IoTPlotterPublisher : public dataPublisher {
      */
     void setFeedID(const char* feedID);
 
+    /**
+     * @brief Use a request header block built at compile time.
+     *
+     * Normally the headers that stay the same from post to post are rendered
+     * into a RAM cache whenever the feed ID, API key or keep-alive setting
+     * changes.  When those are known at build time, the whole block can
+     * instead be a string literal made with #IOTPLOTTER_REQUEST_HEADER, and
+     * nothing is rendered at run time at all.
+     *
+     * @param header The header block, or nullptr to go back to rendering it
+     * from the feed ID and API key.  It must stay valid for the life of the
+     * publisher and must match the keep-alive setting.
+     */
+    void setRequestHeader(const char* header);
+
     /**
      * @brief Calculates how long the outgoing JSON will be
      *
+     * When batching, this is the exact size of the JSON carrying every cached
+     * sample; with nothing cached it is the size for the logger's current
+     * values.  While a publish is in progress, it is the size for the
+     * snapshot being posted.
+     *
      * @return uint16_t The number of characters in the JSON object.
      */
     uint16_t calculateJsonSize();
@@ -171,6 +390,8 @@ class IoTPlotterPublisher : public dataPublisher {
      * @brief This generates a properly formatted JSON for EnviroDIY and prints
      * it to the input Arduino stream object.
      *
+     * While a publish is in progress, this prints the snapshot being posted.
+     *
      * @param stream The Arduino stream to write out the JSON to.
      */
     void printSensorDataJSON(Stream* stream);
@@ -178,6 +399,8 @@ class IoTPlotterPublisher : public dataPublisher {
     /**
      * @brief This prints a fully structured post request for IoTPlotter to the specified stream.
      *
+     * Nothing is printed while a publish is in progress.
+     *
      * @param stream The Arduino stream to write out the request to.
      */
     void printIoTPlotterRequest(Stream* stream);
@@ -202,6 +425,459 @@ class IoTPlotterPublisher : public dataPublisher {
     void begin(Logger& baseLogger, const char* apiKey,
                const char* feedID);
 
+    /**
+     * @brief Attach a persistent queue to hold samples that could not be
+     * published.
+     *
+     * When a post fails without the portal refusing it (no connection, no
+     * response or a 5xx) the samples are written to the queue instead of
+     * being dropped.  After the next successful post the queue is drained in
+     * batches of up to #IOTPLOTTER_MAX_BATCH samples.
+     *
+     * Attaching a queue also routes every sample through the sample cache,
+     * so only the first #IOTPLOTTER_MAX_VARIABLES variables are reported.
+     *
+     * @param queue The queue, or nullptr to stop queuing.  It must already
+     * have been started with IoTPlotterQueue::begin().
+     * @param maxDrainBytes The most bytes of queued records to send after
+     * each successful post, so that a long backlog can't hold the radio on
+     * indefinitely.  At least one record is always sent.
+     */
+    void setQueue(IoTPlotterQueue* queue,
+                  uint16_t maxDrainBytes = IOTPLOTTER_QUEUE_DRAIN_BYTES);
+
+    /**
+     * @brief Mirror every post to another feed or server as well.
+     *
+     * Each snapshot is formatted once and the same text is posted to every
+     * destination.  A mirror is posted to straight after the publisher's own
+     * feed accepts the data - including batches drained from the queue - so
+     * it sees exactly what the feed does, once.  Failures at a mirror are
+     * reported and counted in the metrics, but the samples are neither
+     * retried nor queued for it.
+     *
+     * Posts to the same host and port as the one before go over the same
+     * connection when keep-alive is on; otherwise they go out back-to-back
+     * on a new connection.  Destinations that share a mask array also share
+     * the measured body length.  The mirrors use the feed's batching,
+     * deadbands and body format, and do not change the logger's sampling
+     * feature.
+     *
+     * @param feedID The feed ID to post to
+     * @param apiKey The API key for that feed
+     * @param varMask One bit per variable to post to this destination, the
+     * lowest bit of the first byte for the first variable; nullptr for every
+     * variable.  The array must stay valid and cover every variable.
+     * @param host The server's host name; nullptr for iotplotter.com
+     * @param port The server's port; 0 for port 80
+     * @return **bool** False if there are already
+     * #IOTPLOTTER_MAX_DESTINATIONS mirrors
+     */
+    bool addDestination(const char* feedID, const char* apiKey,
+                        const uint8_t* varMask = nullptr,
+                        const char* host = nullptr, uint16_t port = 0);
+    /**
+     * @brief Stop mirroring posts to any other destination
+     */
+    void clearDestinations(void) {
+        _destinationCount = 0;
+    }
+    /**
+     * @brief Get the number of destinations posts are mirrored to
+     *
+     * @return **uint8_t** The number of mirrors added with addDestination()
+     */
+    uint8_t getDestinationCount(void) {
+        return _destinationCount;
+    }
+
+    /**
+     * @brief Set the number of decimal places a variable is published with.
+     *
+     * Values are formatted by the publisher itself, without any String or
+     * heap use.  Unless set here, each variable's places are learned from
+     * the logger's own formatting the first time it is published, so the
+     * text matches what the logger writes to its SD card.
+     *
+     * Only the first #IOTPLOTTER_MAX_PRECISIONS variables' places are kept;
+     * the rest are always published with #IOTPLOTTER_DEFAULT_DECIMALS.
+     *
+     * @param varNum The position of the variable in the logger's variable
+     * array; only the first #IOTPLOTTER_MAX_PRECISIONS can be set
+     * @param decimals The number of decimal places, at most
+     * #IOTPLOTTER_MAX_DECIMALS
+     */
+    void setPrecision(uint8_t varNum, uint8_t decimals);
+
+    /**
+     * @brief Only publish a variable when its value has changed by more than
+     * a threshold since it was last published.
+     *
+     * A variable whose values in a post are all within the threshold of the
+     * value last accepted by the portal is left out of the JSON entirely,
+     * unless it has been left out for longer than the maximum silence set
+     * with setMaxSilence().  The Content-Length is measured from the same
+     * filtered JSON.  If nothing in a publish has changed, no post is made
+     * at all.
+     *
+     * Samples sent from the persistent queue are never filtered.  This does
+     * nothing (other than say so) unless #IOTPLOTTER_DEADBAND is set.
+     *
+     * @param varNum The position of the variable in the logger's variable
+     * array; only the first #IOTPLOTTER_MAX_VARIABLES can be filtered
+     * @param threshold The change needed to publish; 0 publishes on any
+     * change at all, and a negative threshold turns filtering off again
+     */
+    void setDeadband(uint8_t varNum, float threshold);
+    /**
+     * @brief Set the longest a filtered variable may go unpublished
+     *
+     * @param seconds The most seconds between publishes of a variable with a
+     * deadband, however little it changes; 0 for no limit
+     */
+    void setMaxSilence(uint32_t seconds) {
+#if IOTPLOTTER_DEADBAND
+        _maxSilence = seconds;
+#else
+        (void)seconds;
+#endif
+    }
+
+    /**
+     * @brief Start publishing without waiting for it to finish.
+     *
+     * This does the same work as publishData(Client* outClient), but only
+     * the first step happens here.  Each later call to poll() takes the next
+     * step (connecting, sending a buffer-full of the request, reading what
+     * has arrived of the response, closing) and returns straight away, so the
+     * logger can keep sampling and serve other publishers in between.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * It must stay valid until poll() returns false.
+     * @return **bool** True if a publish was started; false if the sample was
+     * cached for a later batch, put on the queue while the retry scheduler
+     * is backing off, or a publish is already in progress.
+     */
+    bool startPublish(Client* outClient);
+    /**
+     * @brief Take the next step of a publish started with startPublish().
+     *
+     * @return **bool** True while the publish is still in progress
+     */
+    bool poll(void);
+    /**
+     * @brief Check whether a publish is in progress
+     *
+     * @return **bool** True between startPublish() and the end of the publish
+     */
+    bool isPublishing(void) {
+        return _postState != IOTPLOTTER_IDLE;
+    }
+    /**
+     * @brief Get the outcome of the last publish
+     *
+     * @return **int16_t** The http status code of the response to the post
+     * of the new samples, 504 if there was no connection or response, or
+     * 413 if not one of the variables fits in the snapshot
+     */
+    int16_t getPublishResult(void) {
+        return _publishResult;
+    }
+    /**
+     * @brief Set how long each phase of a post may take.
+     *
+     * Running out of time connecting, sending or waiting for the status line
+     * ends the post with a 504.
+     *
+     * @param connectTimeout The time allowed to connect, in ms; see
+     * #IOTPLOTTER_CONNECT_TIMEOUT
+     * @param sendTimeout The time allowed to send the request, in ms
+     * @param statusTimeout The time allowed between sending the request and
+     * receiving the status line, in ms
+     */
+    void setPhaseTimeouts(uint32_t connectTimeout, uint32_t sendTimeout,
+                          uint32_t statusTimeout);
+
+    /**
+     * @brief Turn persistent (keep-alive) connections on or off.
+     *
+     * With keep-alive on, each post asks the server to keep the connection
+     * open, the whole response (including its body) is read so the
+     * connection stays in step, and the next post goes out over the same
+     * connection instead of paying for a new TCP handshake.  If the server or
+     * the modem has closed the connection in the meantime, a new one is made
+     * and the post is sent again.
+     *
+     * Posts are not pipelined: HTTP clients should not pipeline POSTs, since
+     * they can't safely be replayed if the connection drops part way.
+     *
+     * @note The client must not be shared with another publisher while a
+     * connection is being kept open, as that publisher's connect() would take
+     * it over.
+     *
+     * @param keepAlive True to keep connections open between posts
+     */
+    void setKeepAlive(bool keepAlive);
+
+    /**
+     * @brief Post over TLS (HTTPS), resuming sessions from one connection to
+     * the next.
+     *
+     * The client given to the publisher must then be a TLS client, and the
+     * adapter the glue that saves and restores that client's sessions; see
+     * IoTPlotterTlsAdapter.  Posts go to port #IOTPLOTTER_TLS_PORT unless a
+     * destination sets its own port, and every destination is reached over
+     * TLS.  The API key no longer crosses the network in the clear.
+     *
+     * The first connection to each server makes a full handshake; later ones
+     * offer its session back and, if the server still has it, only make an
+     * abbreviated one.  Keep-alive saves even that, while the connection
+     * lasts.  The handshakes are counted in the metrics, full and resumed
+     * apart.
+     *
+     * A header block given to setRequestHeader() must then be made with
+     * #IOTPLOTTER_TLS_REQUEST_HEADER.
+     *
+     * @param tls The adapter for the TLS client, or nullptr to go back to
+     * plain HTTP
+     */
+    void setTls(IoTPlotterTlsAdapter* tls);
+
+    /**
+     * @brief Send the body with `Transfer-Encoding: chunked` instead of a
+     * Content-Length.
+     *
+     * Without it, the whole body is laid out once just to count it before
+     * any of it can be sent.  In chunked mode the body is never counted: each
+     * poll() sends the next buffer-full as one chunk, so the memory doesn't
+     * grow with the number of variables or batched samples, and a slow client
+     * is held to the send timeout like any other.
+     *
+     * If a destination answers a chunked post with 411 (Length Required) or
+     * 501 (Not Implemented), the post is sent again with a Content-Length,
+     * and so are later posts to that destination.  The others still get
+     * chunked bodies.
+     *
+     * printIoTPlotterRequest() always shows the Content-Length form.
+     *
+     * @param chunked True to send chunked bodies
+     */
+    void setChunked(bool chunked) {
+        _chunked = chunked;
+    }
+
+    /**
+     * @brief Post the data as CSV instead of JSON.
+     *
+     * The CSV body is a header row of the var codes and a row per sample, see
+     * IoTPlotterSerializer::writeCsv(), posted to the feed's `.csv` endpoint.
+     * It's laid out from the same snapshot as the JSON, so deadbands and the
+     * Content-Length work the same way.  printSensorDataJSON(),
+     * calculateJsonSize() and publishMetrics() always use JSON.
+     *
+     * A header block given to setRequestHeader() must match; with
+     * #IOTPLOTTER_REQUEST_HEADER, add the suffix to the feed ID, for example
+     * `IOTPLOTTER_REQUEST_HEADER("123456789012" ".csv", ...)`.
+     *
+     * @param csv True to post CSV
+     */
+    void setCsvPayload(bool csv);
+
+    /**
+     * @brief Gzip the body of each post, sending it with
+     * `Content-Encoding: gzip`.
+     *
+     * The body is compressed as it's laid out, on its way to the client, so
+     * it works the same with chunked mode, pre-rendering and the mtu; see
+     * IoTPlotterDeflate for the memory it takes.  A body shorter than the
+     * minimum is sent as it is, as is one that compression doesn't make any
+     * shorter.  In chunked mode that last check is skipped, so the body is
+     * still laid out in a single pass.
+     *
+     * Compression takes more time to lay out each request, which is counted
+     * in IoTPlotterMetrics::serializeMs, for fewer bytes sent.  Batched and
+     * drained posts, with the same var codes and near identical epochs over
+     * and over, shrink the most.  The metrics post itself is never
+     * compressed.
+     *
+     * If a destination answers a compressed post with 415 (Unsupported Media
+     * Type), the post is sent again as it is, and so are later posts to that
+     * destination.  The others are still compressed.
+     *
+     * printIoTPlotterRequest() always shows the body uncompressed.
+     *
+     * @param deflate The compressor, which must stay valid while the
+     * publisher is in use, or nullptr to stop compressing.  It keeps its
+     * place in the body between polls, so it may only be shared with
+     * publishers that never post at the same time.
+     * @param minBodyLength The smallest body to compress
+     */
+    void setCompression(IoTPlotterDeflate* deflate,
+                        uint16_t minBodyLength = IOTPLOTTER_COMPRESS_MIN_BODY);
+
+    /**
+     * @brief Set the number of bytes sent to the client in each write.
+     *
+     * Every write except the last of a request is exactly this long, so
+     * writes line up with the modem's packets or send commands instead of
+     * being split at odd sizes.  A run of request text that covers a whole
+     * write is sent from where it is, without being copied into the tx
+     * buffer.
+     *
+     * @param mtu The bytes per write; 0, or anything larger than the tx
+     * buffer, for a whole tx buffer at a time
+     */
+    void setMtu(uint16_t mtu) {
+        _mtu = mtu;
+    }
+
+    /**
+     * @brief Lay out each request in full before connecting.
+     *
+     * Normally the request is laid out a buffer-full at a time while the
+     * connection is open, so that time on a slow processor is also time the
+     * radio is on and the connection held.  With a pre-render buffer, the
+     * whole request is laid out into it first, and the connected phase just
+     * sends it.  A request too big for the buffer goes to the spill store
+     * instead (the buffer is then used to stage it), and one too big for
+     * both is laid out while connected as usual.
+     *
+     * Pre-rendered requests always carry a Content-Length, since their
+     * length is known; chunked mode only applies to the rest.  The time
+     * saved is reported as IoTPlotterMetrics::prerenderMs.
+     *
+     * @param buffer The buffer, which must stay valid while the publisher
+     * is in use, or nullptr to stop pre-rendering
+     * @param size The size of the buffer
+     * @param spill A store to hold requests too big for the buffer, such as
+     * an IoTPlotterSdStore on its own file; optional.  It is emptied before
+     * each use.
+     */
+    void setPrerender(char* buffer, uint16_t size,
+                      IoTPlotterStore* spill = nullptr);
+    /**
+     * @brief Close a connection left open by keep-alive, for example before
+     * the modem is turned off
+     */
+    void closeConnection(void);
+    /**
+     * @brief Get the number of new connections made
+     *
+     * @return **uint16_t** The number of successful calls to connect()
+     */
+    uint16_t getConnectionsOpened(void) {
+        return _connectionsOpened;
+    }
+    /**
+     * @brief Get the number of posts sent over a kept-alive connection
+     *
+     * @return **uint16_t** The number of times a connection was reused
+     */
+    uint16_t getConnectionsReused(void) {
+        return _connectionsReused;
+    }
+    /**
+     * @brief Get the number of posts that had to be sent again because a
+     * kept-alive connection had been closed
+     *
+     * @return **uint16_t** The number of reconnects
+     */
+    uint16_t getReconnects(void) {
+        return _reconnects;
+    }
+
+    /**
+     * @brief Get the scheduler that spaces out retries after failed posts.
+     *
+     * Use it to change the backoff policy for each class of failure or the
+     * circuit breaker, which is off unless turned on with
+     * IoTPlotterRetry::setCircuitBreaker().  A failed post is only tried
+     * again within the same publish when its backoff is no longer than
+     * #IOTPLOTTER_MAX_RETRY_WAIT.  While the scheduler is backing
+     * off (or the breaker is open), publishes with a queue attached don't
+     * connect at all and the samples go to the queue; without a queue they
+     * are posted anyway rather than lost.
+     *
+     * @return **IoTPlotterRetry&** The retry scheduler
+     */
+    IoTPlotterRetry& getRetryScheduler(void) {
+        return _retry;
+    }
+
+    /**
+     * @brief Get the timings, byte counts and response codes of the most
+     * recent publish, including any queue drain and overflow posts
+     *
+     * @return **const IoTPlotterMetrics&** The metrics of the last publish
+     */
+    const IoTPlotterMetrics& getLastMetrics(void) {
+        return _lastMetrics;
+    }
+    /**
+     * @brief Get the timings, byte counts and response codes of every post
+     * since the publisher was created or resetMetrics() was called
+     *
+     * @return **const IoTPlotterMetrics&** The cumulative metrics
+     */
+    const IoTPlotterMetrics& getTotalMetrics(void) {
+        return _totalMetrics;
+    }
+    /**
+     * @brief Zero the cumulative metrics
+     */
+    void resetMetrics(void);
+    /**
+     * @brief Print the metrics as an IoTPlotter JSON body, one graph per
+     * metric
+     *
+     * @param stream The stream to print to
+     * @param total True for the cumulative metrics, false for the last
+     * publish
+     */
+    void printMetricsJSON(Stream* stream, bool total = true);
+    /**
+     * @brief Post the metrics to an IoTPlotter feed of their own.
+     *
+     * This uses the same API key and keep-alive setting as the data, and
+     * blocks until the post is done.  Posting the metrics does not itself
+     * add to them.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * @param feedID The IoTPlotter.com feed ID to post the metrics to
+     * @param total True for the cumulative metrics, false for the last
+     * publish
+     * @return **int16_t** The http status code of the response
+     */
+    int16_t publishMetrics(Client* outClient, const char* feedID,
+                           bool total = true);
+    /**
+     * @brief Upload the rows of a logger data file that the portal hasn't
+     * yet been sent.
+     *
+     * This is for catching a feed up on data logged before it was set up, or
+     * while the logger had no connection and no queue.  The file is read a
+     * row at a time from the backfill's read cursor, and the rows are posted
+     * in batches as large as the sample cache and the snapshot allow, all
+     * down one kept-alive connection.  The cursor is checkpointed after
+     * every batch the portal accepts, so an interrupted backfill carries on
+     * from there the next time.  Deadbands don't apply; every row is sent.
+     *
+     * Rows are uploaded to the feed (and any mirrors) with the logger's
+     * current variables, matched to the file's columns by var code.  This
+     * blocks until the file is done, a post fails or the byte budget runs
+     * out, and must not be called while samples are waiting in the cache.
+     *
+     * @param outClient An Arduino client instance to use to print data to.
+     * @param source The data file to upload; begin() must already have been
+     * called on it
+     * @param maxBytes The most bytes of the file to upload in this call; 0
+     * for no limit
+     * @return **int16_t** The http status code of the last post, or 0 if
+     * nothing was posted
+     */
+    int16_t backfill(Client* outClient, IoTPlotterBackfill* source,
+                     uint32_t maxBytes = 0);
+
     // int16_t postDataEnviroDIY(void);
     /**
      * @brief Utilize an attached modem to open a a TCP connection to the
@@ -211,10 +887,29 @@ class IoTPlotterPublisher : public dataPublisher {
      * This depends on an internet connection already having been made and a
      * client being available.
      *
+     * When sendEveryX is more than 1, the logger's current values are cached
+     * and nothing is sent until sendEveryX samples are waiting.  Those are
+     * then sent together, each graph carrying one value/epoch pair per
+     * sample.  Samples are only dropped from the cache once the portal has
+     * accepted them; if the cache overflows the oldest are overwritten.
+     *
+     * If a queue has been attached with setQueue(), retryable failures move
+     * the cached samples to the queue and successes are followed by posting
+     * what is waiting in the queue.
+     *
+     * This blocks until the publish is finished; see startPublish() and
+     * poll() to publish in the background.
+     *
+     * When the variables don't all fit in the snapshot, they are posted in
+     * several requests carrying the same samples; the first to fail ends the
+     * publish with its status code.
+     *
      * @param outClient An Arduino client instance to use to print data to.
      * Allows the use of any type of client and multiple clients tied to a
      * single TinyGSM modem instance
-     * @return **int16_t** The http status code of the response.
+     * @return **int16_t** The http status code of the response, 0 if the
+     * sample was cached for a later batch or queued, or 413 if not one of
+     * the variables fits in the snapshot.
      */
     int16_t publishData(Client* outClient) override;
 
@@ -225,31 +920,460 @@ class IoTPlotterPublisher : public dataPublisher {
      *
      * @{
      */
-    static const char* postEndpoint;   ///< The endpoint
-    static const char* IoTPlotterHost;  ///< The host name
-    static const int   IoTPlotterPort;  ///< The host port // LPM: Not needed? 
-    static const char* apiHeader;    ///< The token header text
+    static IoTPlotterText postEndpoint;   ///< The endpoint
+    static const char*    IoTPlotterHost;  ///< The host name, in RAM for connect()
+    static const int      IoTPlotterPort;  ///< The host port // LPM: Not needed? 
+    static IoTPlotterText apiHeader;    ///< The token header text
     // static const char *cacheHeader;  ///< The cache header text
     // static const char *connectionHeader;  ///< The keep alive header text
-    static const char* contentLengthHeader;  ///< The content length header text
-    static const char* contentTypeHeader;    ///< The content type header text
+    static IoTPlotterText contentLengthHeader;  ///< The content length header text
+    static IoTPlotterText contentTypeHeader;    ///< The content type header text
     /**@}*/
 
     /**
-     * @anchor envirodiy_json_vars
-     * @name Portions of the JSON object for IoTPlotter.com
+     * @brief Get the number of samples to send together in each POST
+     *
+     * @return **uint8_t** sendEveryX clamped to 1 - #IOTPLOTTER_MAX_BATCH
+     */
+    uint8_t batchSize(void);
+    /**
+     * @brief Check whether samples are read from the sample cache rather than
+     * straight from the logger
+     *
+     * @return **bool** True when batching or queuing
+     */
+    bool usesSampleCache(void);
+    /**
+     * @brief Get the number of variables reported in each sample
+     *
+     * @return **uint8_t** The number of variables
+     */
+    uint8_t reportedVarCount(void);
+    /**
+     * @brief Copy the logger's current values and timestamp into the sample
+     * cache, overwriting the oldest sample if the cache is full
+     */
+    void cacheSample(void);
+    /**
+     * @brief Empty the sample cache
+     */
+    void clearSamples(void);
+    /**
+     * @brief Forget the oldest cached samples
+     *
+     * @param count The number of samples to forget
+     */
+    void dropSamples(uint8_t count);
+    /**
+     * @brief Copy the text of the pending samples into the snapshot, for as
+     * many of a run of variables as fit
+     *
+     * Each value is formatted once, here.  With nothing cached, the logger's
+     * current values are used.  The var codes are kept from the last
+     * snapshot when it started at the same variable.
+     *
+     * @param firstVar The position in the logger's variable array of the
+     * first variable
+     * @param maxVars The most variables to take
+     * @param samples The number of samples every variable must carry, as
+     * for the variables already posted; 0 to take as many of the pending
+     * samples as fit
+     * @return **uint8_t** The number of samples in the snapshot; 0 if not
+     * even the first variable fits
+     */
+    uint8_t takeSnapshot(uint8_t firstVar, uint8_t maxVars, uint8_t samples);
+    /**
+     * @brief Take a snapshot of the first variables that fit, as for
+     * printing
+     *
+     * @return **uint8_t** The number of samples in the snapshot
+     */
+    uint8_t takeSnapshot(void) {
+        return takeSnapshot(0, reportedVarCount(), 0);
+    }
+    /**
+     * @brief Copy a piece of one of the logger's var codes, for var codes
+     * too long to be held in the snapshot; see IoTPlotterCodeSource
+     */
+    static size_t copyVarCode(void* context, uint8_t position, size_t offset,
+                              char* buffer, size_t length);
+    /**
+     * @brief Start going through the variables for the pending samples,
+     * beginning with those whose var codes are still in the snapshot
+     */
+    void beginPages(void);
+    /**
+     * @brief Snapshot the next run of variables with something to post and
+     * start posting it
+     *
+     * Variables that can't fit even on their own are left out, with a
+     * message.
+     *
+     * @return **bool** False once every variable has been covered
+     */
+    bool startPagePost(void);
+    /**
+     * @brief Get a value of a sample about to be put in the snapshot
+     *
+     * @param sample The sample number, oldest first
+     * @param varNum The position of the variable in the logger's variable
+     * array
+     * @return **float** The cached value, or the logger's current value when
+     * nothing is cached
+     */
+    float sampleValue(uint8_t sample, uint8_t varNum);
+    /**
+     * @brief Get the epoch of a sample about to be put in the snapshot
+     *
+     * @param sample The sample number, oldest first
+     * @return **uint32_t** The cached epoch, or the logger's current one
+     * when nothing is cached
+     */
+    uint32_t sampleEpoch(uint8_t sample);
+#if IOTPLOTTER_DEADBAND
+    /**
+     * @brief Leave the variables that haven't changed past their deadband
+     * out of the snapshot
+     *
+     * @param firstVar The position in the logger's variable array of the
+     * first variable in the snapshot
+     * @param varCount The number of variables in the snapshot
+     * @param samples The number of samples going into the snapshot
+     */
+    void applyDeadband(uint8_t firstVar, uint8_t varCount, uint8_t samples);
+    /**
+     * @brief Remember the values of the posted snapshot as the last
+     * published, for the deadband
+     */
+    void recordReported(void);
+#endif
+    /**
+     * @brief Get the number of decimal places a variable is published with,
+     * learning it from the logger the first time, or the default past
+     * #IOTPLOTTER_MAX_PRECISIONS
+     *
+     * @param varNum The position of the variable in the logger's variable
+     * array
+     * @return **uint8_t** The number of decimal places
+     */
+    uint8_t decimalsAtI(uint8_t varNum);
+    /**
+     * @brief Add one value of a variable to the current sample of the
+     * snapshot
+     *
+     * @param varNum The position of the variable in the logger's variable
+     * array
+     * @param value The value
+     * @return **bool** True if it fit
+     */
+    bool addValueAtI(uint8_t varNum, float value);
+    /**
+     * @brief Render the request headers that stay the same from post to post
+     * into the header cache
+     */
+    void renderHeader(void);
+    /**
+     * @brief Write the request line and the headers that stay the same from
+     * post to post
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     */
+    template <typename Sink>
+    void writeHeaderBlock(Sink& sink);
+    /**
+     * @brief Write all of the request headers, up to the blank line before
+     * the body
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     * @param chunked True to announce a chunked body; false to measure the
+     * body and give its Content-Length
+     */
+    template <typename Sink>
+    void writeHeaders(Sink& sink, bool chunked);
+    /**
+     * @brief Write the full post request for the current snapshot
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     */
+    template <typename Sink>
+    void writeRequest(Sink& sink);
+    /**
+     * @brief Write the body of the current post as it is sent: gzipped or
+     * not, see chooseEncoding()
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     */
+    template <typename Sink>
+    void writeBody(Sink& sink);
+    /**
+     * @brief Write the next stretch of the body of the current post as it is
+     * sent, carrying on from where the last call left off
+     *
+     * A gzipped body is compressed only the once: the compressor keeps its
+     * place between calls, and the body's bytes already compressed are
+     * skipped over without going through it again.
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     * @param length The most bytes of uncompressed body to write
+     * @return **bool** True if that was the end of the body
+     */
+    template <typename Sink>
+    bool writeBodyPiece(Sink& sink, size_t length);
+    /**
+     * @brief Write the uncompressed body of the current post: the snapshot
+     * as JSON or CSV, or the metrics when posting those
+     *
+     * @tparam Sink The type of the sink, see IoTPlotterSerializer
+     * @param sink The sink to write to
+     */
+    template <typename Sink>
+    void writeContent(Sink& sink);
+
+    /**
+     * @brief The phases of a post
+     */
+    enum postPhase : uint8_t {
+        IOTPLOTTER_IDLE,          ///< Not publishing
+        IOTPLOTTER_CONNECT,       ///< Opening the connection
+        IOTPLOTTER_SEND,          ///< Sending the request
+        IOTPLOTTER_AWAIT_STATUS,  ///< Waiting for the response status line
+        IOTPLOTTER_READ_BODY,     ///< Reading the rest of the response
+        IOTPLOTTER_CLOSE,         ///< Closing the connection
+        IOTPLOTTER_BACKOFF,       ///< Waiting to retry a failed post
+    };
+    /**
+     * @brief Move a post on to its next phase and start that phase's clock
+     *
+     * @param phase The postPhase to move on to
+     */
+    void enterPhase(uint8_t phase);
+    /**
+     * @brief Count the TLS handshake of the connection just made in the
+     * metrics, as full or resumed
+     */
+    void recordHandshake(void);
+    /**
+     * @brief Feed whatever has arrived of the response to the parser
+     */
+    void readResponse(void);
+    /**
+     * @brief Drop a dead kept-alive connection and start the post over on a
+     * new one
+     */
+    void reconnect(void);
+    /**
+     * @brief Lay out the whole request for the current post into the
+     * pre-render buffer or spill store, if there is one and it fits
+     */
+    void prerender(void);
+    /**
+     * @brief Decide whether to gzip the body of the post about to start,
+     * measuring it while at it when its length is needed
+     */
+    void chooseEncoding(void);
+    /**
+     * @brief Begin posting the current snapshot
+     *
+     * @param samples The number of samples in the snapshot
+     */
+    void startPost(uint8_t samples);
+    /**
+     * @brief Deal with the outcome of a post, and start the next one if
+     * there is more to send
+     *
+     * @param responseCode The http status code of the response, or 504 if
+     * there was no connection or response
+     */
+    void finishPost(int16_t responseCode);
+    /**
+     * @brief Check whether a failed post is worth trying again later
+     *
+     * @param responseCode The result of the post
+     * @return **bool** True for a connection failure, timeout or 5xx
+     */
+    static bool isRetryable(int16_t responseCode);
+    /**
+     * @brief Sort the result of a failed post into its retry class
+     *
+     * @param responseCode The result of the post
+     * @return **uint8_t** The #iotPlotterFailure class
+     */
+    uint8_t failureClass(int16_t responseCode);
+    /**
+     * @brief Start posting the current snapshot to the next mirror that has
+     * something to be sent
+     *
+     * @param first The index of the first destination to consider
+     * @return **bool** True if a post was started
+     */
+    bool startMirrorPost(uint8_t first);
+    /**
+     * @name The target of the post in progress
+     *
+     * The publisher's own feed, or the mirror being posted to.
      *
      * @{
      */
-    static const char* samplingFeatureTag;  ///< The JSON feature UUID tag
-    static const char* JSONvalueTag;         //  ":[{\"value\":"     used at start of reporting a value
-    static const char* epochTag;             //  ", \"epoch\":"  The JSON feature epoch timestamp tag
-                                            /**@}*/
+    const char*    postHost(void);
+    uint16_t       postPort(void);
+    const char*    postFeedID(void);
+    const char*    postKey(void);
+    const uint8_t* postMask(void);
+    /**@}*/
+    /**
+     * @brief Move the cached samples into the persistent queue
+     */
+    void queueSamples(void);
+    /**
+     * @brief Load the next batch from the persistent queue and start posting
+     * it
+     *
+     * @return **bool** True if a post was started; false once the queue is
+     * empty or the drain budget has run out
+     */
+    bool startDrainPost(void);
+    /**
+     * @brief Load the next rows of the backfill file and start posting them
+     *
+     * @param maxBytes The most bytes of the file the batch may cover; 0 for
+     * no limit
+     * @return **bool** True if a post was started; false if there are no
+     * more complete rows
+     */
+    bool startBackfillPost(uint32_t maxBytes);
 
  private:
     // Tokens and UUID's for EnviroDIY
     const char* _registrationToken = nullptr;         
     const char* _feedID = nullptr;         
+
+    // The fixed part of the request headers
+#if IOTPLOTTER_HEADER_CACHE_SIZE > 0
+    char        _headerCache[IOTPLOTTER_HEADER_CACHE_SIZE];
+#endif
+    const char* _header       = nullptr;  ///< The cache, or a static block
+    uint16_t    _headerLength = 0;        ///< 0 if there is no usable block
+    bool        _staticHeader = false;
+
+    // The ring buffer of samples cached for batched publishing
+    float    _sampleValues[IOTPLOTTER_MAX_BATCH][IOTPLOTTER_MAX_VARIABLES];
+    uint32_t _sampleEpochs[IOTPLOTTER_MAX_BATCH];
+    uint8_t  _sampleHead  = 0;  ///< Slot of the oldest cached sample
+    uint8_t  _sampleCount = 0;  ///< Number of cached samples
+
+    // Decimal places of each variable, plus one, two variables to a byte
+    // with the even one in the low half; 0 until known
+    uint8_t _decimals[(IOTPLOTTER_MAX_PRECISIONS + 1) / 2] = {};
+
+    // Where the publish in progress is in the variables
+    uint8_t _postSamples  = 0;  ///< Samples in the current post
+    uint8_t _pageStart    = 0;  ///< First variable of the next post
+    uint8_t _pageVarsLeft = 0;  ///< Variables not yet posted
+
+#if IOTPLOTTER_DEADBAND
+    // Change-only publishing
+    float    _deadband[IOTPLOTTER_MAX_VARIABLES]      = {};
+    uint8_t  _deadbandOn[(IOTPLOTTER_MAX_VARIABLES + 7) / 8] = {};
+    float    _reported[IOTPLOTTER_MAX_VARIABLES]      = {};  ///< Last published
+    uint32_t _reportedEpoch[IOTPLOTTER_MAX_VARIABLES] = {};  ///< 0 if never
+    uint32_t _maxSilence = 0;
+#endif
+
+    // The text of the publish in progress
+    IoTPlotterSnapshotBuffer<IOTPLOTTER_SNAPSHOT_SIZE> _snapshot;
+
+    // Persistent store-and-forward of samples that could not be sent
+    IoTPlotterQueue* _queue         = nullptr;
+    uint16_t         _maxDrainBytes = IOTPLOTTER_QUEUE_DRAIN_BYTES;
+    uint32_t         _drainBudget   = 0;  ///< Bytes left to drain this publish
+    uint32_t         _drainEnd      = 0;  ///< Queue offset after the posted batch
+
+    // The data file being uploaded by backfill(); nullptr otherwise
+    IoTPlotterBackfill* _backfill = nullptr;
+
+    // The state of the publish in progress
+    Client*            _postClient    = nullptr;
+    uint8_t            _postState     = IOTPLOTTER_IDLE;
+    uint32_t           _phaseStart    = 0;  ///< millis() when the phase began
+    uint32_t           _bytesSent     = 0;  ///< Request bytes sent so far
+    uint32_t           _bodySent      = 0;  ///< Body bytes, before gzip, sent
+    bool               _bodyBegun     = false;  ///< All the headers are sent
+    bool               _draining      = false;
+    bool               _chunked       = false;
+    bool               _postChunked   = false;  ///< The current post is chunked
+    bool               _csv           = false;
+    uint16_t           _mtu           = IOTPLOTTER_MTU;
+
+    // Requests laid out before connecting
+    enum prerenderState : uint8_t {
+        IOTPLOTTER_LIVE,       ///< Laid out while connected
+        IOTPLOTTER_IN_BUFFER,  ///< Held in the pre-render buffer
+        IOTPLOTTER_IN_SPILL,   ///< Held in the spill store
+    };
+    char*            _prerenderBuffer = nullptr;
+    uint16_t         _prerenderSize   = 0;
+    IoTPlotterStore* _spill           = nullptr;
+    uint8_t          _prerendered     = IOTPLOTTER_LIVE;
+    uint32_t         _prerenderLength = 0;
+    int16_t            _postResponse  = 0;
+    uint8_t            _postFailure   = IOTPLOTTER_NO_FAILURE;
+    int16_t            _publishResult = 0;
+    IoTPlotterResponse _response;
+    uint32_t           _connectTimeout = IOTPLOTTER_CONNECT_TIMEOUT;
+    uint32_t           _sendTimeout    = IOTPLOTTER_SEND_TIMEOUT;
+    uint32_t           _statusTimeout  = IOTPLOTTER_STATUS_TIMEOUT;
+
+    // Persistent connections
+    bool     _keepAlive         = false;
+    bool     _connectionOpen    = false;  ///< A connection was left open
+    bool     _connectionReused  = false;  ///< The current post is reusing it
+    uint16_t _connectionsOpened = 0;
+    uint16_t _connectionsReused = 0;
+    uint16_t _reconnects        = 0;
+
+    // Posting over TLS; nullptr for plain HTTP
+    IoTPlotterTlsAdapter* _tls = nullptr;
+
+    // Compressing the body; nullptr to send it as it is
+    IoTPlotterDeflate* _deflate     = nullptr;
+    uint16_t           _compressMin = IOTPLOTTER_COMPRESS_MIN_BODY;
+    bool               _gzip        = false;  ///< The current post is gzipped
+
+    // Spacing out retries of failed posts
+    IoTPlotterRetry _retry;
+
+    // Mirrors of the feed
+    IoTPlotterDestination _destinations[IOTPLOTTER_MAX_DESTINATIONS];
+    uint8_t        _destinationCount = 0;
+    uint8_t        _mirror           = 0;  ///< Mirror being posted to, plus 1
+    // What each destination, the feed's own first, has refused to take
+    enum refusedEncoding : uint8_t {
+        IOTPLOTTER_REFUSED_CHUNKED = 0x01,  ///< Chunked bodies
+        IOTPLOTTER_REFUSED_GZIP    = 0x02,  ///< Gzipped bodies
+    };
+    uint8_t        _refused[IOTPLOTTER_MAX_DESTINATIONS + 1] = {};
+    int16_t        _feedResponse     = 0;  ///< The feed's answer, meanwhile
+    const char*    _openHost         = nullptr;  ///< Where the connection goes
+    uint16_t       _openPort         = 0;
+    // The body length, measured once per variable set
+    bool           _lengthKnown = false;
+    const uint8_t* _lengthMask  = nullptr;
+    uint32_t       _bodyLength  = 0;
+
+    // Instrumentation
+    IoTPlotterMetrics _postMetrics  = {};  ///< The post in progress
+    IoTPlotterMetrics _lastMetrics  = {};  ///< The last publish
+    IoTPlotterMetrics _totalMetrics = {};  ///< Everything since a reset
+    uint32_t _snapshotMillis = 0;  ///< Time taken by the last takeSnapshot()
+    // Set only while posting the metrics themselves
+    const IoTPlotterMetrics* _metricsBody   = nullptr;
+    const char*              _metricsFeedID = nullptr;
+    uint32_t                 _metricsEpoch  = 0;
 };
 
 #endif  // SRC_PUBLISHERS_IOTPLOTTERPUBLISHER_H_
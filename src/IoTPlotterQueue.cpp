@@ -0,0 +1,163 @@
+/**
+ * @file IoTPlotterQueue.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterQueue class.
+ */
+
+#include "IoTPlotterQueue.h"
+#include <string.h>
+
+// The first byte of every record
+#define IOTPLOTTER_RECORD_MARKER 0xA5
+// Marker, value count and epoch
+#define IOTPLOTTER_RECORD_HEADER 6
+// The CRC at the end of every record
+#define IOTPLOTTER_RECORD_CHECK 2
+// The starting value of each record's CRC
+#define IOTPLOTTER_CRC_INIT 0xFFFF
+
+
+// Runs a run of bytes through a CRC-16/CCITT (polynomial 0x1021), bit by bit
+// so that it needs no table
+static uint16_t crcBytes(uint16_t crc, const uint8_t* bytes, size_t length) {
+    while (length--) {
+        crc ^= static_cast<uint16_t>(*bytes++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+
+IoTPlotterQueue::IoTPlotterQueue(IoTPlotterStore* dataStore,
+                                 IoTPlotterStore* cursorStore)
+    : _dataStore(dataStore),
+      _cursorStore(cursorStore) {}
+
+
+void IoTPlotterQueue::begin(void) {
+    // The checkpoint is the cursor followed by its bitwise inverse, so that a
+    // torn write can be told apart from a real cursor
+    uint8_t  saved[8];
+    uint32_t cursor   = 0;
+    uint32_t inverted = 0;
+    if (_cursorStore->read(0, saved, sizeof(saved)) == sizeof(saved)) {
+        for (uint8_t i = 0; i < 4; i++) {
+            cursor |= static_cast<uint32_t>(saved[i]) << (8 * i);
+            inverted |= static_cast<uint32_t>(saved[i + 4]) << (8 * i);
+        }
+    }
+    if (cursor != ~inverted || cursor > _dataStore->size()) cursor = 0;
+    _cursor = cursor;
+}
+
+
+bool IoTPlotterQueue::push(uint32_t epoch, const float* values,
+                           uint8_t varCount) {
+    if (varCount > IOTPLOTTER_QUEUE_MAX_VALUES) return false;
+    // The record is laid out whole and written with a single append, so the
+    // store is never left holding part of it after an error
+    uint8_t record[IOTPLOTTER_RECORD_HEADER +
+                   sizeof(float) * IOTPLOTTER_QUEUE_MAX_VALUES +
+                   IOTPLOTTER_RECORD_CHECK];
+    size_t  valueSize = sizeof(float) * varCount;
+    size_t  checkAt   = IOTPLOTTER_RECORD_HEADER + valueSize;
+    size_t  length    = checkAt + IOTPLOTTER_RECORD_CHECK;
+    record[0]         = IOTPLOTTER_RECORD_MARKER;
+    record[1]         = varCount;
+    for (uint8_t i = 0; i < 4; i++) record[i + 2] = epoch >> (8 * i);
+    memcpy(record + IOTPLOTTER_RECORD_HEADER, values, valueSize);
+    uint16_t check      = crcBytes(IOTPLOTTER_CRC_INIT, record, checkAt);
+    record[checkAt]     = check;
+    record[checkAt + 1] = check >> 8;
+    return _dataStore->append(record, length) == length;
+}
+
+
+uint32_t IoTPlotterQueue::read(uint32_t offset, uint32_t& epoch,
+                               float* values, uint8_t maxVars,
+                               uint8_t& varCount) {
+    uint8_t header[IOTPLOTTER_RECORD_HEADER];
+    if (_dataStore->read(offset, header, sizeof(header)) != sizeof(header) ||
+        header[0] != IOTPLOTTER_RECORD_MARKER) {
+        return 0;
+    }
+    varCount = header[1];
+    epoch    = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        epoch |= static_cast<uint32_t>(header[i + 2]) << (8 * i);
+    }
+
+    uint16_t check = crcBytes(IOTPLOTTER_CRC_INIT, header, sizeof(header));
+    uint32_t valueStart = offset + IOTPLOTTER_RECORD_HEADER;
+    size_t   valueSize  = sizeof(float) * varCount;
+    if (varCount > 0 && varCount <= maxVars) {
+        uint8_t* valueBytes = reinterpret_cast<uint8_t*>(values);
+        if (_dataStore->read(valueStart, valueBytes, valueSize) != valueSize) {
+            return 0;
+        }
+        check = crcBytes(check, valueBytes, valueSize);
+    } else {
+        // There's no room for the values, but they still have to be read to
+        // check the record is intact
+        uint8_t chunk[16];
+        for (size_t done = 0; done < valueSize; done += sizeof(chunk)) {
+            size_t take = valueSize - done < sizeof(chunk) ? valueSize - done
+                                                           : sizeof(chunk);
+            if (_dataStore->read(valueStart + done, chunk, take) != take) {
+                return 0;
+            }
+            check = crcBytes(check, chunk, take);
+        }
+    }
+
+    uint8_t stored[IOTPLOTTER_RECORD_CHECK];
+    if (_dataStore->read(valueStart + valueSize, stored, sizeof(stored)) !=
+            sizeof(stored) ||
+        stored[0] != (check & 0xFF) || stored[1] != (check >> 8)) {
+        return 0;
+    }
+    return valueStart + valueSize + IOTPLOTTER_RECORD_CHECK;
+}
+
+
+uint32_t IoTPlotterQueue::resync(uint32_t offset) {
+    uint32_t end = endOffset();
+    uint8_t  chunk[16];
+    // Read a chunk at a time, and check each marker found in it
+    for (uint32_t at = offset + 1; at < end; at += sizeof(chunk)) {
+        size_t got = _dataStore->read(at, chunk, sizeof(chunk));
+        if (got == 0) break;
+        for (size_t i = 0; i < got; i++) {
+            if (chunk[i] != IOTPLOTTER_RECORD_MARKER) continue;
+            uint32_t epoch;
+            uint8_t  varCount;
+            if (read(at + i, epoch, nullptr, 0, varCount) != 0) return at + i;
+        }
+    }
+    return end;
+}
+
+
+bool IoTPlotterQueue::commit(uint32_t offset) {
+    if (offset >= _dataStore->size()) {
+        // Everything has been sent; start the queue over.  If the cursor
+        // checkpoint below is lost, begin() finds it past the end of the
+        // emptied queue and resets it.
+        if (!_dataStore->clear()) return false;
+        offset = 0;
+    }
+    uint8_t  saved[8];
+    uint32_t inverted = ~offset;
+    for (uint8_t i = 0; i < 4; i++) {
+        saved[i]     = offset >> (8 * i);
+        saved[i + 4] = inverted >> (8 * i);
+    }
+    _cursor = offset;
+    return _cursorStore->clear() &&
+        _cursorStore->append(saved, sizeof(saved)) == sizeof(saved);
+}
@@ -0,0 +1,153 @@
+/**
+ * @file IoTPlotterQueue.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterQueue class, a persistent store-and-forward
+ * queue of samples that could not be published.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERQUEUE_H_
+#define SRC_PUBLISHERS_IOTPLOTTERQUEUE_H_
+
+// Included Dependencies
+#include "IoTPlotterStore.h"
+
+/**
+ * @brief The most values a queued record can hold.
+ *
+ * Each record is laid out in a buffer on the stack before it is written, so
+ * this costs 4 bytes of stack per value while pushing.  It must be at least
+ * IOTPLOTTER_MAX_VARIABLES.
+ */
+#ifndef IOTPLOTTER_QUEUE_MAX_VALUES
+#define IOTPLOTTER_QUEUE_MAX_VALUES 32
+#endif
+
+/**
+ * @brief An append-only queue of unsent samples kept in an IoTPlotterStore,
+ * with a separately checkpointed read cursor.
+ *
+ * Each sample is one binary record:
+ *
+ * | bytes | contents                                                  |
+ * | ----- | --------------------------------------------------------- |
+ * | 1     | record marker, 0xA5                                       |
+ * | 1     | number of values, n                                       |
+ * | 4     | local epoch time, little endian                           |
+ * | 4 * n | the values as IEEE-754 floats, little endian              |
+ * | 2     | CRC-16/CCITT of all the preceding bytes, little endian    |
+ *
+ * Records are only ever appended to the data store.  Reading does not change
+ * it; instead the offset of the first unsent record is written to the cursor
+ * store each time a batch is accepted by the portal.  Once every record has
+ * been sent the data store is emptied and the cursor goes back to 0.  A
+ * power failure can at worst cause a batch to be sent twice, never lost.
+ *
+ * Each record is written with a single append.  A record torn by a power
+ * failure, or damaged on the card, fails its checksum; resync() finds the
+ * next intact record after it, so only the damaged record is lost.  The
+ * checksum is a CRC so that a 0xA5 among the values of a record is very
+ * unlikely to pass for the start of another one.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterQueue {
+ public:
+    /**
+     * @brief Construct a new queue
+     *
+     * @param dataStore The store holding the records
+     * @param cursorStore The store holding the read cursor checkpoint
+     */
+    IoTPlotterQueue(IoTPlotterStore* dataStore, IoTPlotterStore* cursorStore);
+
+    /**
+     * @brief Load the checkpointed read cursor
+     *
+     * This must be called before using the queue, after the storage medium is
+     * available.
+     */
+    void begin(void);
+
+    /**
+     * @brief Add a sample to the end of the queue
+     *
+     * @param epoch The local epoch time of the sample
+     * @param values The sample's values
+     * @param varCount The number of values; at most
+     * IOTPLOTTER_QUEUE_MAX_VALUES
+     * @return **bool** True if the whole record was written
+     */
+    bool push(uint32_t epoch, const float* values, uint8_t varCount);
+
+    /**
+     * @brief Read the record that starts at a given offset
+     *
+     * @param offset The offset of the record in the data store
+     * @param epoch Set to the record's local epoch time
+     * @param values Filled with the record's values
+     * @param maxVars The number of values there is room for
+     * @param varCount Set to the number of values in the record
+     * @return **uint32_t** The offset of the following record, or 0 if there
+     * is no complete, intact record at the offset
+     */
+    uint32_t read(uint32_t offset, uint32_t& epoch, float* values,
+                  uint8_t maxVars, uint8_t& varCount);
+
+    /**
+     * @brief Find the first intact record after a damaged one
+     *
+     * The data store is searched for the next record marker that starts a
+     * record whose checksum verifies.
+     *
+     * @param offset The offset of the damaged record
+     * @return **uint32_t** The offset of the next intact record, or
+     * endOffset() if there is none
+     */
+    uint32_t resync(uint32_t offset);
+
+    /**
+     * @brief Get the offset of the first unsent record
+     *
+     * @return **uint32_t** The read cursor
+     */
+    uint32_t readCursor(void) {
+        return _cursor;
+    }
+    /**
+     * @brief Get the offset just past the last record
+     *
+     * @return **uint32_t** The size of the data store
+     */
+    uint32_t endOffset(void) {
+        return _dataStore->size();
+    }
+    /**
+     * @brief Check whether there is anything left to send
+     *
+     * @return **bool** True if every queued record has been sent
+     */
+    bool isEmpty(void) {
+        return _cursor >= endOffset();
+    }
+
+    /**
+     * @brief Checkpoint the read cursor after records have been sent
+     *
+     * If the cursor reaches the end of the queue, the data store is emptied.
+     *
+     * @param offset The offset of the first record that has not been sent
+     * @return **bool** True if the checkpoint was saved
+     */
+    bool commit(uint32_t offset);
+
+ private:
+    IoTPlotterStore* _dataStore;
+    IoTPlotterStore* _cursorStore;
+    uint32_t         _cursor = 0;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERQUEUE_H_
@@ -0,0 +1,189 @@
+/**
+ * @file IoTPlotterResponse.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterResponse class.
+ */
+
+#include "IoTPlotterResponse.h"
+
+// The header names and values looked for stay in flash on an Arduino
+#if defined(ARDUINO)
+#define IOTPLOTTER_TOKEN_IS(token, text) (strcmp_P(token, PSTR(text)) == 0)
+#define IOTPLOTTER_TOKEN_HAS(token, text) (strstr_P(token, PSTR(text)) != nullptr)
+#else
+#define IOTPLOTTER_TOKEN_IS(token, text) (strcmp(token, text) == 0)
+#define IOTPLOTTER_TOKEN_HAS(token, text) (strstr(token, text) != nullptr)
+#endif
+
+
+void IoTPlotterResponse::begin(void) {
+    _state       = VERSION;
+    _position    = 0;
+    _statusCode  = 0;
+    _keepAlive   = true;
+    _chunked     = false;
+    _hasLength   = false;
+    _remaining   = 0;
+    _retryAfter  = 0;
+    _header      = OTHER_HEADER;
+    _tokenLength = 0;
+}
+
+
+bool IoTPlotterResponse::feed(char c) {
+    switch (_state) {
+        case VERSION:
+            // "HTTP/1.1 " - everything up to the first space.  An HTTP/1.0
+            // server closes the connection unless it says otherwise.
+            if (c == ' ') {
+                _state    = CODE;
+                _position = 0;
+            } else {
+                if (_position == 7 && c == '0') _keepAlive = false;
+                _position++;
+            }
+            break;
+        case CODE:
+            if (c >= '0' && c <= '9') {
+                _statusCode = _statusCode * 10 + (c - '0');
+                if (++_position == 3) _state = REASON;
+            } else {
+                // Not a status line we understand; there's no telling where
+                // this response ends
+                _statusCode = 0;
+                _keepAlive  = false;
+                _state      = COMPLETE;
+            }
+            break;
+        case REASON:
+            if (c == '\n') {
+                _state       = HEADER_NAME;
+                _tokenLength = 0;
+            }
+            break;
+        case HEADER_NAME:
+            if (c == '\r') break;
+            if (c == '\n') {
+                // A blank line ends the headers
+                endHeaders();
+            } else if (c == ':') {
+                _token[_tokenLength] = '\0';
+                if (IOTPLOTTER_TOKEN_IS(_token, "content-length")) {
+                    _header = CONTENT_LENGTH;
+                } else if (IOTPLOTTER_TOKEN_IS(_token, "connection")) {
+                    _header = CONNECTION;
+                } else if (IOTPLOTTER_TOKEN_IS(_token, "transfer-encoding")) {
+                    _header = TRANSFER_ENCODING;
+                } else if (IOTPLOTTER_TOKEN_IS(_token, "retry-after")) {
+                    _header = RETRY_AFTER;
+                } else {
+                    _header = OTHER_HEADER;
+                }
+                _tokenLength = 0;
+                _state       = HEADER_VALUE;
+            } else if (_tokenLength < sizeof(_token) - 1) {
+                _token[_tokenLength++] = c >= 'A' && c <= 'Z' ? c + 32 : c;
+            }
+            break;
+        case HEADER_VALUE:
+            if (c == '\n') {
+                endHeaderLine();
+            } else if (c == '\r' || (c == ' ' && _tokenLength == 0)) {
+                break;
+            } else if (_header == CONTENT_LENGTH) {
+                if (c >= '0' && c <= '9') {
+                    _remaining = _remaining * 10 + (c - '0');
+                    _hasLength = true;
+                }
+            } else if (_header == RETRY_AFTER) {
+                // Delay-seconds; an HTTP-date stops at its first letter
+                if (c >= '0' && c <= '9' && _tokenLength == 0 &&
+                    _retryAfter < 100000000UL) {
+                    _retryAfter = _retryAfter * 10 + (c - '0');
+                } else {
+                    _tokenLength = 1;
+                }
+            } else if (_header != OTHER_HEADER &&
+                       _tokenLength < sizeof(_token) - 1) {
+                _token[_tokenLength++] = c >= 'A' && c <= 'Z' ? c + 32 : c;
+            }
+            break;
+        case BODY:
+            if (--_remaining == 0) _state = COMPLETE;
+            break;
+        case CHUNK_SIZE:
+            if (c == '\n') {
+                _position = 0;
+                _state    = _remaining > 0 ? CHUNK_DATA : TRAILER;
+            } else if (_position > 0) {
+                // Inside a chunk extension, which runs to the end of the line
+            } else if (c >= '0' && c <= '9') {
+                _remaining = _remaining * 16 + (c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                _remaining = _remaining * 16 + (c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                _remaining = _remaining * 16 + (c - 'A' + 10);
+            } else if (c == ';') {
+                // A chunk extension; ignore everything to the end of the line
+                _position = 1;
+            }
+            break;
+        case CHUNK_DATA:
+            if (--_remaining == 0) _state = CHUNK_DATA_END;
+            break;
+        case CHUNK_DATA_END:
+            if (c == '\n') _state = CHUNK_SIZE;
+            break;
+        case TRAILER:
+            // Trailer lines, ended by a blank line
+            if (c == '\n') {
+                if (_position == 0) _state = COMPLETE;
+                _position = 0;
+            } else if (c != '\r') {
+                _position++;
+            }
+            break;
+        default: break;
+    }
+    return isComplete();
+}
+
+
+void IoTPlotterResponse::endHeaderLine(void) {
+    _token[_tokenLength] = '\0';
+    if (_header == CONNECTION) {
+        if (IOTPLOTTER_TOKEN_HAS(_token, "close")) _keepAlive = false;
+        if (IOTPLOTTER_TOKEN_HAS(_token, "keep-alive")) _keepAlive = true;
+    } else if (_header == TRANSFER_ENCODING) {
+        if (IOTPLOTTER_TOKEN_HAS(_token, "chunked")) _chunked = true;
+    }
+    _header      = OTHER_HEADER;
+    _tokenLength = 0;
+    _state       = HEADER_NAME;
+}
+
+
+void IoTPlotterResponse::endHeaders(void) {
+    _position = 0;
+    if (_statusCode >= 100 && _statusCode < 200) {
+        // An interim response (like 100 Continue) has no body; the real
+        // response follows straight after it
+        begin();
+    } else if (_statusCode == 204 || _statusCode == 304) {
+        // Never a body
+        _state = COMPLETE;
+    } else if (_chunked) {
+        _remaining = 0;
+        _state     = CHUNK_SIZE;
+    } else if (_hasLength) {
+        _state = _remaining > 0 ? BODY : COMPLETE;
+    } else {
+        // The body runs until the server closes the connection, so the
+        // connection can't be used again
+        _keepAlive = false;
+        _state     = COMPLETE;
+    }
+}
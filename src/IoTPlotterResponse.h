@@ -0,0 +1,151 @@
+/**
+ * @file IoTPlotterResponse.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterResponse class, an incremental parser for the
+ * server's reply to a post.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERRESPONSE_H_
+#define SRC_PUBLISHERS_IOTPLOTTERRESPONSE_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+
+/**
+ * @brief An incremental, allocation-free parser for an HTTP response.
+ *
+ * Bytes are fed in one at a time as they arrive, so the caller never has to
+ * wait for a whole line (or any fixed number of bytes) to be available.
+ *
+ * Besides the status code, the parser follows the response to its end - a
+ * Content-Length bounded or chunked body - so that a kept-alive connection is
+ * left at the start of the next response.  Interim (1xx) responses are
+ * skipped over, and a Retry-After header is picked up.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterResponse {
+ public:
+    /**
+     * @brief Reset the parser for a new response
+     */
+    void begin(void);
+
+    /**
+     * @brief Parse the next byte of the response
+     *
+     * @param c The byte
+     * @return **bool** True once the whole response has been read
+     */
+    bool feed(char c);
+
+    /**
+     * @brief Check whether the status code has been read
+     *
+     * @return **bool** True once the status code is known
+     */
+    bool hasStatus(void) const {
+        // An interim 1xx response is followed by the real one
+        return _state > CODE && (_statusCode < 100 || _statusCode >= 200);
+    }
+    /**
+     * @brief Check whether the status line and headers of the final response
+     * have been read
+     *
+     * @return **bool** True once only the body, if any, is left
+     */
+    bool hasHeaders(void) const {
+        return _state >= BODY;
+    }
+    /**
+     * @brief Check whether the whole response, including any body, has been
+     * read
+     *
+     * @return **bool** True once the response is complete
+     */
+    bool isComplete(void) const {
+        return _state == COMPLETE;
+    }
+    /**
+     * @brief Get the status code
+     *
+     * @return **int16_t** The http status code, or 0 if the status line was
+     * malformed or hasn't been read yet
+     */
+    int16_t statusCode(void) const {
+        return _statusCode;
+    }
+    /**
+     * @brief Check whether the connection can be used for another request
+     * once this response is complete
+     *
+     * @return **bool** False if the server asked to close the connection, or
+     * if the end of the body can only be told by the connection closing
+     */
+    bool keepAlive(void) const {
+        return _keepAlive;
+    }
+    /**
+     * @brief Get how long the server asked the client to wait before trying
+     * again
+     *
+     * Only the delay-seconds form of Retry-After is understood; a logger
+     * can't be trusted to have the server's idea of the date.
+     *
+     * @return **uint32_t** The seconds from the Retry-After header, or 0 if
+     * there was none (or it hasn't been read yet)
+     */
+    uint32_t retryAfter(void) const {
+        return _retryAfter;
+    }
+
+ private:
+    enum parseState : uint8_t {
+        VERSION,         ///< Reading "HTTP/1.1"
+        CODE,            ///< Reading the three status digits
+        REASON,          ///< Skipping the rest of the status line
+        HEADER_NAME,     ///< Reading a header name
+        HEADER_VALUE,    ///< Reading a header value
+        BODY,            ///< Skipping a Content-Length bounded body
+        CHUNK_SIZE,      ///< Reading the size line of a chunk
+        CHUNK_DATA,      ///< Skipping the data of a chunk
+        CHUNK_DATA_END,  ///< Skipping the CRLF after a chunk's data
+        TRAILER,         ///< Skipping the trailer after the last chunk
+        COMPLETE,        ///< The whole response has been read
+    };
+    enum headerName : uint8_t {
+        OTHER_HEADER,
+        CONTENT_LENGTH,
+        CONNECTION,
+        TRANSFER_ENCODING,
+        RETRY_AFTER,
+    };
+
+    void endHeaderLine(void);
+    void endHeaders(void);
+
+    uint8_t  _state      = VERSION;
+    uint8_t  _position   = 0;  ///< Characters read of the current line
+    int16_t  _statusCode = 0;
+    bool     _keepAlive  = true;
+    bool     _chunked    = false;
+    bool     _hasLength  = false;
+    uint32_t _remaining  = 0;  ///< Body or chunk bytes still to skip
+    uint32_t _retryAfter = 0;
+    uint8_t  _header     = OTHER_HEADER;
+    char     _token[20];  ///< Lowercased start of a header name or value
+    uint8_t  _tokenLength = 0;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERRESPONSE_H_
@@ -0,0 +1,129 @@
+/**
+ * @file IoTPlotterRetry.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterRetry class.
+ */
+
+#include "IoTPlotterRetry.h"
+
+// The doubling stops here, well before the delay could overflow
+#define IOTPLOTTER_MAX_BACKOFF_SHIFT 16
+
+
+IoTPlotterRetry::IoTPlotterRetry() {
+    // A failed connect is usually the modem or the network, and is cheap to
+    // try once more; a server in trouble is given longer to recover
+    setPolicy(IOTPLOTTER_CONNECT_FAILURE, 2000L, 600000L, 1);
+    setPolicy(IOTPLOTTER_TIMEOUT_FAILURE, 5000L, 600000L, 0);
+    setPolicy(IOTPLOTTER_CLIENT_ERROR, 0, 0, 0);
+    setPolicy(IOTPLOTTER_SERVER_ERROR, 30000L, 1800000L, 0);
+    setPolicy(IOTPLOTTER_NO_FAILURE, 0, 0, 0);
+}
+
+
+void IoTPlotterRetry::setPolicy(uint8_t failure, uint32_t baseDelay,
+                                uint32_t maxDelay, uint8_t maxRetries) {
+    if (failure >= IOTPLOTTER_FAILURE_CLASSES) return;
+    _policies[failure].baseDelay  = baseDelay;
+    _policies[failure].maxDelay   = maxDelay > baseDelay ? maxDelay : baseDelay;
+    _policies[failure].maxRetries = maxRetries;
+}
+
+
+void IoTPlotterRetry::setCircuitBreaker(uint8_t threshold, uint32_t cooldown) {
+    _threshold = threshold;
+    _cooldown  = cooldown;
+}
+
+
+void IoTPlotterRetry::seed(uint32_t seed) {
+    // xorshift gets stuck on 0
+    _random = seed != 0 ? seed : 0x9E3779B9UL;
+}
+
+
+bool IoTPlotterRetry::canAttempt(uint32_t now) const {
+    return waitRemaining(now) == 0;
+}
+
+
+uint32_t IoTPlotterRetry::waitRemaining(uint32_t now) const {
+    if (!_waiting) return 0;
+    int32_t left = static_cast<int32_t>(_nextAttempt - now);
+    return left > 0 ? static_cast<uint32_t>(left) : 0;
+}
+
+
+bool IoTPlotterRetry::isOpen(uint32_t now) const {
+    return _threshold > 0 && _failures >= _threshold && waitRemaining(now) > 0;
+}
+
+
+void IoTPlotterRetry::recordSuccess(void) {
+    _failures = 0;
+    _waiting  = false;
+}
+
+
+bool IoTPlotterRetry::recordFailure(uint8_t failure, uint32_t now,
+                                    uint32_t retryAfter) {
+    if (failure == IOTPLOTTER_NO_FAILURE ||
+        failure >= IOTPLOTTER_FAILURE_CLASSES) {
+        return false;
+    }
+    const IoTPlotterRetryPolicy& policy = _policies[failure];
+    // A refused request says nothing about the health of the server
+    if (failure != IOTPLOTTER_CLIENT_ERROR && _failures < 255) _failures++;
+
+    uint32_t delay = backoff(policy);
+    if (retryAfter > delay) delay = retryAfter;
+    bool tripped = _threshold > 0 && _failures >= _threshold;
+    if (tripped && _cooldown > delay) delay = _cooldown;
+    if (delay > 0) {
+        _waiting     = true;
+        _nextAttempt = now + delay;
+    }
+    // Once the breaker is open, nothing more is tried this publish
+    if (tripped || _retries >= policy.maxRetries) return false;
+    _retries++;
+    return true;
+}
+
+
+// Sorts a status code into the class that sets how it is retried
+uint8_t IoTPlotterRetry::classify(int16_t responseCode) {
+    if (responseCode >= 200 && responseCode < 300) return IOTPLOTTER_NO_FAILURE;
+    if (responseCode == 408) return IOTPLOTTER_TIMEOUT_FAILURE;
+    if (responseCode == 429 || responseCode >= 500) {
+        return IOTPLOTTER_SERVER_ERROR;
+    }
+    // No status line we could make sense of
+    if (responseCode <= 0) return IOTPLOTTER_TIMEOUT_FAILURE;
+    return IOTPLOTTER_CLIENT_ERROR;
+}
+
+
+// The backoff for the current run of failures, with the upper half jittered
+uint32_t IoTPlotterRetry::backoff(const IoTPlotterRetryPolicy& policy) {
+    if (policy.baseDelay == 0) return 0;
+    uint8_t  shift = _failures > 1 ? _failures - 1 : 0;
+    uint32_t delay = policy.maxDelay;
+    if (shift < IOTPLOTTER_MAX_BACKOFF_SHIFT &&
+        policy.baseDelay <= (policy.maxDelay >> shift)) {
+        delay = policy.baseDelay << shift;
+    }
+    uint32_t half = delay / 2;
+    return delay - half + nextRandom() % (half + 1);
+}
+
+
+// xorshift32; plenty for spreading retries out
+uint32_t IoTPlotterRetry::nextRandom(void) {
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file IoTPlotterRetry.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterRetry class, which decides when a failed post
+ * may be tried again.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERRETRY_H_
+#define SRC_PUBLISHERS_IOTPLOTTERRETRY_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/**
+ * @brief The default number of failures in a row that open the circuit
+ * breaker; 0, so that there is no breaker unless it is asked for.
+ *
+ * An open breaker holds off posts for its cooldown only when there is a
+ * queue to keep the samples meanwhile; without one, posts go ahead.  Turn it
+ * on with IoTPlotterRetry::setCircuitBreaker(), alongside a queue.
+ */
+#ifndef IOTPLOTTER_BREAKER_THRESHOLD
+#define IOTPLOTTER_BREAKER_THRESHOLD 0
+#endif
+/**
+ * @brief The default time the circuit breaker stays open, in ms.
+ */
+#ifndef IOTPLOTTER_BREAKER_COOLDOWN
+#define IOTPLOTTER_BREAKER_COOLDOWN 900000L
+#endif
+
+
+/**
+ * @brief The ways a post can fail, each with its own retry policy.
+ */
+typedef enum iotPlotterFailure : uint8_t {
+    IOTPLOTTER_NO_FAILURE,       ///< The post succeeded
+    IOTPLOTTER_CONNECT_FAILURE,  ///< No connection could be made
+    IOTPLOTTER_TIMEOUT_FAILURE,  ///< Connected, but no (usable) response
+    IOTPLOTTER_CLIENT_ERROR,     ///< A 4xx, other than 408 and 429
+    IOTPLOTTER_SERVER_ERROR,     ///< A 5xx, or 429 Too Many Requests
+    IOTPLOTTER_FAILURE_CLASSES,  ///< The number of failure classes
+} iotPlotterFailure;
+
+
+/**
+ * @brief How one class of failure is retried.
+ */
+typedef struct IoTPlotterRetryPolicy {
+    /** @brief The delay after the first failure, in ms; 0 for no backoff */
+    uint32_t baseDelay;
+    /** @brief The longest the doubling delay may grow to, in ms */
+    uint32_t maxDelay;
+    /** @brief How many times a post is retried before the publish gives up */
+    uint8_t maxRetries;
+} IoTPlotterRetryPolicy;
+
+
+/**
+ * @brief A retry scheduler with exponential backoff, jitter and a circuit
+ * breaker.
+ *
+ * After each failure the scheduler sets the earliest time the next attempt
+ * may be made.  The delay starts at the failure class's base delay and
+ * doubles with each failure in a row, up to the class's maximum.  Only the
+ * second half of the delay is random ("equal jitter"), so a fleet of loggers
+ * that lost the portal at the same moment doesn't come back at the same
+ * moment, while each still waits at least half the backoff.  A Retry-After
+ * from the server is honoured if it asks for longer.
+ *
+ * A post may be retried straight away (after its delay) within the same
+ * publish, up to the class's retry limit.  After that the samples are kept
+ * for a later publish, and publishes that come before the delay is up don't
+ * try to connect at all.
+ *
+ * If the circuit breaker has been turned on (see setCircuitBreaker()), once
+ * its threshold of failures in a row have piled up the breaker opens:
+ * nothing is attempted until the cooldown has passed.  Then a single post is
+ * let through; if it fails too, the breaker opens again.  Any success closes
+ * it.
+ *
+ * Client errors (4xx) mean the request itself was refused.  By default they
+ * are neither retried nor delayed, and they don't count towards the breaker.
+ *
+ * All times are millis() values, and are compared so that they survive
+ * millis() rolling over.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterRetry {
+ public:
+    /**
+     * @brief Construct a new scheduler with the default policies
+     */
+    IoTPlotterRetry();
+
+    /**
+     * @brief Set the retry policy for one class of failure
+     *
+     * @param failure The failure class, one of #iotPlotterFailure
+     * @param baseDelay The delay after the first failure, in ms
+     * @param maxDelay The longest the delay may grow to, in ms
+     * @param maxRetries How many times to retry within a publish
+     */
+    void setPolicy(uint8_t failure, uint32_t baseDelay, uint32_t maxDelay,
+                   uint8_t maxRetries);
+    /**
+     * @brief Set when the circuit breaker opens and for how long
+     *
+     * @param threshold The failures in a row that open the breaker; 0 for no
+     * breaker
+     * @param cooldown How long the breaker stays open, in ms
+     */
+    void setCircuitBreaker(uint8_t threshold, uint32_t cooldown);
+    /**
+     * @brief Seed the jitter
+     *
+     * Each logger should use a different seed, for example one made from its
+     * feed ID, so their retries spread out.
+     *
+     * @param seed Any number
+     */
+    void seed(uint32_t seed);
+
+    /**
+     * @brief Start a new publish, with a fresh allowance of retries
+     */
+    void beginPublish(void) {
+        _retries = 0;
+    }
+    /**
+     * @brief Check whether a post may be attempted now
+     *
+     * @param now The current millis()
+     * @return **bool** False while backing off or while the breaker is open
+     */
+    bool canAttempt(uint32_t now) const;
+    /**
+     * @brief Record a successful post, closing the breaker
+     */
+    void recordSuccess(void);
+    /**
+     * @brief Record a failed post and work out when to try again
+     *
+     * @param failure The failure class, one of #iotPlotterFailure
+     * @param now The current millis()
+     * @param retryAfter The delay the server asked for, in ms; 0 if none
+     * @return **bool** True if the post should be retried within this
+     * publish, once canAttempt() allows it
+     */
+    bool recordFailure(uint8_t failure, uint32_t now, uint32_t retryAfter);
+
+    /**
+     * @brief Sort the status code of a failed post into its failure class
+     *
+     * @param responseCode The http status code, or 0 if there was no status
+     * line that could be read
+     * @return **uint8_t** The #iotPlotterFailure class
+     */
+    static uint8_t classify(int16_t responseCode);
+
+    /**
+     * @brief Get the number of failures in a row, not counting client errors
+     *
+     * @return **uint8_t** The failures since the last success
+     */
+    uint8_t consecutiveFailures(void) const {
+        return _failures;
+    }
+    /**
+     * @brief Check whether the circuit breaker is open
+     *
+     * @param now The current millis()
+     * @return **bool** True if the breaker has tripped and its cooldown has
+     * not yet passed
+     */
+    bool isOpen(uint32_t now) const;
+    /**
+     * @brief Get how long it is until the next attempt may be made
+     *
+     * @param now The current millis()
+     * @return **uint32_t** The ms left to wait, or 0 if an attempt may be
+     * made now
+     */
+    uint32_t waitRemaining(uint32_t now) const;
+
+ private:
+    uint32_t backoff(const IoTPlotterRetryPolicy& policy);
+    uint32_t nextRandom(void);
+
+    IoTPlotterRetryPolicy _policies[IOTPLOTTER_FAILURE_CLASSES];
+    uint8_t  _threshold   = IOTPLOTTER_BREAKER_THRESHOLD;
+    uint32_t _cooldown    = IOTPLOTTER_BREAKER_COOLDOWN;
+    uint8_t  _failures    = 0;      ///< Failures in a row
+    uint8_t  _retries     = 0;      ///< Retries made in this publish
+    bool     _waiting     = false;  ///< Whether _nextAttempt applies
+    uint32_t _nextAttempt = 0;      ///< millis() of the earliest attempt
+    uint32_t _random      = 0x9E3779B9UL;  ///< xorshift state, never 0
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERRETRY_H_
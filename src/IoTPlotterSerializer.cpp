@@ -0,0 +1,157 @@
+/**
+ * @file IoTPlotterSerializer.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterSnapshot and IoTPlotterSerializer classes.
+ */
+
+#include "IoTPlotterSerializer.h"
+
+
+// Portions of the JSON body
+// Example taken from https://iotplotter.com/docs/
+IOTPLOTTER_TEXT_ARRAY(samplingFeatureText, "{\"data\":{\"");  // start of the JSON package
+IOTPLOTTER_TEXT_ARRAY(JSONvalueText, "\":[{\"value\":");
+IOTPLOTTER_TEXT_ARRAY(nextValueText, "},{\"value\":");
+IOTPLOTTER_TEXT_ARRAY(epochText, ", \"epoch\":");
+IOTPLOTTER_TEXT_ARRAY(nextGraphText, "}],\"");
+IOTPLOTTER_TEXT_ARRAY(closingText, "}]}}");
+IOTPLOTTER_TEXT_ARRAY(emptyText, "{\"data\":{}}");
+IOTPLOTTER_TEXT_ARRAY(csvEpochText, "epoch");
+
+IoTPlotterText IoTPlotterSerializer::samplingFeatureTag = IOTPLOTTER_TEXT(samplingFeatureText);
+IoTPlotterText IoTPlotterSerializer::JSONvalueTag       = IOTPLOTTER_TEXT(JSONvalueText);
+IoTPlotterText IoTPlotterSerializer::nextValueTag       = IOTPLOTTER_TEXT(nextValueText);
+IoTPlotterText IoTPlotterSerializer::epochTag           = IOTPLOTTER_TEXT(epochText);
+IoTPlotterText IoTPlotterSerializer::nextGraphTag       = IOTPLOTTER_TEXT(nextGraphText);
+IoTPlotterText IoTPlotterSerializer::closingTag         = IOTPLOTTER_TEXT(closingText);
+IoTPlotterText IoTPlotterSerializer::emptyTag           = IOTPLOTTER_TEXT(emptyText);
+IoTPlotterText IoTPlotterSerializer::csvEpochTag        = IOTPLOTTER_TEXT(csvEpochText);
+
+// Portions of the request headers, shared by the publisher and the gateway
+IOTPLOTTER_TEXT_ARRAY(postText, "POST ");
+IOTPLOTTER_TEXT_ARRAY(httpSchemeText, "http://");
+IOTPLOTTER_TEXT_ARRAY(httpsSchemeText, "https://");
+IOTPLOTTER_TEXT_ARRAY(endpointText, IOTPLOTTER_POST_ENDPOINT);
+IOTPLOTTER_TEXT_ARRAY(csvSuffixText, ".csv");
+IOTPLOTTER_TEXT_ARRAY(httpVersionText, " HTTP/1.1");
+IOTPLOTTER_TEXT_ARRAY(keepAliveText, "\r\nConnection: keep-alive");
+IOTPLOTTER_TEXT_ARRAY(closeText, "\r\nConnection: Close");
+IOTPLOTTER_TEXT_ARRAY(apiKeyText, IOTPLOTTER_API_HEADER);
+IOTPLOTTER_TEXT_ARRAY(contentTypeText, IOTPLOTTER_CONTENT_TYPE_HEADER);
+IOTPLOTTER_TEXT_ARRAY(hostText, "\r\nHost: ");
+IOTPLOTTER_TEXT_ARRAY(contentLengthText, IOTPLOTTER_CONTENT_LENGTH_HEADER);
+IOTPLOTTER_TEXT_ARRAY(endHeadersText, "\r\n\r\n");
+
+IoTPlotterText IoTPlotterSerializer::postTag          = IOTPLOTTER_TEXT(postText);
+IoTPlotterText IoTPlotterSerializer::httpSchemeTag    = IOTPLOTTER_TEXT(httpSchemeText);
+IoTPlotterText IoTPlotterSerializer::httpsSchemeTag   = IOTPLOTTER_TEXT(httpsSchemeText);
+IoTPlotterText IoTPlotterSerializer::endpointTag      = IOTPLOTTER_TEXT(endpointText);
+IoTPlotterText IoTPlotterSerializer::csvSuffixTag     = IOTPLOTTER_TEXT(csvSuffixText);
+IoTPlotterText IoTPlotterSerializer::httpVersionTag   = IOTPLOTTER_TEXT(httpVersionText);
+IoTPlotterText IoTPlotterSerializer::keepAliveTag     = IOTPLOTTER_TEXT(keepAliveText);
+IoTPlotterText IoTPlotterSerializer::closeTag         = IOTPLOTTER_TEXT(closeText);
+IoTPlotterText IoTPlotterSerializer::apiKeyTag        = IOTPLOTTER_TEXT(apiKeyText);
+IoTPlotterText IoTPlotterSerializer::contentTypeTag   = IOTPLOTTER_TEXT(contentTypeText);
+IoTPlotterText IoTPlotterSerializer::hostTag          = IOTPLOTTER_TEXT(hostText);
+IoTPlotterText IoTPlotterSerializer::contentLengthTag = IOTPLOTTER_TEXT(contentLengthText);
+IoTPlotterText IoTPlotterSerializer::endHeadersTag    = IOTPLOTTER_TEXT(endHeadersText);
+
+
+void IoTPlotterSnapshot::clear(uint8_t firstVar) {
+    _used      = 0;
+    _items     = 0;
+    _codeItems = 0;
+    _varCount  = 0;
+    _firstVar  = firstVar;
+    memset(_omitted, 0, sizeof(_omitted));
+}
+
+
+void IoTPlotterSnapshot::clearSamples(void) {
+    _items    = _codeItems;
+    _used     = _codeItems > 0 ? itemEnd(_codeItems - 1) : 0;
+    _varCount = _codeItems;
+    memset(_omitted, 0, sizeof(_omitted));
+}
+
+
+bool IoTPlotterSnapshot::addVarCode(const char* text, size_t length) {
+    // Var codes all come before the first sample
+    if (_items != _codeItems || !add(text, length)) return false;
+    _codeItems++;
+    _varCount = _codeItems;
+    return true;
+}
+
+
+bool IoTPlotterSnapshot::addEpoch(uint32_t epoch) {
+    // Formatted once here, then written out after every value of the sample
+    char digits[10];
+    return add(digits, IoTPlotterFormat::formatUnsigned(digits, epoch));
+}
+
+
+bool IoTPlotterSnapshot::addValue(const char* text, size_t length) {
+    return add(text, length);
+}
+
+
+void IoTPlotterSnapshot::discardPartialSample(void) {
+    uint16_t complete = _codeItems + sampleCount() * (_varCount + 1);
+    if (_items > complete) {
+        _items = complete;
+        _used  = complete > 0 ? itemEnd(complete - 1) : 0;
+    }
+}
+
+
+void IoTPlotterSnapshot::keepVarCodes(uint8_t count) {
+    if (count < _codeItems) _codeItems = count;
+    clearSamples();
+}
+
+
+uint8_t IoTPlotterSnapshot::graphCount(void) const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < _varCount; i++) {
+        if (!isOmitted(i)) count++;
+    }
+    return count;
+}
+
+
+uint8_t IoTPlotterSnapshot::sampleCount(void) const {
+    if (_items <= _codeItems) return 0;
+    return (_items - _codeItems) / (_varCount + 1);
+}
+
+
+bool IoTPlotterSnapshot::add(const char* text, size_t length) {
+    // Room is needed for the text at the front and its index entry at the back
+    size_t free = _capacity - _used - sizeof(uint16_t) * _items;
+    if (length + sizeof(uint16_t) > free) return false;
+    memcpy(_arena + _used, text, length);
+    _used += length;
+    _items++;
+    memcpy(_arena + _capacity - sizeof(uint16_t) * _items, &_used,
+           sizeof(uint16_t));
+    return true;
+}
+
+
+uint16_t IoTPlotterSnapshot::itemEnd(uint16_t index) const {
+    uint16_t end;
+    memcpy(&end, _arena + _capacity - sizeof(uint16_t) * (index + 1),
+           sizeof(uint16_t));
+    return end;
+}
+
+
+const char* IoTPlotterSnapshot::item(uint16_t index, uint16_t& length) const {
+    uint16_t start = index > 0 ? itemEnd(index - 1) : 0;
+    length         = itemEnd(index) - start;
+    return _arena + start;
+}
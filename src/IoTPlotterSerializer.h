@@ -0,0 +1,888 @@
+/**
+ * @file IoTPlotterSerializer.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterSnapshot of the text to publish, the
+ * IoTPlotterSerializer that lays it out as IoTPlotter JSON, and the sinks the
+ * serializer can write to.
+ *
+ * The serializer is a template on its sink.  A sink is any class with a
+ * `size_t write(const char* data, size_t length)` member.  Measuring the body
+ * for the Content-Length header and writing it out are then the very same
+ * code run against a counting sink and an output sink, so they cannot drift
+ * apart.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERSERIALIZER_H_
+#define SRC_PUBLISHERS_IOTPLOTTERSERIALIZER_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+#include "IoTPlotterFormat.h"
+#include "IoTPlotterTls.h"
+
+/**
+ * @def IOTPLOTTER_LOW_MEMORY
+ * @brief Define this (for example with `-D IOTPLOTTER_LOW_MEMORY` in the
+ * build flags) to trade a little speed for RAM.
+ *
+ * On an Arduino, every fixed piece of the request and the JSON then stays in
+ * flash and is copied out a few bytes at a time as it is written, where
+ * otherwise the AVR boards copy it all into RAM at start up.  The request
+ * header block is also no longer cached in RAM, unless
+ * #IOTPLOTTER_HEADER_CACHE_SIZE is set.
+ *
+ * The host name stays in RAM either way, since the Client's connect() needs
+ * it there.
+ */
+#if defined(IOTPLOTTER_LOW_MEMORY) && defined(ARDUINO)
+#define IOTPLOTTER_FLASH_TEXT
+#endif
+
+#if defined(IOTPLOTTER_FLASH_TEXT)
+/**
+ * @brief A fixed piece of text, kept in flash in low-memory mode.
+ */
+typedef const __FlashStringHelper* IoTPlotterText;
+/**
+ * @brief Define a file scope array holding a fixed piece of text
+ */
+#define IOTPLOTTER_TEXT_ARRAY(name, text) static const char name[] PROGMEM = text
+/**
+ * @brief Turn an array made with #IOTPLOTTER_TEXT_ARRAY into an
+ * IoTPlotterText
+ */
+#define IOTPLOTTER_TEXT(name) reinterpret_cast<IoTPlotterText>(name)
+#else
+typedef const char* IoTPlotterText;
+#define IOTPLOTTER_TEXT_ARRAY(name, text) static const char name[] = text
+#define IOTPLOTTER_TEXT(name) (name)
+#endif
+
+/**
+ * @brief The number of bytes of RAM set aside by each IoTPlotter publisher to
+ * hold the text of one publish.
+ *
+ * The snapshot holds the var codes, and the epoch and formatted value of
+ * every sample, plus two bytes of index per item.  When batching, samples
+ * that don't fit are left for the next post.  Variables that don't fit are
+ * posted in further requests carrying the same samples; their var codes are
+ * then fetched from the logger again for each publish, so size the snapshot
+ * to hold everything where RAM allows.  A var code too long to be held even
+ * on its own isn't copied into the snapshot at all; it is streamed from the
+ * logger a piece at a time each time the request is written.
+ */
+#ifndef IOTPLOTTER_SNAPSHOT_SIZE
+#if defined(__AVR__)
+#define IOTPLOTTER_SNAPSHOT_SIZE 512
+#else
+#define IOTPLOTTER_SNAPSHOT_SIZE 1536
+#endif
+#endif
+
+/**
+ * @anchor iotplotter_header_pieces
+ * @name The fixed pieces of the request headers
+ *
+ * These are macros so that a complete header block can be joined together by
+ * the compiler with #IOTPLOTTER_REQUEST_HEADER.  They live here, with the
+ * rest of the wire format, so that code outside the Arduino build (like the
+ * IoTPlotterGateway) can use them too.
+ *
+ * @{
+ */
+#define IOTPLOTTER_HOST "iotplotter.com"
+#define IOTPLOTTER_POST_ENDPOINT "/api/v2/feed/"
+#define IOTPLOTTER_API_HEADER "\r\napi-key: "
+#define IOTPLOTTER_CONTENT_TYPE_HEADER \
+    "\r\nContent-Type: application/x-www-form-urlencoded"
+#define IOTPLOTTER_CONTENT_LENGTH_HEADER "\r\nContent-Length: "
+/**@}*/
+
+
+/**
+ * @brief Copies a piece of a var code that is too long to be held in a
+ * snapshot, straight from wherever it lives.
+ *
+ * @param context The context given to IoTPlotterSnapshot::setCodeSource()
+ * @param position The variable's position in the logger's variable array
+ * @param offset The offset in the var code of the first byte to copy
+ * @param buffer Where to copy the bytes to
+ * @param length The most bytes to copy
+ * @return **size_t** The number of bytes copied; 0 once past the end
+ */
+typedef size_t (*IoTPlotterCodeSource)(void* context, uint8_t position,
+                                       size_t offset, char* buffer,
+                                       size_t length);
+
+
+/**
+ * @brief A fixed arena holding the text of everything in one publish: the var
+ * codes, and the epoch and formatted values of each sample.
+ *
+ * Each value is formatted once, when the snapshot is taken, and then read
+ * back as often as needed to measure and write the request.
+ *
+ * The text grows from the front of the arena and an index of where each item
+ * ends grows from the back, so the only limit is the total size.  Items are
+ * added in order: every var code, then for each sample its epoch followed by
+ * one value per var code.  The var codes may be a run from the middle of the
+ * logger's variable array, starting at firstVar(), when they don't all fit.
+ * An empty var code is taken to be one too long to hold, and is read from the
+ * code source (see setCodeSource()) as it is written.
+ *
+ * The arena itself comes from an IoTPlotterSnapshotBuffer, whose size is
+ * fixed at compile time; everything that reads or fills a snapshot works on
+ * this class, whatever its size.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterSnapshot {
+ public:
+    /**
+     * @brief Empty the snapshot
+     *
+     * @param firstVar The position in the logger's variable array of the
+     * first var code to be added
+     */
+    void clear(uint8_t firstVar = 0);
+    /**
+     * @brief Empty the snapshot of samples, keeping the var codes
+     *
+     * The var codes don't change between posts, so they only have to be
+     * fetched from the logger once.
+     */
+    void clearSamples(void);
+
+    /**
+     * @brief Add the next var code
+     *
+     * @param text The var code
+     * @param length The length of the var code
+     * @return **bool** True if it fit
+     */
+    bool addVarCode(const char* text, size_t length);
+    /**
+     * @brief Start a new sample
+     *
+     * @param epoch The sample's epoch time
+     * @return **bool** True if it fit
+     */
+    bool addEpoch(uint32_t epoch);
+    /**
+     * @brief Add the next value of the current sample
+     *
+     * @param text The formatted value
+     * @param length The length of the formatted value
+     * @return **bool** True if it fit
+     */
+    bool addValue(const char* text, size_t length);
+    /**
+     * @brief Forget the values of a sample that could not be finished
+     */
+    void discardPartialSample(void);
+    /**
+     * @brief Keep only the first var codes, and none of the samples
+     *
+     * The room taken by the other var codes is freed, so that the samples
+     * can be added again with fewer values each.
+     *
+     * @param count The number of var codes to keep
+     */
+    void keepVarCodes(uint8_t count);
+
+    /**
+     * @brief Set where the var codes too long to hold are read from
+     *
+     * @param source The function that copies out a piece of a var code;
+     * nullptr to write empty var codes as they are
+     * @param context Passed back to the function
+     */
+    void setCodeSource(IoTPlotterCodeSource source, void* context) {
+        _codeSource  = source;
+        _codeContext = context;
+    }
+    /**
+     * @brief Copy out a piece of a var code that's too long to hold
+     *
+     * @param varNum The variable number
+     * @param offset The offset in the var code of the first byte to copy
+     * @param buffer Where to copy the bytes to
+     * @param length The most bytes to copy
+     * @return **size_t** The number of bytes copied; 0 once past the end, or
+     * if there is no code source
+     */
+    size_t copyStreamedCode(uint8_t varNum, size_t offset, char* buffer,
+                            size_t length) const {
+        if (_codeSource == nullptr) return 0;
+        return _codeSource(_codeContext, _firstVar + varNum, offset, buffer,
+                           length);
+    }
+
+    /**
+     * @brief Leave a variable's graph out of the JSON.
+     *
+     * The variable keeps its place (and its values, which may be empty) in
+     * the snapshot; the serializer just skips it, so the measured and the
+     * written body always agree.
+     *
+     * @param varNum The variable number
+     */
+    void omitVar(uint8_t varNum) {
+        _omitted[varNum / 8] |= static_cast<uint8_t>(1 << (varNum % 8));
+    }
+    /**
+     * @brief Check whether a variable's graph is left out
+     *
+     * @param varNum The variable number
+     * @return **bool** True if omitVar() was called for it
+     */
+    bool isOmitted(uint8_t varNum) const {
+        return (_omitted[varNum / 8] & (1 << (varNum % 8))) != 0;
+    }
+    /**
+     * @brief Get the number of graphs that will be written
+     *
+     * @return **uint8_t** The number of variables that aren't omitted
+     */
+    uint8_t graphCount(void) const;
+
+    /**
+     * @brief Get the number of variables
+     *
+     * @return **uint8_t** The number of var codes in use
+     */
+    uint8_t varCount(void) const {
+        return _varCount;
+    }
+    /**
+     * @brief Get the number of var codes held
+     *
+     * @return **uint8_t** The number of var codes added
+     */
+    uint8_t codeCount(void) const {
+        return _codeItems;
+    }
+    /**
+     * @brief Get the position of the first var code in the logger's
+     * variable array
+     *
+     * @return **uint8_t** The position given to clear()
+     */
+    uint8_t firstVar(void) const {
+        return _firstVar;
+    }
+    /**
+     * @brief Get the number of complete samples
+     *
+     * @return **uint8_t** The number of samples
+     */
+    uint8_t sampleCount(void) const;
+
+    /**
+     * @brief Get a var code
+     *
+     * @param varNum The variable number
+     * @param length Set to the length of the var code
+     * @return **const char*** The var code (not null terminated)
+     */
+    const char* varCode(uint8_t varNum, uint16_t& length) const {
+        return item(varNum, length);
+    }
+    /**
+     * @brief Get the epoch of a sample as text
+     *
+     * @param sample The sample number
+     * @param length Set to the length of the text
+     * @return **const char*** The epoch (not null terminated)
+     */
+    const char* epoch(uint8_t sample, uint16_t& length) const {
+        return item(_codeItems + sample * (_varCount + 1), length);
+    }
+    /**
+     * @brief Get a formatted value
+     *
+     * @param sample The sample number
+     * @param varNum The variable number
+     * @param length Set to the length of the value
+     * @return **const char*** The value (not null terminated)
+     */
+    const char* value(uint8_t sample, uint8_t varNum, uint16_t& length) const {
+        return item(_codeItems + sample * (_varCount + 1) + 1 + varNum,
+                    length);
+    }
+
+ private:
+    bool        add(const char* text, size_t length);
+    const char* item(uint16_t index, uint16_t& length) const;
+    uint16_t    itemEnd(uint16_t index) const;
+
+    char*    _arena;
+    uint16_t _capacity;
+    uint16_t _used      = 0;  ///< Bytes of text at the front of the arena
+    uint16_t _items     = 0;  ///< Entries in the index at the back
+    uint8_t  _codeItems = 0;  ///< Var codes added before the first sample
+    uint8_t  _varCount  = 0;  ///< Var codes with a value in each sample
+    uint8_t  _firstVar  = 0;  ///< Logger position of the first var code
+    uint8_t  _omitted[32] = {};  ///< One bit per variable left out
+    IoTPlotterCodeSource _codeSource  = nullptr;
+    void*                _codeContext = nullptr;
+
+ protected:
+    /**
+     * @brief Construct a new snapshot over an arena
+     *
+     * @param arena The memory to hold the text and its index
+     * @param capacity The size of the arena; at most 65535
+     */
+    IoTPlotterSnapshot(char* arena, uint16_t capacity)
+        : _arena(arena),
+          _capacity(capacity) {}
+};
+
+
+/**
+ * @brief An IoTPlotterSnapshot with its own arena.
+ *
+ * @tparam Size The size of the arena in bytes, at most 65535
+ *
+ * @ingroup the_publishers
+ */
+template <uint16_t Size = IOTPLOTTER_SNAPSHOT_SIZE>
+class IoTPlotterSnapshotBuffer : public IoTPlotterSnapshot {
+ public:
+    /**
+     * @brief Construct a new, empty snapshot
+     */
+    IoTPlotterSnapshotBuffer() : IoTPlotterSnapshot(_storage, Size) {}
+    // The snapshot points into its own storage, so it can't be copied
+    IoTPlotterSnapshotBuffer(const IoTPlotterSnapshotBuffer&) = delete;
+    IoTPlotterSnapshotBuffer& operator=(const IoTPlotterSnapshotBuffer&) = delete;
+
+ private:
+    char _storage[Size];
+};
+
+
+/**
+ * @brief A sink that only counts the bytes written to it.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterCountingSink {
+ public:
+    /**
+     * @brief Count a run of bytes
+     *
+     * @param data Unused
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes
+     */
+    size_t write(const char* data, size_t length) {
+        (void)data;
+        _count += length;
+        return length;
+    }
+    /**
+     * @brief Get the number of bytes written so far
+     *
+     * @return **uint32_t** The number of bytes
+     */
+    uint32_t count(void) const {
+        return _count;
+    }
+
+ private:
+    uint32_t _count = 0;
+};
+
+
+/**
+ * @brief A sink that copies into a fixed block of memory.
+ *
+ * Bytes that don't fit are dropped, and the sink remembers that they were.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterBufferSink {
+ public:
+    /**
+     * @brief Construct a new buffer sink
+     *
+     * @param buffer The memory to copy into
+     * @param capacity The size of the memory
+     */
+    IoTPlotterBufferSink(char* buffer, size_t capacity)
+        : _buffer(buffer),
+          _capacity(capacity) {}
+    /**
+     * @brief Copy as much of a run of bytes as fits
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes copied
+     */
+    size_t write(const char* data, size_t length) {
+        size_t room = _capacity - _length;
+        if (length > room) {
+            _overflowed = true;
+            length      = room;
+        }
+        memcpy(_buffer + _length, data, length);
+        _length += length;
+        return length;
+    }
+    /**
+     * @brief Get the number of bytes copied
+     *
+     * @return **size_t** The number of bytes in the buffer
+     */
+    size_t length(void) const {
+        return _length;
+    }
+    /**
+     * @brief Check whether anything had to be dropped
+     *
+     * @return **bool** True if more was written than fit
+     */
+    bool overflowed(void) const {
+        return _overflowed;
+    }
+
+ private:
+    char*  _buffer;
+    size_t _capacity;
+    size_t _length     = 0;
+    bool   _overflowed = false;
+};
+
+
+/**
+ * @brief A sink that passes on only one window of the bytes written to it.
+ *
+ * Running the serializer into a window sink again and again, moving the
+ * window along each time, hands out a long request one piece at a time
+ * without having to hold the serializer's place in between.
+ *
+ * @tparam Sink The type of the sink the window's bytes are passed to
+ *
+ * @ingroup the_publishers
+ */
+template <typename Sink>
+class IoTPlotterWindowSink {
+ public:
+    /**
+     * @brief Construct a new window sink
+     *
+     * @param inner The sink to pass the window's bytes to
+     * @param start The offset of the first byte to pass on
+     * @param length The most bytes to pass on
+     */
+    IoTPlotterWindowSink(Sink& inner, uint32_t start, uint32_t length)
+        : _inner(inner),
+          _start(start),
+          _end(start + length) {}
+    /**
+     * @brief Pass on whatever part of a run of bytes falls in the window
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes, whether passed on or not
+     */
+    size_t write(const char* data, size_t length) {
+        uint32_t from = _position > _start ? _position : _start;
+        uint32_t to   = _position + length < _end ? _position + length : _end;
+        if (from < to) {
+            _inner.write(data + (from - _position), to - from);
+            _passed += to - from;
+        }
+        _position += length;
+        return length;
+    }
+    /**
+     * @brief Get the number of bytes passed on
+     *
+     * @return **uint32_t** The number of bytes in the window
+     */
+    uint32_t passed(void) const {
+        return _passed;
+    }
+
+ private:
+    Sink&    _inner;
+    uint32_t _start;
+    uint32_t _end;
+    uint32_t _position = 0;
+    uint32_t _passed   = 0;
+};
+
+
+#if defined(ARDUINO)
+/**
+ * @brief A sink that writes straight through to an Arduino Stream.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterStreamSink {
+ public:
+    /**
+     * @brief Construct a new stream sink
+     *
+     * @param stream The stream to write to
+     */
+    explicit IoTPlotterStreamSink(Stream* stream) : _stream(stream) {}
+    /**
+     * @brief Write a run of bytes to the stream
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes written
+     */
+    size_t write(const char* data, size_t length) {
+        return _stream->write(reinterpret_cast<const uint8_t*>(data), length);
+    }
+
+ private:
+    Stream* _stream;
+};
+#endif
+
+
+/**
+ * @brief Lays out the contents of an IoTPlotterSnapshot as the JSON body
+ * IoTPlotter expects.
+ *
+ * Every variable becomes a graph, named by its var code, holding one
+ * value/epoch pair per sample:
+ *
+ * `{"data":{"CODE":[{"value":1.2, "epoch":1650000000},...],...}}`
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterSerializer {
+ public:
+    /**
+     * @brief Write the JSON body for a snapshot
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param snapshot The snapshot to write out
+     * @param varMask One bit per variable to include; nullptr for all of
+     * them.  See isIncluded().
+     */
+    template <typename Sink>
+    static void writeJson(Sink& sink, const IoTPlotterSnapshot& snapshot,
+                          const uint8_t* varMask = nullptr);
+    /**
+     * @brief Write the CSV body for a snapshot
+     *
+     * A header row naming the epoch column and each graph, then one row per
+     * sample.  Each epoch is written once per sample rather than once per
+     * value, and the names once per post, so the body is a good deal smaller
+     * than the JSON for batches and long variable lists.
+     *
+     * `epoch,CODE1,CODE2\n1650000000,1.2,3.4\n...`
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param snapshot The snapshot to write out
+     * @param varMask One bit per variable to include; nullptr for all of
+     * them.  See isIncluded().
+     */
+    template <typename Sink>
+    static void writeCsv(Sink& sink, const IoTPlotterSnapshot& snapshot,
+                         const uint8_t* varMask = nullptr);
+
+    /**
+     * @brief Check whether a variable's graph is written out
+     *
+     * @param snapshot The snapshot being written
+     * @param varMask One bit per variable in the logger's variable array,
+     * the lowest bit of the first byte for the first variable; nullptr to
+     * include every variable
+     * @param varNum The position of the variable in the snapshot
+     * @return **bool** True if the variable is in the mask and hasn't been
+     * omitted from the snapshot
+     */
+    static bool isIncluded(const IoTPlotterSnapshot& snapshot,
+                           const uint8_t* varMask, uint8_t varNum) {
+        if (snapshot.isOmitted(varNum)) return false;
+        uint16_t position = snapshot.firstVar() + varNum;
+        return varMask == nullptr ||
+            (varMask[position / 8] & (1 << (position % 8))) != 0;
+    }
+
+    /**
+     * @brief Write a var code to a sink, from the snapshot or, when it's too
+     * long to be held there, from its code source a piece at a time
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param snapshot The snapshot being written
+     * @param varNum The variable number
+     */
+    template <typename Sink>
+    static void writeVarCode(Sink& sink, const IoTPlotterSnapshot& snapshot,
+                             uint8_t varNum);
+    /**
+     * @brief Write a null terminated string to a sink
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param text The text
+     */
+    template <typename Sink>
+    static void writeText(Sink& sink, const char* text) {
+        if (text != nullptr) sink.write(text, strlen(text));
+    }
+#if defined(ARDUINO)
+    /**
+     * @brief Write a string kept in flash to a sink, a few bytes at a time
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param text The text, from F() or #IOTPLOTTER_TEXT
+     */
+    template <typename Sink>
+    static void writeText(Sink& sink, const __FlashStringHelper* text);
+#endif
+    /**
+     * @brief Write the base 10 text of an unsigned integer to a sink
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param value The number
+     */
+    template <typename Sink>
+    static void writeUnsigned(Sink& sink, uint32_t value);
+
+    /**
+     * @brief Write a post's request line and the headers that stay the same
+     * from post to post, up to and including the Host header
+     *
+     * The publisher and the IoTPlotterGateway both lay out their requests
+     * with this, so they send the very same headers.
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param host The server's host name
+     * @param port The server's port
+     * @param tls True for an https:// request
+     * @param feedID The feed posted to
+     * @param csv True to post to the feed's `.csv` endpoint
+     * @param keepAlive True to ask for the connection to be kept open
+     * @param apiKey The feed's API key
+     */
+    template <typename Sink>
+    static void writeHeaderBlock(Sink& sink, const char* host, uint16_t port,
+                                 bool tls, const char* feedID, bool csv,
+                                 bool keepAlive, const char* apiKey);
+    /**
+     * @brief Write a host name, followed by its port unless that is the
+     * default for the scheme
+     *
+     * @tparam Sink The type of the sink
+     * @param sink The sink to write to
+     * @param host The host name
+     * @param port The port
+     * @param tls True if the default is #IOTPLOTTER_TLS_PORT rather than 80
+     */
+    template <typename Sink>
+    static void writeAuthority(Sink& sink, const char* host, uint16_t port,
+                               bool tls);
+
+    /**
+     * @anchor iotplotter_request_vars
+     * @name Portions of the request headers for IoTPlotter.com
+     *
+     * @{
+     */
+    static IoTPlotterText postTag;         ///< Starts the request line
+    static IoTPlotterText httpSchemeTag;   ///< The scheme of a plain post
+    static IoTPlotterText httpsSchemeTag;  ///< The scheme of a post over TLS
+    static IoTPlotterText endpointTag;     ///< The path up to the feed ID
+    static IoTPlotterText csvSuffixTag;    ///< Follows the feed ID for CSV
+    static IoTPlotterText httpVersionTag;  ///< Ends the request line
+    static IoTPlotterText keepAliveTag;    ///< Asks to keep the connection
+    static IoTPlotterText closeTag;        ///< Asks to close the connection
+    static IoTPlotterText apiKeyTag;       ///< Comes before the API key
+    static IoTPlotterText contentTypeTag;  ///< The whole content type header
+    static IoTPlotterText hostTag;         ///< Comes before the host name
+    static IoTPlotterText contentLengthTag;  ///< Comes before the length
+    static IoTPlotterText endHeadersTag;   ///< Ends the last header
+    /**@}*/
+
+    /**
+     * @anchor iotplotter_json_vars
+     * @name Portions of the JSON object for IoTPlotter.com
+     *
+     * @{
+     */
+    static IoTPlotterText samplingFeatureTag;  ///< Opens the data object and the first graph name
+    static IoTPlotterText JSONvalueTag;  ///< Closes a graph name and starts its first value
+    static IoTPlotterText nextValueTag;  ///< Starts the next sample of a graph
+    static IoTPlotterText epochTag;      ///< Comes between a value and its epoch
+    static IoTPlotterText nextGraphTag;  ///< Closes a graph and opens the next graph name
+    static IoTPlotterText closingTag;    ///< Closes the last graph and the data object
+    static IoTPlotterText emptyTag;      ///< The whole body when there are no graphs
+    static IoTPlotterText csvEpochTag;   ///< Heads the epoch column of a CSV body
+    /**@}*/
+};
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeJson(Sink&                     sink,
+                                     const IoTPlotterSnapshot& snapshot,
+                                     const uint8_t*            varMask) {
+    uint8_t  varCount = snapshot.varCount();
+    uint8_t  samples  = snapshot.sampleCount();
+    bool     first    = true;
+    uint16_t length;
+    const char* text;
+
+    for (uint8_t i = 0; i < varCount; i++) {
+        if (!isIncluded(snapshot, varMask, i)) continue;
+        // The VarCode becomes the GRAPH_NAME on IoTPlotter, following either
+        // the start of the JSON or the previous graph
+        writeText(sink, first ? samplingFeatureTag : nextGraphTag);
+        first = false;
+        writeVarCode(sink, snapshot, i);
+        // One {"value":..., "epoch":...} entry per sample
+        for (uint8_t s = 0; s < samples; s++) {
+            writeText(sink, s == 0 ? JSONvalueTag : nextValueTag);
+            text = snapshot.value(s, i, length);
+            sink.write(text, length);
+            writeText(sink, epochTag);  // , "epoch":
+            text = snapshot.epoch(s, length);
+            sink.write(text, length);
+        }
+    }
+    // Finish off the JSON
+    writeText(sink, first ? emptyTag : closingTag);
+}
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeCsv(Sink&                     sink,
+                                    const IoTPlotterSnapshot& snapshot,
+                                    const uint8_t*            varMask) {
+    uint8_t  varCount = snapshot.varCount();
+    uint8_t  samples  = snapshot.sampleCount();
+    uint16_t length;
+    const char* text;
+
+    // The header row; the var codes become the graph names
+    writeText(sink, csvEpochTag);
+    for (uint8_t i = 0; i < varCount; i++) {
+        if (!isIncluded(snapshot, varMask, i)) continue;
+        sink.write(",", 1);
+        writeVarCode(sink, snapshot, i);
+    }
+    sink.write("\n", 1);
+
+    // One row per sample
+    for (uint8_t s = 0; s < samples; s++) {
+        text = snapshot.epoch(s, length);
+        sink.write(text, length);
+        for (uint8_t i = 0; i < varCount; i++) {
+            if (!isIncluded(snapshot, varMask, i)) continue;
+            sink.write(",", 1);
+            text = snapshot.value(s, i, length);
+            sink.write(text, length);
+        }
+        sink.write("\n", 1);
+    }
+}
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeVarCode(Sink&                     sink,
+                                        const IoTPlotterSnapshot& snapshot,
+                                        uint8_t                   varNum) {
+    uint16_t    length;
+    const char* text = snapshot.varCode(varNum, length);
+    if (length > 0) {
+        sink.write(text, length);
+        return;
+    }
+    char   piece[32];
+    size_t offset = 0;
+    size_t copied;
+    while ((copied = snapshot.copyStreamedCode(varNum, offset, piece,
+                                               sizeof(piece))) > 0) {
+        sink.write(piece, copied);
+        offset += copied;
+    }
+}
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeHeaderBlock(Sink& sink, const char* host,
+                                            uint16_t port, bool tls,
+                                            const char* feedID, bool csv,
+                                            bool        keepAlive,
+                                            const char* apiKey) {
+    // The request line
+    writeText(sink, postTag);                                   // POST
+    writeText(sink, tls ? httpsSchemeTag : httpSchemeTag);      // http://
+    writeAuthority(sink, host, port, tls);                      // iotplotter.com
+    writeText(sink, endpointTag);                               // /api/v2/feed/
+    writeText(sink, feedID);
+    if (csv) writeText(sink, csvSuffixTag);
+    writeText(sink, httpVersionTag);
+
+    // The rest of the HTTP POST headers
+    writeText(sink, keepAlive ? keepAliveTag : closeTag);
+    writeText(sink, apiKeyTag);  // api-key:
+    writeText(sink, apiKey);     // the API key
+    writeText(sink, contentTypeTag);
+    writeText(sink, hostTag);
+    writeAuthority(sink, host, port, tls);  // Host name
+}
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeAuthority(Sink& sink, const char* host,
+                                          uint16_t port, bool tls) {
+    writeText(sink, host);
+    if (port != (tls ? IOTPLOTTER_TLS_PORT : 80)) {
+        sink.write(":", 1);
+        writeUnsigned(sink, port);
+    }
+}
+
+
+template <typename Sink>
+void IoTPlotterSerializer::writeUnsigned(Sink& sink, uint32_t value) {
+    char digits[10];
+    sink.write(digits, IoTPlotterFormat::formatUnsigned(digits, value));
+}
+
+
+#if defined(ARDUINO)
+template <typename Sink>
+void IoTPlotterSerializer::writeText(Sink& sink, const __FlashStringHelper* text) {
+    if (text == nullptr) return;
+    PGM_P  flash  = reinterpret_cast<PGM_P>(text);
+    size_t length = strlen_P(flash);
+    // A small piece at a time, so no more RAM is needed than for a number
+    char piece[16];
+    for (size_t done = 0; done < length; done += sizeof(piece)) {
+        size_t take = length - done < sizeof(piece) ? length - done
+                                                    : sizeof(piece);
+        memcpy_P(piece, flash + done, take);
+        sink.write(piece, take);
+    }
+}
+#endif
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERSERIALIZER_H_
@@ -0,0 +1,137 @@
+/**
+ * @file IoTPlotterStore.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterStore classes.
+ */
+
+#include "IoTPlotterStore.h"
+#if !defined(ARDUINO)
+#include <unistd.h>
+#endif
+
+
+size_t IoTPlotterStoreSink::write(const char* data, size_t length) {
+    size_t remaining = length;
+    while (remaining > 0) {
+        size_t take = _stageSize - _staged;
+        if (take > remaining) take = remaining;
+        memcpy(_stage + _staged, data, take);
+        _staged += take;
+        data += take;
+        remaining -= take;
+        if (_staged == _stageSize) appendStage();
+    }
+    _length += length;
+    return length;
+}
+
+
+bool IoTPlotterStoreSink::finish(void) {
+    if (_staged > 0) appendStage();
+    return !_failed;
+}
+
+
+void IoTPlotterStoreSink::appendStage(void) {
+    if (_store->append(reinterpret_cast<const uint8_t*>(_stage), _staged) !=
+        _staged) {
+        _failed = true;
+    }
+    _staged = 0;
+}
+
+
+#if defined(ARDUINO)
+
+IoTPlotterSdStore::IoTPlotterSdStore(const char* fileName)
+    : _fileName(fileName) {}
+
+
+uint32_t IoTPlotterSdStore::size(void) {
+    File file;
+    if (!file.open(_fileName, O_RDONLY)) return 0;
+    uint32_t fileSize = file.fileSize();
+    file.close();
+    return fileSize;
+}
+
+
+size_t IoTPlotterSdStore::read(uint32_t offset, uint8_t* buffer,
+                               size_t length) {
+    File file;
+    if (!file.open(_fileName, O_RDONLY)) return 0;
+    int didRead = 0;
+    if (file.seekSet(offset)) { didRead = file.read(buffer, length); }
+    file.close();
+    return didRead > 0 ? static_cast<size_t>(didRead) : 0;
+}
+
+
+size_t IoTPlotterSdStore::append(const uint8_t* buffer, size_t length) {
+    File file;
+    if (!file.open(_fileName, O_RDWR | O_CREAT | O_APPEND)) return 0;
+    size_t didWrite = file.write(buffer, length);
+    // Closing the file syncs the new bytes and the directory entry to the card
+    file.close();
+    return didWrite;
+}
+
+
+bool IoTPlotterSdStore::clear(void) {
+    File file;
+    if (!file.open(_fileName, O_RDWR | O_CREAT | O_TRUNC)) return false;
+    file.close();
+    return true;
+}
+
+#else
+
+IoTPlotterFileStore::IoTPlotterFileStore(const char* path) : _path(path) {}
+
+
+uint32_t IoTPlotterFileStore::size(void) {
+    FILE* file = fopen(_path, "rb");
+    if (file == nullptr) return 0;
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fclose(file);
+    return fileSize > 0 ? static_cast<uint32_t>(fileSize) : 0;
+}
+
+
+size_t IoTPlotterFileStore::read(uint32_t offset, uint8_t* buffer,
+                                 size_t length) {
+    FILE* file = fopen(_path, "rb");
+    if (file == nullptr) return 0;
+    size_t didRead = 0;
+    if (fseek(file, static_cast<long>(offset), SEEK_SET) == 0) {
+        didRead = fread(buffer, 1, length, file);
+    }
+    fclose(file);
+    return didRead;
+}
+
+
+size_t IoTPlotterFileStore::append(const uint8_t* buffer, size_t length) {
+    FILE* file = fopen(_path, "ab");
+    if (file == nullptr) return 0;
+    size_t didWrite = fwrite(buffer, 1, length, file);
+    // Make sure the bytes reach the disk before reporting them written
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+    return didWrite;
+}
+
+
+bool IoTPlotterFileStore::clear(void) {
+    FILE* file = fopen(_path, "wb");
+    if (file == nullptr) return false;
+    fclose(file);
+    return true;
+}
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @file IoTPlotterStore.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterStore interface for persistent, append-only
+ * byte storage and its implementations for an SD card (on an Arduino) and a
+ * plain file (on a Linux host).
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERSTORE_H_
+#define SRC_PUBLISHERS_IOTPLOTTERSTORE_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <SdFat.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+
+/**
+ * @brief A persistent run of bytes that can be appended to, read back at any
+ * offset, and emptied.
+ *
+ * This is all the IoTPlotter publisher needs from a file, so that the same
+ * code can keep its data on an SD card or flash chip on the logger and in an
+ * ordinary file on a desktop.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterStore {
+ public:
+    /**
+     * @brief Destroy the store object
+     */
+    virtual ~IoTPlotterStore() {}
+
+    /**
+     * @brief Get the number of bytes held in the store
+     *
+     * @return **uint32_t** The size of the store, 0 if it can't be opened
+     */
+    virtual uint32_t size(void) = 0;
+    /**
+     * @brief Read bytes back from the store
+     *
+     * @param offset The position of the first byte to read
+     * @param buffer The buffer to read into
+     * @param length The number of bytes to read
+     * @return **size_t** The number of bytes actually read
+     */
+    virtual size_t read(uint32_t offset, uint8_t* buffer, size_t length) = 0;
+    /**
+     * @brief Add bytes to the end of the store
+     *
+     * The bytes must be committed to the medium before this returns.
+     *
+     * @param buffer The bytes to add
+     * @param length The number of bytes to add
+     * @return **size_t** The number of bytes written
+     */
+    virtual size_t append(const uint8_t* buffer, size_t length) = 0;
+    /**
+     * @brief Empty the store
+     *
+     * @return **bool** True if the store is now empty
+     */
+    virtual bool clear(void) = 0;
+};
+
+
+/**
+ * @brief A serializer sink that appends to an IoTPlotterStore, a block at a
+ * time.
+ *
+ * Bytes are gathered in a staging buffer and appended whenever it fills, so
+ * the medium sees a few large writes rather than many small ones.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterStoreSink {
+ public:
+    /**
+     * @brief Construct a new store sink
+     *
+     * @param store The store to append to
+     * @param stage The staging buffer
+     * @param stageSize The size of the staging buffer
+     */
+    IoTPlotterStoreSink(IoTPlotterStore* store, char* stage, size_t stageSize)
+        : _store(store),
+          _stage(stage),
+          _stageSize(stageSize) {}
+    /**
+     * @brief Stage a run of bytes, appending the stage to the store each time
+     * it fills
+     *
+     * @param data The bytes
+     * @param length The number of bytes
+     * @return **size_t** The number of bytes taken
+     */
+    size_t write(const char* data, size_t length);
+    /**
+     * @brief Append whatever is still staged
+     *
+     * @return **bool** True if every byte reached the store
+     */
+    bool finish(void);
+    /**
+     * @brief Get the number of bytes written to the sink
+     *
+     * @return **uint32_t** The number of bytes
+     */
+    uint32_t length(void) const {
+        return _length;
+    }
+
+ private:
+    void appendStage(void);
+
+    IoTPlotterStore* _store;
+    char*            _stage;
+    size_t           _stageSize;
+    size_t           _staged = 0;
+    uint32_t         _length = 0;
+    bool             _failed = false;
+};
+
+
+#if defined(ARDUINO)
+/**
+ * @brief An IoTPlotterStore kept in a file on the logger's SD card (or any
+ * other volume mounted through SdFat).
+ *
+ * The file is opened and closed for every operation, exactly like the
+ * logger's own data file, so the card may be powered down between calls.
+ * The card must already have been initialized by the logger.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterSdStore : public IoTPlotterStore {
+ public:
+    /**
+     * @brief Construct a new SD card store
+     *
+     * @param fileName The name of the file to keep the bytes in.  The pointer
+     * must remain valid for the life of the store.
+     */
+    explicit IoTPlotterSdStore(const char* fileName);
+
+    uint32_t size(void) override;
+    size_t   read(uint32_t offset, uint8_t* buffer, size_t length) override;
+    size_t   append(const uint8_t* buffer, size_t length) override;
+    bool     clear(void) override;
+
+ private:
+    const char* _fileName;
+};
+#else
+/**
+ * @brief An IoTPlotterStore kept in an ordinary file on a desktop or Linux
+ * host.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterFileStore : public IoTPlotterStore {
+ public:
+    /**
+     * @brief Construct a new file store
+     *
+     * @param path The path of the file to keep the bytes in.  The pointer
+     * must remain valid for the life of the store.
+     */
+    explicit IoTPlotterFileStore(const char* path);
+
+    uint32_t size(void) override;
+    size_t   read(uint32_t offset, uint8_t* buffer, size_t length) override;
+    size_t   append(const uint8_t* buffer, size_t length) override;
+    bool     clear(void) override;
+
+ private:
+    const char* _path;
+};
+#endif
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERSTORE_H_
@@ -0,0 +1,66 @@
+/**
+ * @file IoTPlotterTls.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterTlsAdapter class.
+ */
+
+#include "IoTPlotterTls.h"
+#include <string.h>
+
+
+void IoTPlotterTlsAdapter::beginConnect(const char* host, uint16_t port) {
+    // The server's own slot if it has one, otherwise a free one or the one
+    // used longest ago
+    uint8_t slot   = IOTPLOTTER_TLS_SESSIONS;
+    uint8_t oldest = 0;
+    for (uint8_t i = 0; i < IOTPLOTTER_TLS_SESSIONS; i++) {
+        if (_hosts[i] == nullptr) {
+            oldest = i;
+            continue;
+        }
+        if (_ports[i] == port && strcmp(_hosts[i], host) == 0) {
+            slot = i;
+            break;
+        }
+        // Ages are compared as differences so the clock may roll over
+        if (_hosts[oldest] != nullptr &&
+            static_cast<uint8_t>(_clock - _used[i]) >
+                static_cast<uint8_t>(_clock - _used[oldest])) {
+            oldest = i;
+        }
+    }
+    if (slot == IOTPLOTTER_TLS_SESSIONS) {
+        slot         = oldest;
+        _hosts[slot] = host;
+        _ports[slot] = port;
+        _saved &= ~(1 << slot);
+    }
+    _used[slot] = ++_clock;
+    _slot       = slot;
+    _offered    = _saved & (1 << slot);
+    if (_offered) {
+        offerSession(slot);
+    } else {
+        offerNoSession();
+    }
+}
+
+
+bool IoTPlotterTlsAdapter::endConnect(bool connected) {
+    if (!connected) {
+        // Don't offer a session the server may have turned down again
+        _saved &= ~(1 << _slot);
+        return false;
+    }
+    bool resumed = keepSession(_slot);
+    _saved |= 1 << _slot;
+    return _offered && resumed;
+}
+
+
+void IoTPlotterTlsAdapter::forgetSessions(void) {
+    _saved = 0;
+}
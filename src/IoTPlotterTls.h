@@ -0,0 +1,147 @@
+/**
+ * @file IoTPlotterTls.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterTlsAdapter class, which lets the publisher
+ * resume TLS sessions with whichever TLS client library is in use.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERTLS_H_
+#define SRC_PUBLISHERS_IOTPLOTTERTLS_H_
+
+// Included Dependencies
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/**
+ * @brief The port posts go to over TLS, unless a destination sets its own.
+ */
+#ifndef IOTPLOTTER_TLS_PORT
+#define IOTPLOTTER_TLS_PORT 443
+#endif
+/**
+ * @brief The number of servers a TLS adapter keeps a session for: by
+ * default, the feed's own and one for each mirror.  At most 8.
+ */
+#ifndef IOTPLOTTER_TLS_SESSIONS
+#define IOTPLOTTER_TLS_SESSIONS 3
+#endif
+
+
+/**
+ * @brief The glue between the publisher and a TLS client, for caching and
+ * resuming sessions.
+ *
+ * A full TLS handshake costs a couple of round trips and several kilobytes
+ * of certificates, which is far more than the post itself when one sample is
+ * sent per connection.  If the client offers the server a session (an ID or
+ * ticket) saved from an earlier connection, the server can skip all of that
+ * and the handshake is abbreviated.
+ *
+ * The Arduino Client interface has no notion of sessions, and every TLS
+ * library keeps them differently, so this adapter stands between the two.
+ * Subclass it for the TLS client in use, implementing offerSession(),
+ * offerNoSession() and keepSession() with that library's calls, and give it
+ * to IoTPlotterPublisher::setTls().  IoTPlotterBearSslAdapter already does
+ * this for BearSSL clients like the ESP8266's.  The TLS client itself is what is passed
+ * to the publisher as its Client.
+ *
+ * The adapter sorts the sessions out by server: each host and port gets one
+ * of #IOTPLOTTER_TLS_SESSIONS numbered slots, and the subclass only has to
+ * store a session per slot.  When there are more servers than slots, the
+ * slot used longest ago is given up.  A session is thrown away after a
+ * connection attempt that used it fails, in case the server no longer
+ * recognises it.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterTlsAdapter {
+ public:
+    /**
+     * @brief Destroy the adapter object
+     */
+    virtual ~IoTPlotterTlsAdapter() {}
+
+    /**
+     * @brief Get ready to connect, offering the server's session if there
+     * is one
+     *
+     * The publisher calls this just before the client's connect().  The
+     * strings must stay valid while the adapter is in use.
+     *
+     * @param host The server's host name
+     * @param port The server's port
+     */
+    void beginConnect(const char* host, uint16_t port);
+    /**
+     * @brief Finish a connection attempt
+     *
+     * The publisher calls this once connect() has succeeded, or once it has
+     * given up on connecting.
+     *
+     * @param connected True if the connection was made
+     * @return **bool** True if the handshake resumed a saved session
+     */
+    bool endConnect(bool connected);
+    /**
+     * @brief Forget every saved session, so the next connection to each
+     * server makes a full handshake
+     */
+    void forgetSessions(void);
+
+    /**
+     * @brief Get the number of bytes the last handshake took, both ways
+     *
+     * @return **uint32_t** The bytes, or 0 if the TLS client can't tell
+     */
+    virtual uint32_t handshakeBytes(void) {
+        return 0;
+    }
+
+ protected:
+    /**
+     * @brief Have the client offer a saved session on its next connect()
+     *
+     * @param slot The slot the session was saved in
+     */
+    virtual void offerSession(uint8_t slot) = 0;
+    /**
+     * @brief Have the client make a full handshake on its next connect()
+     */
+    virtual void offerNoSession(void) = 0;
+    /**
+     * @brief Save the session of the connection just made
+     *
+     * @param slot The slot to save it in
+     * @return **bool** True if the handshake resumed the session offered
+     */
+    virtual bool keepSession(uint8_t slot) = 0;
+
+    /**
+     * @brief Get the slot of the connection being made
+     *
+     * @return **uint8_t** The slot chosen by the last beginConnect(), which a
+     * new session is saved in
+     */
+    uint8_t connectingSlot(void) const {
+        return _slot;
+    }
+
+ private:
+    const char* _hosts[IOTPLOTTER_TLS_SESSIONS] = {};
+    uint16_t    _ports[IOTPLOTTER_TLS_SESSIONS] = {};
+    uint8_t     _used[IOTPLOTTER_TLS_SESSIONS]  = {};  ///< 0 if never
+    uint8_t     _saved   = 0;  ///< Bit mask of the slots holding a session
+    uint8_t     _clock   = 0;  ///< Counts connections, for _used
+    uint8_t     _slot    = 0;  ///< The slot of the connection being made
+    bool        _offered = false;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERTLS_H_
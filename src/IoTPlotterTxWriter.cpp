@@ -0,0 +1,139 @@
+/**
+ * @file IoTPlotterTxWriter.cpp
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Implements the IoTPlotterTxWriter class.
+ */
+
+#include "IoTPlotterTxWriter.h"
+
+
+IoTPlotterTxWriter::IoTPlotterTxWriter(char* buffer, size_t capacity,
+                                       Stream* out, size_t segment)
+    : _buffer(buffer),
+      _segment(segment > 0 && segment < capacity ? segment : capacity),
+      _end(_segment),
+      _out(out) {}
+
+
+size_t IoTPlotterTxWriter::write(const char* data, size_t length) {
+    size_t remaining = length;
+    while (remaining > 0) {
+        if (_cursor == 0 && !_chunked && remaining >= _segment) {
+            // A whole segment is already sitting in the caller's memory;
+            // send it from there rather than copying it
+            send(data, _segment);
+            data += _segment;
+            remaining -= _segment;
+            continue;
+        }
+        // Fill as much of the free space as we can in one copy
+        size_t room = _end - _cursor;
+        size_t take = remaining < room ? remaining : room;
+        memcpy(_buffer + _cursor, data, take);
+        _cursor += take;
+        data += take;
+        remaining -= take;
+        // Send the buffer out once it is full
+        if (_cursor == _end) flush();
+    }
+    _total += length;
+    return length;
+}
+
+size_t IoTPlotterTxWriter::write(const char* str) {
+    if (str == nullptr) return 0;
+    return write(str, strlen(str));
+}
+
+size_t IoTPlotterTxWriter::write(char c) {
+    _buffer[_cursor++] = c;
+    _total++;
+    if (_cursor == _end) flush();
+    return 1;
+}
+
+void IoTPlotterTxWriter::flush(void) {
+    if (_cursor == _start) return;
+    if (_chunked) frameChunk();
+    send(_buffer, _cursor);
+    // The next chunk's size line goes at the very start of the buffer
+    _chunkLine = 0;
+    _cursor = _start = _chunked ? IOTPLOTTER_CHUNK_HEAD : 0;
+}
+
+
+void IoTPlotterTxWriter::beginChunked(void) {
+    // Anything already staged goes out unframed, ahead of the first chunk
+    if (_end - _cursor < IOTPLOTTER_CHUNK_HEAD + IOTPLOTTER_CHUNK_TAIL + 1) {
+        flush();
+    }
+    _chunked   = true;
+    _chunkLine = _cursor;
+    _start     = _cursor + IOTPLOTTER_CHUNK_HEAD;
+    _end       = _segment - IOTPLOTTER_CHUNK_TAIL;
+    _cursor    = _start;
+}
+
+
+void IoTPlotterTxWriter::finishChunked(void) {
+    if (_cursor > _start) {
+        frameChunk();
+    } else {
+        // No data since the last chunk; give back the room for a size line
+        _cursor = _chunkLine;
+    }
+    if (_cursor + 5 > _segment) {
+        // No room left in this write for the end of the body
+        send(_buffer, _cursor);
+        _cursor = 0;
+    }
+    memcpy(_buffer + _cursor, "0\r\n\r\n", 5);
+    _cursor += 5;
+    send(_buffer, _cursor);
+    _chunked   = false;
+    _chunkLine = 0;
+    _start     = 0;
+    _end       = _segment;
+    _cursor    = 0;
+}
+
+
+void IoTPlotterTxWriter::frameChunk(void) {
+    // Fill in the size line held back in front of the data.  It is always
+    // four hex digits (leading zeros are allowed) so that it exactly fills
+    // the gap left for it.
+    size_t length = _cursor - _start;
+    for (uint8_t i = 4; i > 0; i--) {
+        uint8_t digit               = length & 0xF;
+        _buffer[_chunkLine + i - 1] = static_cast<char>(
+            digit < 10 ? '0' + digit : 'A' + digit - 10);
+        length >>= 4;
+    }
+    _buffer[_chunkLine + 4] = '\r';
+    _buffer[_chunkLine + 5] = '\n';
+    // and the CRLF after the data
+    _buffer[_cursor++] = '\r';
+    _buffer[_cursor++] = '\n';
+}
+
+
+void IoTPlotterTxWriter::send(const char* data, size_t length) {
+    // Send the out buffer so far to the serial for debugging
+#if defined(MS_IOTPLOTTERTXWRITER_DEBUG) && defined(STANDARD_SERIAL_OUTPUT)
+    STANDARD_SERIAL_OUTPUT.write(reinterpret_cast<const uint8_t*>(data),
+                                 length);
+    STANDARD_SERIAL_OUTPUT.flush();
+#endif
+    uint32_t start = millis();
+    if (_out->write(reinterpret_cast<const uint8_t*>(data), length) !=
+        length) {
+        _writeError = true;
+    }
+    _out->flush();
+    _sendMillis += millis() - start;
+    _sent += length;
+    _flushes++;
+}
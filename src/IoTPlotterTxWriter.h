@@ -0,0 +1,188 @@
+/**
+ * @file IoTPlotterTxWriter.h
+ * @copyright 2017-2022 Stroud Water Research Center
+ * Part of the EnviroDIY ModularSensors library for Arduino
+ * @author Luke Miller <contact@lukemiller.org>
+ *
+ * @brief Contains the IoTPlotterTxWriter class, a cursor based append writer
+ * that stages outgoing request bytes in a fixed buffer and flushes them to an
+ * Arduino Stream (usually a Client) whenever the buffer fills.  It is the
+ * buffered Client sink for the IoTPlotterSerializer.
+ */
+
+// Header Guards
+#ifndef SRC_PUBLISHERS_IOTPLOTTERTXWRITER_H_
+#define SRC_PUBLISHERS_IOTPLOTTERTXWRITER_H_
+
+// Debugging Statement
+// #define MS_IOTPLOTTERTXWRITER_DEBUG
+
+// Included Dependencies
+#include <Arduino.h>
+
+/**
+ * @brief The bytes held back in front of each chunk's data in chunked mode
+ * for its size line: four hex digits and a CRLF.
+ */
+#define IOTPLOTTER_CHUNK_HEAD 6
+/**
+ * @brief The bytes held back at the end of each chunk in chunked mode for the
+ * CRLF after its data.
+ */
+#define IOTPLOTTER_CHUNK_TAIL 2
+
+
+/**
+ * @brief An append-only writer with an explicit write cursor.
+ *
+ * Every fragment of the outgoing request is copied to the current cursor
+ * position, so appending never has to rescan the buffer to find its end.
+ * When a fragment does not fit in the remaining space the buffer is filled to
+ * the brim, flushed to the output stream, and the remainder of the fragment
+ * continues at the start of the now empty buffer.
+ *
+ * In chunked mode each buffer-full goes out as one chunk of an HTTP/1.1
+ * `Transfer-Encoding: chunked` body.  Room for the chunk's size line is held
+ * back in front of its data and filled in at the flush, once the size is
+ * known, so the data never has to be counted beforehand.
+ *
+ * Every write to the output stream is exactly one segment long, except the
+ * last.  The segment defaults to the whole buffer, but can be set to the
+ * modem's MTU or the most its send command takes at once, so that each write
+ * becomes a single packet or AT command.  When a fragment covers a whole
+ * segment from a segment boundary, it is sent straight from the caller's
+ * memory without being copied into the buffer.  Smaller fragments are
+ * staged, since sending each on its own would cost a round-trip apiece.
+ *
+ * With MS_IOTPLOTTERTXWRITER_DEBUG defined, everything sent is echoed to
+ * STANDARD_SERIAL_OUTPUT as well.  It's off by default: the echo waits on
+ * the serial port for every write, and shows the API key and any gzipped
+ * body as they are.
+ *
+ * The writer does not own its buffer; the IoTPlotter publisher hands it the
+ * shared dataPublisher::txBuffer.  The buffer is **not** kept null terminated
+ * while the writer is in use.
+ *
+ * @ingroup the_publishers
+ */
+class IoTPlotterTxWriter {
+ public:
+    /**
+     * @brief Construct a new writer
+     *
+     * @param buffer The staging buffer to fill
+     * @param capacity The number of bytes available in the staging buffer
+     * @param out The stream to flush the staged bytes to
+     * @param segment The number of bytes to send in each write to the
+     * stream; 0 (or anything larger than the buffer) for the whole buffer
+     */
+    IoTPlotterTxWriter(char* buffer, size_t capacity, Stream* out,
+                       size_t segment = 0);
+
+    /**
+     * @brief Append a run of bytes, flushing as often as needed
+     *
+     * @param data The bytes to append
+     * @param length The number of bytes to append
+     * @return **size_t** The number of bytes appended
+     */
+    size_t write(const char* data, size_t length);
+    /**
+     * @brief Append a null terminated string
+     *
+     * @param str The string to append
+     * @return **size_t** The number of bytes appended
+     */
+    size_t write(const char* str);
+    /**
+     * @brief Append a single character
+     *
+     * @param c The character to append
+     * @return **size_t** The number of bytes appended, always 1
+     */
+    size_t write(char c);
+    /**
+     * @brief Send any staged bytes to the output stream and rewind the cursor
+     */
+    void flush(void);
+
+    /**
+     * @brief Frame everything written from now on as chunks.
+     *
+     * Anything already staged (the request headers) goes out unframed in the
+     * same write as the first chunk.  Each chunk fills one segment, which
+     * must be larger than #IOTPLOTTER_CHUNK_HEAD + #IOTPLOTTER_CHUNK_TAIL and
+     * smaller than 64kB.
+     */
+    void beginChunked(void);
+    /**
+     * @brief Send the last chunk of data, if any, followed by the zero-length
+     * chunk that ends the body, in a single write if they fit in one
+     * segment, and leave chunked mode
+     */
+    void finishChunked(void);
+
+    /**
+     * @brief Get the total number of bytes appended since construction
+     *
+     * @return **uint32_t** The number of bytes appended
+     */
+    uint32_t bytesWritten(void) const {
+        return _total;
+    }
+    /**
+     * @brief Get the total number of bytes handed to the output stream,
+     * including any chunk framing
+     *
+     * @return **uint32_t** The number of bytes sent
+     */
+    uint32_t bytesSent(void) const {
+        return _sent;
+    }
+    /**
+     * @brief Get the number of writes made to the output stream
+     *
+     * @return **uint16_t** The number of writes, both flushes of the buffer
+     * and segments sent in place
+     */
+    uint16_t flushCount(void) const {
+        return _flushes;
+    }
+    /**
+     * @brief Get the time spent writing to the output stream
+     *
+     * @return **uint32_t** The milliseconds spent in the stream's write() and
+     * flush() calls
+     */
+    uint32_t sendMillis(void) const {
+        return _sendMillis;
+    }
+    /**
+     * @brief Check whether the output stream has refused any bytes
+     *
+     * @return **bool** True if a flush wrote fewer bytes than it was given
+     */
+    bool hasWriteError(void) const {
+        return _writeError;
+    }
+
+ private:
+    void frameChunk(void);
+    void send(const char* data, size_t length);
+
+    char*    _buffer;
+    size_t   _segment;     ///< Bytes per write to the output stream
+    size_t   _start  = 0;  ///< Offset of the first byte of data in _buffer
+    size_t   _end;         ///< Offset just past the last usable byte
+    size_t   _cursor = 0;  ///< Offset of the next free byte in _buffer
+    size_t   _chunkLine = 0;  ///< Offset held back for the chunk's size line
+    Stream*  _out;
+    bool     _chunked = false;
+    uint32_t _total   = 0;
+    uint32_t _sent    = 0;
+    uint16_t _flushes = 0;
+    uint32_t _sendMillis = 0;
+    bool     _writeError = false;
+};
+
+#endif  // SRC_PUBLISHERS_IOTPLOTTERTXWRITER_H_